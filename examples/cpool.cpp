@@ -67,15 +67,20 @@ public:
 	// we keep our own count; ConnectionPool::size() isn't the same!
 	mysqlpp::Connection* grab()
 	{
-		while (conns_in_use_ > 8) {
-			cout.put('R'); cout.flush(); // indicate waiting for release
-			sleep(1);
-		}
-
-		++conns_in_use_;
+		wait_for_room();
 		return mysqlpp::ConnectionPool::grab();
 	}
 
+	// Overriding grab() hides the superclass's grab(db), and that one
+	// doesn't call grab(), so we override it, too, to count its
+	// connections.  If you don't need that, bring the superclass's
+	// version back with "using mysqlpp::ConnectionPool::grab;" instead.
+	mysqlpp::Connection* grab(const std::string& db)
+	{
+		wait_for_room();
+		return mysqlpp::ConnectionPool::grab(db);
+	}
+
 	// Other half of in-use conn count limit
 	void release(const mysqlpp::Connection* pc)
 	{
@@ -115,6 +120,18 @@ protected:
 	}
 
 private:
+	// Wait until there's room for another connection in use, then
+	// count it
+	void wait_for_room()
+	{
+		while (conns_in_use_ > 8) {
+			cout.put('R'); cout.flush(); // indicate waiting for release
+			sleep(1);
+		}
+
+		++conns_in_use_;
+	}
+
 	// Number of connections currently in use
 	unsigned int conns_in_use_;
 
@@ -0,0 +1,610 @@
+/***********************************************************************
+ asyncresult.cpp - Implements the AsyncResult class, and the machinery
+	for running queries in the background.
+
+ Copyright (c) 2015 by Educational Technology Resources, Inc.  Others
+ may also hold copyrights on code in this file.  See the CREDITS.txt
+ file in the top directory of the distribution for details.
+
+ This file is part of MySQL++.
+
+ MySQL++ is free software; you can redistribute it and/or modify it
+ under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 2.1 of the License, or
+ (at your option) any later version.
+
+ MySQL++ is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with MySQL++; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+ USA
+***********************************************************************/
+
+#define MYSQLPP_NOT_HEADER
+#include "asyncresult.h"
+
+#include "connection.h"
+#include "dbdriver.h"
+#include "mythread.h"
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+#if !defined(MYSQLPP_PLATFORM_WINDOWS)
+#	include <poll.h>
+#endif
+
+namespace mysqlpp {
+
+namespace internal {
+	// State shared by all AsyncResult handles to a query, and by the
+	// I/O thread running it, if any.  If task is set, it's run instead
+	// of a query, and driver is 0.  refs, done, callback and userdata
+	// are guarded by monitor.  The outcome fields are written only by
+	// whoever finishes the query, before setting done, and only read
+	// after.
+	class AsyncState
+	{
+	public:
+		AsyncState(Connection* c, const std::string& q, bool st,
+				bool te, AsyncResult::Callback cb, void* ud) :
+		refs(0),
+		driver(c ? c->driver() : 0),
+		sql(q),
+		store(st),
+		throw_exceptions(te),
+		native(false),
+		sent(false),
+		done(false),
+		ok(false),
+		errnum(0),
+		callback(cb),
+		userdata(ud),
+		task(0),
+		task_arg(0)
+		{
+		}
+
+		Monitor monitor;
+		int refs;
+		DBDriver* driver;
+		std::string sql;
+		bool store;
+		bool throw_exceptions;
+		bool native;
+		bool sent;
+		bool done;
+		bool ok;
+		int errnum;
+		std::string error;
+		SimpleResult simple;
+		StoreQueryResult rows;
+		AsyncResult::Callback callback;
+		void* userdata;
+		AsyncResult::Task task;
+		void* task_arg;
+	};
+} // end namespace mysqlpp::internal
+
+using internal::AsyncState;
+
+
+//// acquire, release //////////////////////////////////////////////////
+// Reference counting for AsyncState.  RefCountedPointer won't do here,
+// since handles get copied and destroyed on several threads at once.
+
+static void
+acquire(AsyncState* s)
+{
+	Monitor::Lock lock(s->monitor);
+	++s->refs;
+}
+
+static void
+release(AsyncState* s)
+{
+	bool last;
+	{
+		Monitor::Lock lock(s->monitor);
+		last = --s->refs == 0;
+	}
+
+	if (last) {
+		delete s;
+	}
+}
+
+
+//// record_outcome ////////////////////////////////////////////////////
+// Fill in the outcome of a query that just finished.  res is the result
+// set, if we were asked to store one and there was one.
+
+static void
+record_outcome(AsyncState& s, bool ok, MYSQL_RES* res)
+{
+	if (ok && res) {
+		s.rows = StoreQueryResult(res, s.driver, s.throw_exceptions);
+	}
+	else if (ok && s.store && s.driver->errnum()) {
+		ok = false;			// query worked, but fetching results didn't
+	}
+
+	if (ok) {
+		s.simple = SimpleResult(true, s.driver->insert_id(),
+				s.driver->affected_rows(), s.driver->query_info());
+	}
+	else {
+		s.errnum = s.driver->errnum();
+		s.error = s.driver->error();
+	}
+	s.ok = ok;
+}
+
+
+//// run_blocking //////////////////////////////////////////////////////
+// Run a query the ordinary way, or a task, for I/O threads and
+// thread-less builds
+
+static void
+run_blocking(AsyncState& s)
+{
+	if (s.task) {
+		s.task(s.task_arg);
+		s.ok = true;
+		return;
+	}
+
+	try {
+		bool ok = s.driver->execute(s.sql.data(), s.sql.length());
+		record_outcome(s, ok, ok && s.store ? s.driver->store_result() : 0);
+	}
+	catch (const std::exception& e) {
+		s.ok = false;
+		s.error = e.what();
+	}
+}
+
+
+//// advance ///////////////////////////////////////////////////////////
+// Move a native query along as far as it can go without blocking.
+// Returns true once it's finished.  Caller must hold s.monitor.
+
+static bool
+advance(AsyncState& s)
+{
+#if defined(MYSQLPP_HAVE_NONBLOCKING_API)
+	if (!s.sent) {
+		net_async_status rc = s.driver->execute_nonblocking(s.sql.data(),
+				s.sql.length());
+		if (rc == NET_ASYNC_NOT_READY) {
+			return false;
+		}
+		else if (rc == NET_ASYNC_ERROR) {
+			record_outcome(s, false, 0);
+			return true;
+		}
+		s.sent = true;
+	}
+
+	MYSQL_RES* res = 0;
+	if (s.store) {
+		net_async_status rc = s.driver->store_result_nonblocking(&res);
+		if (rc == NET_ASYNC_NOT_READY) {
+			return false;
+		}
+		else if (rc == NET_ASYNC_ERROR) {
+			record_outcome(s, false, 0);
+			return true;
+		}
+	}
+
+	record_outcome(s, true, res);
+#else
+	(void)s;
+#endif
+	return true;
+}
+
+
+//// finish ////////////////////////////////////////////////////////////
+// Mark a query finished, waking any waiters, then call the user's
+// callback.  Caller must not hold s->monitor.
+
+static void
+finish(AsyncState* s)
+{
+	AsyncResult::Callback cb;
+	void* userdata;
+	{
+		Monitor::Lock lock(s->monitor);
+		s->done = true;
+		s->monitor.notify_all();
+		cb = s->callback;
+		userdata = s->userdata;
+	}
+
+	if (cb) {
+		AsyncResult handle(s);
+		cb(handle, userdata);
+	}
+}
+
+
+//// wait_readable /////////////////////////////////////////////////////
+// Block until the given socket is readable or ms milliseconds pass.
+// We don't wait for writability: a socket is nearly always writable,
+// so that would turn waiting for a reply into a busy loop.  The short
+// timeouts we're given cover the rare case of a query too big to send
+// all at once.  We use poll() rather than select() because a busy
+// program's sockets can be numbered beyond what an fd_set holds.
+
+static void
+wait_readable(int fd, unsigned long ms)
+{
+#if defined(MYSQLPP_PLATFORM_WINDOWS)
+	WSAPOLLFD pfd;
+	pfd.fd = SOCKET(fd);
+	pfd.events = POLLRDNORM;
+	pfd.revents = 0;
+	WSAPoll(&pfd, 1, int(ms));
+#else
+	struct pollfd pfd;
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	poll(&pfd, 1, int(ms));
+#endif
+}
+
+
+//// I/O thread pool ///////////////////////////////////////////////////
+// Background threads for running queries when the C API can't do it
+// without blocking.  They're started as needed, up to a limit, and
+// quit after sitting idle for a while, leaving their Thread objects
+// for the next submit_io() to join.  These objects may be in use by
+// such threads during static destruction, so they're deliberately
+// never destroyed.
+
+static const size_t max_io_threads = 8;
+static const unsigned long io_idle_ms = 10000;
+static Monitor& io_monitor = *new Monitor;
+static std::deque<AsyncState*>& io_queue = *new std::deque<AsyncState*>;
+static std::vector<Thread*>& io_exited = *new std::vector<Thread*>;
+static size_t io_threads = 0;
+static size_t io_idle = 0;
+
+static void
+io_main(void* pt)
+{
+	for (;;) {
+		AsyncState* s;
+		{
+			Monitor::Lock lock(io_monitor);
+			++io_idle;
+			while (io_queue.empty()) {
+				if (!io_monitor.wait(io_idle_ms) && io_queue.empty()) {
+					--io_idle;
+					--io_threads;
+					io_exited.push_back(static_cast<Thread*>(pt));
+					return;
+				}
+			}
+			--io_idle;
+
+			s = io_queue.front();
+			io_queue.pop_front();
+		}
+
+		run_blocking(*s);
+		finish(s);
+		release(s);
+	}
+}
+
+static bool
+submit_io(AsyncState* s)
+{
+	if (!Thread::supported()) {
+		return false;
+	}
+
+	std::vector<Thread*> exited;
+	bool queued = false;
+	{
+		Monitor::Lock lock(io_monitor);
+		exited.swap(io_exited);
+		if ((io_idle == 0) && (io_threads < max_io_threads)) {
+			Thread* pt = new Thread;
+			if (pt->start(io_main, pt)) {
+				++io_threads;
+			}
+			else {
+				delete pt;
+			}
+		}
+
+		if (io_threads > 0) {
+			acquire(s);
+			io_queue.push_back(s);
+			io_monitor.notify_one();
+			queued = true;
+		}
+	}
+
+	// Threads that quit let go of the lock first, so joining them
+	// can't deadlock; doing it out here keeps others from waiting.
+	for (size_t i = 0; i < exited.size(); ++i) {
+		delete exited[i];	// joins it
+	}
+	return queued;
+}
+
+
+AsyncResult::AsyncResult() :
+state_(0)
+{
+}
+
+
+AsyncResult::AsyncResult(AsyncState* state) :
+state_(state)
+{
+	acquire(state_);
+}
+
+
+AsyncResult::AsyncResult(const AsyncResult& other) :
+state_(other.state_)
+{
+	if (state_) {
+		acquire(state_);
+	}
+}
+
+
+AsyncResult::~AsyncResult()
+{
+	if (state_) {
+		release(state_);
+	}
+}
+
+
+AsyncResult&
+AsyncResult::operator =(const AsyncResult& rhs)
+{
+	if (rhs.state_) {
+		acquire(rhs.state_);
+	}
+	if (state_) {
+		release(state_);
+	}
+	state_ = rhs.state_;
+	return *this;
+}
+
+
+bool
+AsyncResult::finished() const
+{
+	if (!state_) {
+		return false;
+	}
+
+	Monitor::Lock lock(state_->monitor);
+	return state_->done;
+}
+
+
+void
+AsyncResult::check() const
+{
+	if (state_ && !state_->ok && state_->throw_exceptions) {
+		throw BadQuery(state_->error, state_->errnum);
+	}
+}
+
+
+std::string
+AsyncResult::error() const
+{
+	return finished() ?
+			state_->error : std::string();
+}
+
+
+int
+AsyncResult::errnum() const
+{
+	return finished() ?
+			state_->errnum : 0;
+}
+
+
+int
+AsyncResult::fd() const
+{
+	if (!state_) {
+		return -1;
+	}
+
+	Monitor::Lock lock(state_->monitor);
+	return state_->native && !state_->done ?
+			state_->driver->socket_fd() : -1;
+}
+
+
+bool
+AsyncResult::native() const
+{
+	return state_ && state_->native;
+}
+
+
+bool
+AsyncResult::ok() const
+{
+	return finished() && state_->ok;
+}
+
+
+bool
+AsyncResult::on_finish(Callback cb, void* userdata)
+{
+	if (!state_) {
+		return false;
+	}
+
+	Monitor::Lock lock(state_->monitor);
+	if (state_->done) {
+		return false;
+	}
+
+	state_->callback = cb;
+	state_->userdata = userdata;
+	return true;
+}
+
+
+bool
+AsyncResult::ready()
+{
+	if (!state_) {
+		return true;
+	}
+
+	{
+		Monitor::Lock lock(state_->monitor);
+		if (state_->done) {
+			return true;
+		}
+		else if (!state_->native || !advance(*state_)) {
+			return false;
+		}
+	}
+
+	// We just finished a native query
+	finish(state_);
+	return true;
+}
+
+
+const StoreQueryResult&
+AsyncResult::rows() const
+{
+	static const StoreQueryResult empty;
+	return finished() ?
+			state_->rows : empty;
+}
+
+
+const SimpleResult&
+AsyncResult::simple() const
+{
+	static const SimpleResult empty;
+	return finished() ?
+			state_->simple : empty;
+}
+
+
+AsyncResult
+AsyncResult::run(Task task, void* arg, Callback cb, void* userdata)
+{
+	AsyncResult result(new AsyncState(0, std::string(), false, false,
+			cb, userdata));
+	result.state_->task = task;
+	result.state_->task_arg = arg;
+
+	if (!submit_io(result.state_)) {
+		run_blocking(*result.state_);
+		finish(result.state_);
+	}
+
+	return result;
+}
+
+
+AsyncResult
+AsyncResult::start(Connection* conn, const std::string& sql, bool store,
+		bool te, Callback cb, void* userdata)
+{
+	AsyncResult result(new AsyncState(conn, sql, store, te, cb, userdata));
+
+#if defined(MYSQLPP_HAVE_NONBLOCKING_API)
+	result.state_->native = true;
+	result.ready();			// get the query on its way
+#else
+	if (!submit_io(result.state_)) {
+		// No threads, so all we can do is run it now
+		run_blocking(*result.state_);
+		finish(result.state_);
+	}
+#endif
+
+	return result;
+}
+
+
+void
+AsyncResult::wait()
+{
+	if (!state_) {
+		return;
+	}
+
+	if (state_->native) {
+		while (!ready()) {
+			wait_readable(state_->driver->socket_fd(), 10);
+		}
+	}
+	else {
+		Monitor::Lock lock(state_->monitor);
+		while (!state_->done) {
+			state_->monitor.wait();
+		}
+	}
+
+	check();
+}
+
+
+bool
+AsyncResult::wait(unsigned long ms)
+{
+	if (!state_) {
+		return true;
+	}
+
+	unsigned long long deadline = internal::now_ms() + ms;
+	if (state_->native) {
+		while (!ready()) {
+			unsigned long long now = internal::now_ms();
+			if (now >= deadline) {
+				return false;
+			}
+			wait_readable(state_->driver->socket_fd(),
+					static_cast<unsigned long>(std::min<unsigned long long>(
+					deadline - now, 10)));
+		}
+	}
+	else {
+		Monitor::Lock lock(state_->monitor);
+		while (!state_->done) {
+			unsigned long long now = internal::now_ms();
+			if (now >= deadline) {
+				return false;
+			}
+			state_->monitor.wait(static_cast<unsigned long>(deadline - now));
+		}
+	}
+
+	check();
+	return true;
+}
+
+} // end namespace mysqlpp
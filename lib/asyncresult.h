@@ -0,0 +1,189 @@
+/// \file asyncresult.h
+/// \brief Declares the AsyncResult class, a handle to a query running
+/// in the background.
+
+/***********************************************************************
+ Copyright (c) 2015 by Educational Technology Resources, Inc.  Others
+ may also hold copyrights on code in this file.  See the CREDITS.txt
+ file in the top directory of the distribution for details.
+
+ This file is part of MySQL++.
+
+ MySQL++ is free software; you can redistribute it and/or modify it
+ under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 2.1 of the License, or
+ (at your option) any later version.
+
+ MySQL++ is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with MySQL++; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+ USA
+***********************************************************************/
+
+#if !defined(MYSQLPP_ASYNCRESULT_H)
+#define MYSQLPP_ASYNCRESULT_H
+
+#include "common.h"
+
+#include "result.h"
+
+#include <string>
+
+namespace mysqlpp {
+
+#if !defined(DOXYGEN_IGNORE)
+// Make Doxygen ignore this
+class MYSQLPP_EXPORT Connection;
+namespace internal { class AsyncState; }
+#endif
+
+/// \brief Handle to a query started by Query::execute_async() or
+/// Query::store_async()
+///
+/// This works like a future: you get one back immediately, and it
+/// becomes ready() when the query finishes, at which point you can
+/// get its outcome.  Alternately, you can pass a callback when
+/// starting the query, to be called when it finishes.
+///
+/// There are two ways the query can run, depending on the C API
+/// library MySQL++ was built against.  If it has MySQL's non-blocking
+/// API, native() returns true, and the query only makes progress when
+/// you call ready() or wait().  The intent is that you watch fd() in
+/// your event loop, and call ready() each time it becomes readable;
+/// the callback, if any, is called from within ready() or wait().
+/// Otherwise, the query runs blocking on one of a small pool of
+/// background I/O threads, and the callback is called on that thread.
+/// If the platform doesn't support threads either, the query runs to
+/// completion before the function starting it returns.
+///
+/// Either way, don't use the connection for anything else until the
+/// query is finished.
+///
+/// Copies of this object refer to the same query.
+
+class MYSQLPP_EXPORT AsyncResult
+{
+public:
+	/// \brief Type of function called when an asynchronous query
+	/// finishes
+	typedef void (*Callback)(AsyncResult& result, void* userdata);
+
+	/// \brief Type of function run() runs in the background
+	typedef void (*Task)(void* arg);
+
+	/// \brief Create a handle not referring to any query
+	///
+	/// It's always ready(), and never ok().
+	AsyncResult();
+
+	/// \brief Create another handle to the same query
+	AsyncResult(const AsyncResult& other);
+
+	/// \brief Destroy the handle
+	///
+	/// The query carries on if it isn't finished yet.
+	~AsyncResult();
+
+	/// \brief Make this handle refer to the same query as another
+	AsyncResult& operator =(const AsyncResult& rhs);
+
+	/// \brief Get the error message if the query failed
+	///
+	/// This and the other outcome accessors don't move a native()
+	/// query along, so call ready() or wait() first.
+	std::string error() const;
+
+	/// \brief Get the MySQL error number if the query failed, else 0
+	int errnum() const;
+
+	/// \brief Get the socket to watch for the query's progress
+	///
+	/// \retval -1 if the query isn't native(), or is finished
+	int fd() const;
+
+	/// \brief Returns true if the query is being run with the C API's
+	/// non-blocking calls, rather than on a background thread
+	bool native() const;
+
+	/// \brief Returns true if the query finished successfully
+	bool ok() const;
+
+	/// \brief Set the function to call when the query finishes
+	///
+	/// This replaces any callback given when starting the query.
+	///
+	/// \retval false if the query is already finished, in which case
+	/// \c cb won't be called
+	bool on_finish(Callback cb, void* userdata);
+
+	/// \brief Returns true if the query is finished
+	///
+	/// For native() queries, this also moves the query along as far
+	/// as it can go without blocking.
+	bool ready();
+
+	/// \brief Run a function on one of the background I/O threads
+	///
+	/// This lets you push other blocking work, like
+	/// ConnectionPool::grab(), off the calling thread the same way
+	/// Query::execute_async() does with queries.  The returned handle
+	/// is never native(), and is ok() once \c task returns, so \c task
+	/// must report its own errors through \c arg.  It must not throw.
+	///
+	/// If the platform doesn't support threads, \c task runs before
+	/// this function returns.
+	static AsyncResult run(Task task, void* arg, Callback cb = 0,
+			void* userdata = 0);
+
+	/// \brief Get the result set from a Query::store_async() query
+	///
+	/// Empty until the query is ready(), or if it failed.
+	const StoreQueryResult& rows() const;
+
+	/// \brief Get the rows affected, insert ID and server info
+	///
+	/// Empty until the query is ready(), or if it failed.
+	const SimpleResult& simple() const;
+
+	/// \brief Block until the query is finished
+	///
+	/// If the query failed and the Query it came from had exceptions
+	/// enabled, throws BadQuery.
+	void wait();
+
+	/// \brief Block until the query is finished or the given number
+	/// of milliseconds passes
+	///
+	/// \retval true if the query is finished
+	bool wait(unsigned long ms);
+
+#if !defined(DOXYGEN_IGNORE)
+	// Query uses this to start a query; see asyncresult.cpp
+	static AsyncResult start(Connection* conn, const std::string& sql,
+			bool store, bool te, Callback cb, void* userdata);
+
+	// Takes a new reference to the given state object
+	explicit AsyncResult(internal::AsyncState* state);
+#endif
+
+private:
+	/// \brief Throw BadQuery if the query failed and exceptions are
+	/// wanted
+	void check() const;
+
+	/// \brief Returns true if we refer to a query, and it's finished
+	///
+	/// Unlike ready(), this never moves a native query along.
+	bool finished() const;
+
+	internal::AsyncState* state_;
+};
+
+} // end namespace mysqlpp
+
+#endif // !defined(MYSQLPP_ASYNCRESULT_H)
@@ -0,0 +1,420 @@
+/// \file awaitable.h
+/// \brief Lets C++20 coroutines co_await queries and other blocking
+/// MySQL++ operations.
+///
+/// This header is not pulled in by mysql++.h, since it needs a C++20
+/// compiler.  Include it explicitly; with older compilers, it declares
+/// nothing.
+
+/***********************************************************************
+ Copyright (c) 2015 by Educational Technology Resources, Inc.  Others
+ may also hold copyrights on code in this file.  See the CREDITS.txt
+ file in the top directory of the distribution for details.
+
+ This file is part of MySQL++.
+
+ MySQL++ is free software; you can redistribute it and/or modify it
+ under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 2.1 of the License, or
+ (at your option) any later version.
+
+ MySQL++ is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with MySQL++; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+ USA
+***********************************************************************/
+
+#if !defined(MYSQLPP_AWAITABLE_H)
+#define MYSQLPP_AWAITABLE_H
+
+#include "common.h"
+
+#if __cplusplus >= 202002L && defined(__cpp_impl_coroutine)
+#	define MYSQLPP_HAVE_COROUTINES
+#endif
+
+#if defined(MYSQLPP_HAVE_COROUTINES)
+
+#include "asyncresult.h"
+#include "cpool.h"
+#include "result.h"
+#include "row.h"
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace mysqlpp {
+
+namespace internal {
+	// Callback resuming the coroutine whose handle's address is ud
+	inline void resume_coroutine(AsyncResult&, void* ud)
+	{
+		std::coroutine_handle<>::from_address(ud).resume();
+	}
+} // end namespace mysqlpp::internal
+
+
+/// \brief Awaiter for an AsyncResult
+///
+/// You don't use this directly.  It's what lets you say
+/// \c co_await \c query.store_async() in a coroutine, which suspends
+/// the coroutine until the query finishes, then gives back the
+/// AsyncResult, or throws BadQuery if it failed and the Query has
+/// exceptions enabled.
+///
+/// The coroutine resumes on whichever thread finishes the query.  For
+/// queries run on the background I/O threads, that's one of those.
+/// For AsyncResult::native() queries, something has to move the query
+/// along: the intent is that your event loop watches
+/// AsyncResult::fd() and calls AsyncResult::ready() when it becomes
+/// readable, resuming the coroutine from within that call.
+///
+/// This takes over the AsyncResult's callback; see
+/// AsyncResult::on_finish().
+
+class AsyncResultAwaiter
+{
+public:
+	/// \brief Create an awaiter for the given query
+	explicit AsyncResultAwaiter(const AsyncResult& ar) :
+	ar_(ar)
+	{
+	}
+
+	/// \brief Don't suspend if the query is already finished
+	bool await_ready() { return ar_.ready(); }
+
+	/// \brief Arrange for the coroutine to resume when the query
+	/// finishes
+	///
+	/// \retval false if it finished already, so there's no need to
+	/// suspend after all
+	bool await_suspend(std::coroutine_handle<> h)
+	{
+		return ar_.on_finish(internal::resume_coroutine, h.address());
+	}
+
+	/// \brief Give the finished query back to the coroutine
+	AsyncResult await_resume()
+	{
+		ar_.wait();			// doesn't block; just throws on error
+		return ar_;
+	}
+
+private:
+	AsyncResult ar_;
+};
+
+
+/// \brief Lets coroutines co_await an AsyncResult
+inline AsyncResultAwaiter
+operator co_await(const AsyncResult& ar)
+{
+	return AsyncResultAwaiter(ar);
+}
+
+
+/// \brief Awaitable running a function on a background I/O thread
+///
+/// Use background() to create these.  The coroutine suspends while
+/// the function runs, then resumes on the I/O thread, getting the
+/// function's return value, or having its exception rethrown.
+
+template <class F>
+class BackgroundAwaiter
+{
+public:
+	/// \brief Type of value the function returns
+	typedef std::invoke_result_t<F&> value_type;
+
+	/// \brief Create the awaitable; nothing runs until co_await
+	explicit BackgroundAwaiter(F f) :
+	f_(std::move(f))
+	{
+	}
+
+	/// \brief Always suspend; the whole point is to get off this thread
+	bool await_ready() const { return false; }
+
+	/// \brief Start the function on an I/O thread
+	void await_suspend(std::coroutine_handle<> h)
+	{
+		// Don't touch *this after run(): the coroutine may already
+		// have resumed and destroyed us by the time it returns.
+		AsyncResult::run(task, this, internal::resume_coroutine,
+				h.address());
+	}
+
+	/// \brief Hand the function's outcome to the coroutine
+	value_type await_resume()
+	{
+		if (error_) {
+			std::rethrow_exception(error_);
+		}
+		if constexpr (!std::is_void_v<value_type>) {
+			return std::move(*value_);
+		}
+	}
+
+private:
+	typedef std::conditional_t<std::is_void_v<value_type>, bool,
+			value_type> stored_type;
+
+	static void task(void* arg)
+	{
+		BackgroundAwaiter* self = static_cast<BackgroundAwaiter*>(arg);
+		try {
+			if constexpr (std::is_void_v<value_type>) {
+				self->f_();
+			}
+			else {
+				self->value_.emplace(self->f_());
+			}
+		}
+		catch (...) {
+			self->error_ = std::current_exception();
+		}
+	}
+
+	F f_;
+	std::optional<stored_type> value_;
+	std::exception_ptr error_;
+};
+
+
+/// \brief Run a function on a background I/O thread from a coroutine
+///
+/// For example, \c co_await \c background([&]{ return q.use(); }).
+/// The function must stay valid until the co_await completes, which
+/// it will for lambdas capturing the coroutine's locals.
+template <class F>
+inline BackgroundAwaiter<F>
+background(F f)
+{
+	return BackgroundAwaiter<F>(std::move(f));
+}
+
+
+/// \brief Awaitable grabbing a connection from a pool
+///
+/// Use grab_async() to create these.  If the pool is full, the
+/// coroutine waits in line with the threads in ConnectionPool::grab()
+/// without holding up a thread of its own; see
+/// ConnectionPool::queue_grab().  It resumes on a background I/O
+/// thread, which also creates the connection, if it comes to that.
+/// If there's a connection to be had right away, it resumes at once.
+
+class GrabAwaiter
+{
+public:
+	/// \brief Create the awaitable; nothing happens until co_await
+	explicit GrabAwaiter(ConnectionPool& pool) :
+	pool_(pool),
+	conn_(0),
+	finished_(false)
+	{
+	}
+
+	/// \brief Always try suspending; queue_grab() finds out if we
+	/// needn't
+	bool await_ready() const { return false; }
+
+	/// \brief Get in line for a connection
+	///
+	/// \retval false if we got one without waiting
+	bool await_suspend(std::coroutine_handle<> h)
+	{
+		handle_ = h;
+		if (pool_.queue_grab(waiter_, ready, this)) {
+			return true;		// ready() takes it from here
+		}
+		if (!waiter_.may_create) {
+			return false;		// have one, or never will
+		}
+		ready(this);			// creating one would block us
+		return true;
+	}
+
+	/// \brief Hand the connection to the coroutine
+	Connection* await_resume()
+	{
+		if (error_) {
+			std::rethrow_exception(error_);
+		}
+		return finished_ ? conn_ : pool_.finish_grab(waiter_);
+	}
+
+private:
+	// Our turn came; called with the pool locked, so finish on an I/O
+	// thread.  Don't touch *this after run(), as in BackgroundAwaiter.
+	static void ready(void* arg)
+	{
+		GrabAwaiter* self = static_cast<GrabAwaiter*>(arg);
+		AsyncResult::run(finish, self, internal::resume_coroutine,
+				self->handle_.address());
+	}
+
+	static void finish(void* arg)
+	{
+		GrabAwaiter* self = static_cast<GrabAwaiter*>(arg);
+		try {
+			self->conn_ = self->pool_.finish_grab(self->waiter_);
+		}
+		catch (...) {
+			self->error_ = std::current_exception();
+		}
+		self->finished_ = true;
+	}
+
+	ConnectionPool& pool_;
+	ConnectionPool::Waiter waiter_;
+	std::coroutine_handle<> handle_;
+	Connection* conn_;
+	bool finished_;
+	std::exception_ptr error_;
+};
+
+
+/// \brief Grab a connection from a pool without blocking the calling
+/// thread
+///
+/// Say \c co_await \c grab_async(pool) in a coroutine to get a
+/// Connection*, as from ConnectionPool::grab().
+inline GrabAwaiter
+grab_async(ConnectionPool& pool)
+{
+	return GrabAwaiter(pool);
+}
+
+
+/// \brief Reads the rows of a "use" query result without blocking the
+/// calling thread
+///
+/// This gives you a coroutine equivalent of the usual UseQueryResult
+/// loop:
+///
+/// \code
+/// UseQueryResult res = co_await background([&] { return q.use(); });
+/// AsyncRowReader reader(res);
+/// while (Row row = co_await reader.next()) {
+///     ...
+/// }
+/// \endcode
+///
+/// Rows are fetched on a background I/O thread several at a time, so
+/// most next() calls return one already fetched without suspending.
+/// The reader must outlive any next() in progress, and the result
+/// must outlive the reader.
+
+class AsyncRowReader
+{
+public:
+	/// \brief Awaitable for the next row; see next()
+	class NextRow
+	{
+	public:
+		/// \brief Create the awaitable for the given reader
+		explicit NextRow(AsyncRowReader& reader) :
+		reader_(reader)
+		{
+		}
+
+		/// \brief Don't suspend if there's a row fetched already, or
+		/// there won't be any more
+		bool await_ready() const
+		{
+			return (reader_.pos_ < reader_.rows_.size()) || reader_.done_;
+		}
+
+		/// \brief Fetch the next batch on an I/O thread
+		void await_suspend(std::coroutine_handle<> h)
+		{
+			AsyncResult::run(fill, &reader_, internal::resume_coroutine,
+					h.address());
+		}
+
+		/// \brief Hand over the next row, or an empty one at the end
+		Row await_resume() { return reader_.take(); }
+
+	private:
+		AsyncRowReader& reader_;
+	};
+
+	/// \brief Create a reader for the given result
+	///
+	/// \param res result of a Query::use() call
+	/// \param batch most rows to fetch at a time
+	explicit AsyncRowReader(UseQueryResult& res, size_t batch = 100) :
+	res_(res),
+	batch_(batch ? batch : 1),
+	pos_(0),
+	done_(false)
+	{
+	}
+
+	/// \brief Get an awaitable for the next row
+	///
+	/// co_await it for the next Row, which is empty after the last one.
+	/// If fetching a row throws, the rows fetched before it come out
+	/// first, then the exception.  Don't await two at once.
+	NextRow next() { return NextRow(*this); }
+
+private:
+	friend class NextRow;
+
+	static void fill(void* arg)
+	{
+		AsyncRowReader* self = static_cast<AsyncRowReader*>(arg);
+		self->rows_.clear();
+		self->pos_ = 0;
+		try {
+			while (self->rows_.size() < self->batch_) {
+				Row row = self->res_.fetch_row();
+				if (!row) {
+					self->done_ = true;
+					break;
+				}
+				self->rows_.push_back(std::move(row));
+			}
+		}
+		catch (...) {
+			self->error_ = std::current_exception();
+			self->done_ = true;
+		}
+	}
+
+	Row take()
+	{
+		if (pos_ < rows_.size()) {
+			return std::move(rows_[pos_++]);
+		}
+		if (error_) {
+			std::exception_ptr e = error_;
+			error_ = nullptr;
+			std::rethrow_exception(e);
+		}
+		return Row();
+	}
+
+	UseQueryResult& res_;
+	size_t batch_;
+	std::vector<Row> rows_;
+	size_t pos_;
+	bool done_;
+	std::exception_ptr error_;
+};
+
+} // end namespace mysqlpp
+
+#endif // defined(MYSQLPP_HAVE_COROUTINES)
+
+#endif // !defined(MYSQLPP_AWAITABLE_H)
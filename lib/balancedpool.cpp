@@ -0,0 +1,344 @@
+/***********************************************************************
+ balancedpool.cpp - Implements the BalancedConnectionPool class.
+
+ Copyright (c) 2015 by Educational Technology Resources, Inc.  Others
+ may also hold copyrights on code in this file.  See the CREDITS.txt
+ file in the top directory of the distribution for details.
+
+ This file is part of MySQL++.
+
+ MySQL++ is free software; you can redistribute it and/or modify it
+ under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 2.1 of the License, or
+ (at your option) any later version.
+
+ MySQL++ is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with MySQL++; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+ USA
+***********************************************************************/
+
+#define MYSQLPP_NOT_HEADER
+#include "balancedpool.h"
+
+#include "connection.h"
+#include "cpool.h"
+#include "exceptions.h"
+
+#include <algorithm>
+
+namespace mysqlpp {
+
+//// ping_one //////////////////////////////////////////////////////////
+// internal::probe_pool() check: ping the connection, and note how many
+// milliseconds it took in the double arg points to.
+
+static bool
+ping_one(Connection& conn, void* arg)
+{
+	unsigned long long start = internal::now_us();
+	bool ok = conn.ping();
+	*static_cast<double*>(arg) = (internal::now_us() - start) / 1000.0;
+	return ok;
+}
+
+
+BalancedConnectionPool::BalancedConnectionPool(unsigned int max_failures,
+		unsigned int retry_after, unsigned int probe_interval) :
+next_(0),
+max_failures_(max_failures ? max_failures : 1),
+retry_after_(retry_after),
+prober_(probe_main, this, probe_interval)
+{
+}
+
+
+BalancedConnectionPool::~BalancedConnectionPool()
+{
+	prober_.stop();
+}
+
+
+//// acquire ///////////////////////////////////////////////////////////
+// Grab a connection from the best server we haven't tried yet, until
+// one works or we run out of servers.
+
+Connection*
+BalancedConnectionPool::acquire(bool safe)
+{
+	std::vector<bool> tried;
+	for (;;) {
+		size_t i;
+		ConnectionPool* pool;
+		{
+			Monitor::Lock lock(monitor_);
+			tried.resize(backends_.size(), false);
+			if (!choose(tried, i)) {
+				if (backends_.empty()) {
+					throw ConnectionFailed("No database servers to "
+							"balance connections over");
+				}
+				return 0;
+			}
+
+			// Count it as busy while we wait on its pool, so other
+			// threads grabbing at the same time go elsewhere.
+			tried[i] = true;
+			pool = backends_[i].pool;
+			++backends_[i].outstanding;
+		}
+
+		Connection* pc = 0;
+		try {
+			pc = safe ? pool->safe_grab() : pool->grab();
+		}
+		catch (...) {
+			Monitor::Lock lock(monitor_);
+			--backends_[i].outstanding;
+			failed(i);
+			if (std::find(tried.begin(), tried.end(), false) ==
+					tried.end()) {
+				throw;		// that was our last hope
+			}
+			continue;
+		}
+
+		Monitor::Lock lock(monitor_);
+		if (pc) {
+			owners_[pc] = i;
+			succeeded(i);
+			return pc;
+		}
+		--backends_[i].outstanding;
+		failed(i);
+	}
+}
+
+
+size_t
+BalancedConnectionPool::add_backend(ConnectionPool& pool)
+{
+	Monitor::Lock lock(monitor_);
+	backends_.push_back(Backend(&pool));
+	prober_.start();
+	prober_.wake();
+	return backends_.size() - 1;
+}
+
+
+bool
+BalancedConnectionPool::available(size_t i) const
+{
+	Monitor::Lock lock(monitor_);
+	return i < backends_.size() && backends_[i].retry_at == 0;
+}
+
+
+size_t
+BalancedConnectionPool::backends() const
+{
+	Monitor::Lock lock(monitor_);
+	return backends_.size();
+}
+
+
+//// choose ////////////////////////////////////////////////////////////
+// Pick the untried server with the least work in flight, weighted by
+// its ping time.  A millisecond is added to each ping time so servers
+// that haven't been measured yet, or that answer in well under a
+// millisecond, are weighed by connection count alone.  Servers out of
+// rotation are only considered when there's no other choice.
+
+bool
+BalancedConnectionPool::choose(const std::vector<bool>& tried,
+		size_t& chosen)
+{
+	const time_t now = time(0);
+	const size_t n = backends_.size();
+	bool found = false;
+	double best = 0;
+	for (size_t k = 0; k < n; ++k) {
+		const size_t i = (next_ + k) % n;
+		const Backend& b = backends_[i];
+		if (tried[i] || (b.retry_at && (now < b.retry_at))) {
+			continue;
+		}
+
+		double weight = (b.outstanding + 1) * (b.latency + 1.0);
+		if (!found || (weight < best)) {
+			chosen = i;
+			best = weight;
+			found = true;
+		}
+	}
+
+	if (found) {
+		Backend& b = backends_[chosen];
+		if (b.retry_at) {
+			// Out of rotation, but due for another try.  Keep everyone
+			// else off it until we see how this one goes.
+			b.retry_at = now + retry_after_;
+		}
+	}
+	else {
+		// Everything left is out of rotation, so try the one due back
+		// soonest rather than give up without trying.
+		for (size_t i = 0; i < n; ++i) {
+			if (!tried[i] && (!found ||
+					(backends_[i].retry_at < backends_[chosen].retry_at))) {
+				chosen = i;
+				found = true;
+			}
+		}
+	}
+
+	if (found) {
+		next_ = chosen + 1;
+	}
+	return found;
+}
+
+
+//// failed ////////////////////////////////////////////////////////////
+// Count a failure against a server, and take it out of rotation if
+// there have been too many in a row.  The caller holds the lock.
+
+void
+BalancedConnectionPool::failed(size_t i)
+{
+	Backend& b = backends_[i];
+	if (++b.failures >= max_failures_) {
+		b.retry_at = time(0) + retry_after_;
+	}
+}
+
+
+Connection*
+BalancedConnectionPool::grab()
+{
+	return acquire(false);
+}
+
+
+double
+BalancedConnectionPool::latency(size_t i) const
+{
+	Monitor::Lock lock(monitor_);
+	return i < backends_.size() ? backends_[i].latency : 0;
+}
+
+
+size_t
+BalancedConnectionPool::outstanding(size_t i) const
+{
+	Monitor::Lock lock(monitor_);
+	return i < backends_.size() ? backends_[i].outstanding : 0;
+}
+
+
+//// probe /////////////////////////////////////////////////////////////
+// Ping a connection to each server, keeping a moving average of the
+// ping times, and putting servers that answer back into rotation.
+
+void
+BalancedConnectionPool::probe()
+{
+	// Copy what we need, so we don't hold the lock while we ping
+	std::vector<ConnectionPool*> pools;
+	{
+		Monitor::Lock lock(monitor_);
+		for (size_t i = 0; i < backends_.size(); ++i) {
+			pools.push_back(backends_[i].pool);
+		}
+	}
+
+	for (size_t i = 0; i < pools.size(); ++i) {
+		bool ok;
+		double ms = 0;
+		if (internal::probe_pool(*pools[i], ping_one, &ms, ok)) {
+			Monitor::Lock lock(monitor_);
+			Backend& b = backends_[i];
+			if (ok) {
+				b.latency = b.latency > 0 ? 0.75 * b.latency + 0.25 * ms : ms;
+				succeeded(i);
+			}
+			else {
+				failed(i);
+			}
+		}
+	}
+}
+
+
+void
+BalancedConnectionPool::probe_main(void* bp)
+{
+	static_cast<BalancedConnectionPool*>(bp)->probe();
+}
+
+
+void
+BalancedConnectionPool::release(const Connection* pc)
+{
+	ConnectionPool* pool = 0;
+	{
+		Monitor::Lock lock(monitor_);
+		OwnerMap::iterator it = owners_.find(pc);
+		if (it != owners_.end()) {
+			pool = backends_[it->second].pool;
+			--backends_[it->second].outstanding;
+			owners_.erase(it);
+		}
+	}
+
+	if (pool) {
+		pool->release(pc);
+	}
+}
+
+
+void
+BalancedConnectionPool::remove(const Connection* pc)
+{
+	ConnectionPool* pool = 0;
+	{
+		Monitor::Lock lock(monitor_);
+		OwnerMap::iterator it = owners_.find(pc);
+		if (it != owners_.end()) {
+			pool = backends_[it->second].pool;
+			--backends_[it->second].outstanding;
+			failed(it->second);
+			owners_.erase(it);
+		}
+	}
+
+	if (pool) {
+		pool->remove(pc);
+	}
+}
+
+
+Connection*
+BalancedConnectionPool::safe_grab()
+{
+	return acquire(true);
+}
+
+
+//// succeeded /////////////////////////////////////////////////////////
+// Note that a server is working, putting it back into rotation if it
+// was out.  The caller holds the lock.
+
+void
+BalancedConnectionPool::succeeded(size_t i)
+{
+	backends_[i].failures = 0;
+	backends_[i].retry_at = 0;
+}
+
+} // end namespace mysqlpp
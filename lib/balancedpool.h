@@ -0,0 +1,190 @@
+/// \file balancedpool.h
+/// \brief Declares the BalancedConnectionPool class, which spreads
+/// connections over several equivalent database servers.
+
+/***********************************************************************
+ Copyright (c) 2015 by Educational Technology Resources, Inc.  Others
+ may also hold copyrights on code in this file.  See the CREDITS.txt
+ file in the top directory of the distribution for details.
+
+ This file is part of MySQL++.
+
+ MySQL++ is free software; you can redistribute it and/or modify it
+ under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 2.1 of the License, or
+ (at your option) any later version.
+
+ MySQL++ is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with MySQL++; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+ USA
+***********************************************************************/
+
+#if !defined(MYSQLPP_BALANCEDPOOL_H)
+#define MYSQLPP_BALANCEDPOOL_H
+
+#include "common.h"
+
+#include "mythread.h"
+#include "prober.h"
+
+#include <map>
+#include <vector>
+
+#include <time.h>
+
+namespace mysqlpp {
+
+#if !defined(DOXYGEN_IGNORE)
+// Make Doxygen ignore this
+class MYSQLPP_EXPORT Connection;
+class MYSQLPP_EXPORT ConnectionPool;
+#endif
+
+/// \brief Spreads connections over several equivalent database
+/// servers, each with a ConnectionPool of its own
+///
+/// Use this in front of servers that can all do the same work, such
+/// as the nodes of a Galera cluster, or a set of replicas.  Give it a
+/// ConnectionPool for each server.  These are your own ConnectionPool
+/// subclasses, each with a create() that knows how to connect to its
+/// server.  Then grab() and release() connections through this object
+/// instead, or use a ScopedConnection built on it.
+///
+/// Each grab() goes to the server with the fewest connections grabbed
+/// through us and not yet released, weighted by how long that server
+/// takes to answer a ping.  So busy servers and slow ones both get
+/// less of the new work.
+///
+/// A server that fails \c max_failures times in a row is taken out of
+/// rotation for \c retry_after seconds.  A failure is its pool throwing
+/// from grab(), a failed health check, or your remove() of one of its
+/// connections.  Afterward, one grab() or health check tries it again,
+/// and if that works, it's back.  If every server is out, grab() tries
+/// the one due back soonest anyway, rather than fail without trying.
+///
+/// A background thread checks each server every \c probe_interval
+/// seconds by pinging one of its connections.  That's where the
+/// latency figures come from.  If the platform doesn't support threads,
+/// servers are weighted only by connection count.
+///
+/// The ConnectionPool objects must outlive this object.
+
+class MYSQLPP_EXPORT BalancedConnectionPool
+{
+public:
+	/// \brief Create the object
+	///
+	/// \param max_failures consecutive failures that take a server
+	///     out of rotation
+	/// \param retry_after seconds to leave a server out of rotation
+	/// \param probe_interval seconds between health checks, or 0 for
+	///     none
+	explicit BalancedConnectionPool(unsigned int max_failures = 3,
+			unsigned int retry_after = 10, unsigned int probe_interval = 5);
+
+	/// \brief Destroy the object, stopping the health check thread
+	///
+	/// Release all connections grabbed through this object first.
+	~BalancedConnectionPool();
+
+	/// \brief Add a server's pool
+	///
+	/// \retval the server's index, for the per-server accessors
+	size_t add_backend(ConnectionPool& pool);
+
+	/// \brief Returns true if the server is in rotation
+	bool available(size_t i) const;
+
+	/// \brief Get the number of servers added
+	size_t backends() const;
+
+	/// \brief Grab a connection from the least loaded server
+	///
+	/// If that server's pool throws, the failure is counted against
+	/// the server and the next best one is tried, until all have
+	/// been.  Then the last exception is rethrown.
+	Connection* grab();
+
+	/// \brief Get the server's recent ping time in milliseconds, or 0
+	/// if it hasn't been measured yet
+	double latency(size_t i) const;
+
+	/// \brief Get the number of connections grabbed from the server
+	/// through us and not yet released
+	size_t outstanding(size_t i) const;
+
+	/// \brief Return a connection to the pool it came from
+	void release(const Connection* pc);
+
+	/// \brief Remove a bad connection from the pool it came from
+	///
+	/// This counts as a failure of its server.
+	void remove(const Connection* pc);
+
+	/// \brief Grab a connection from the least loaded server, testing
+	/// that it's connected first
+	///
+	/// This uses ConnectionPool::safe_grab() instead of grab().
+	Connection* safe_grab();
+
+private:
+	BalancedConnectionPool(const BalancedConnectionPool&);
+	BalancedConnectionPool& operator =(const BalancedConnectionPool&);
+
+	/// \brief A server's pool and what we know about its health
+	struct Backend {
+		ConnectionPool* pool;
+		size_t outstanding;		// grabbed through us, not released
+		double latency;			// smoothed ping time in ms, or 0
+		unsigned int failures;	// in a row
+		time_t retry_at;		// out of rotation until then, or 0
+
+		explicit Backend(ConnectionPool* p) :
+		pool(p),
+		outstanding(0),
+		latency(0),
+		failures(0),
+		retry_at(0)
+		{
+		}
+	};
+
+	typedef std::map<const Connection*, size_t> OwnerMap;
+
+	/// \brief Common implementation of grab() and safe_grab()
+	Connection* acquire(bool safe);
+
+	/// \brief Pick the server for the next grab, skipping those
+	/// already tried; returns false if there are none left
+	bool choose(const std::vector<bool>& tried, size_t& chosen);
+
+	/// \brief Record a failure of server i, with the lock held
+	void failed(size_t i);
+
+	/// \brief Check every server's health, on the calling thread
+	void probe();
+
+	/// \brief probe(), in the form the health check thread calls
+	static void probe_main(void* bp);
+
+	/// \brief Record a success of server i, with the lock held
+	void succeeded(size_t i);
+
+	std::vector<Backend> backends_;
+	OwnerMap owners_;			// server each connection came from
+	size_t next_;				// server to look at first, to break ties
+	const unsigned int max_failures_;
+	const unsigned int retry_after_;
+	mutable Monitor monitor_;
+	internal::Prober prober_;	// health check thread
+};
+
+} // end namespace mysqlpp
+
+#endif // !defined(MYSQLPP_BALANCEDPOOL_H)
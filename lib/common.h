@@ -127,6 +127,14 @@
 	#define MYSQLPP_PATH_SEPARATOR '/'
 #endif
 
+// C++17 removed dynamic exception specifications, so only use them
+// with older compilers, where they still document what may be thrown.
+#if __cplusplus >= 201103L
+#	define MYSQLPP_MAY_THROW(what) noexcept(false)
+#else
+#	define MYSQLPP_MAY_THROW(what) throw(what)
+#endif
+
 #if defined(MYSQLPP_MYSQL_HEADERS_BURIED)
 #	include <mysql/mysql_version.h>
 #else
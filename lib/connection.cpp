@@ -30,6 +30,7 @@
 #include "dbdriver.h"
 #include "query.h"
 #include "result.h"
+#include "stmtcache.h"
 
 using namespace std;
 
@@ -38,7 +39,9 @@ namespace mysqlpp {
 Connection::Connection(bool te) :
 OptionalExceptions(te),
 driver_(new DBDriver()),
-copacetic_(true)
+stmt_cache_(0),
+copacetic_(true),
+dirty_(false)
 {
 }
 
@@ -47,7 +50,9 @@ Connection::Connection(const char* db, const char* server,
 		const char* user, const char* password, unsigned int port) :
 OptionalExceptions(),
 driver_(new DBDriver()),
-copacetic_(true)
+stmt_cache_(0),
+copacetic_(true),
+dirty_(false)
 {
 	try {
 		connect(db, server, user, password, port);
@@ -63,7 +68,9 @@ copacetic_(true)
 
 Connection::Connection(const Connection& other) :
 OptionalExceptions(other.throw_exceptions()),
-driver_(new DBDriver(*other.driver_))
+driver_(new DBDriver(*other.driver_)),
+stmt_cache_(0),
+dirty_(false)
 {
 	copy(other);
 }
@@ -71,6 +78,9 @@ driver_(new DBDriver(*other.driver_))
 
 Connection::~Connection()
 {
+	// Close cached statements while the connection is still up, so the
+	// server can release them, too.
+	delete stmt_cache_;
 	disconnect();
 	delete driver_;
 }
@@ -99,6 +109,7 @@ Connection::connect(const char* db, const char* server,
 	// Figure out what the server parameter means, then try to establish
 	// the connection.
 	error_message_.clear();
+	dirty_ = false;
 	string host, socket_name;
 	copacetic_ = parse_ipc_method(server, host, port, socket_name) &&
 			driver_->connect(host.c_str(),
@@ -126,6 +137,7 @@ void
 Connection::copy(const Connection& other)
 {
 	error_message_.clear();
+	dirty_ = false;
 	set_exceptions(other.throw_exceptions());
 	driver_->copy(*other.driver_);
 }
@@ -156,10 +168,25 @@ Connection::create_db(const std::string& db)
 }
 
 
+std::string
+Connection::current_db() const
+{
+	return driver_->current_db();
+}
+
+
+bool
+Connection::dirty() const
+{
+	return dirty_ || driver_->in_transaction();
+}
+
+
 void
 Connection::disconnect()
 {
 	error_message_.clear();
+	dirty_ = false;
 	driver_->disconnect();
 }
 
@@ -266,6 +293,13 @@ Connection::protocol_version() const
 }
 
 
+PreparedQueryPtr
+Connection::prepare(const std::string& sql)
+{
+	return statement_cache().get(sql);
+}
+
+
 Query
 Connection::query(const char* qstr)
 {
@@ -280,6 +314,39 @@ Connection::query(const std::string& qstr)
 }
 
 
+bool
+Connection::reset_session()
+{
+	error_message_.clear();
+	if (connected()) {
+		// The C API detaches the statements prepared in this session,
+		// even if the reset goes wrong partway through, so don't hand
+		// the cached ones out again
+		if (stmt_cache_) {
+			stmt_cache_->clear();
+		}
+
+		if (driver_->reset_session()) {
+			dirty_ = false;
+			return true;
+		}
+		else {
+			if (throw_exceptions()) {
+				throw ConnectionFailed(error(), errnum());
+			}
+			return false;
+		}
+	}
+	else {
+		build_error_message("reset the session");
+		if (throw_exceptions()) {
+			throw ConnectionFailed(error_message_.c_str());
+		}
+		return false;
+	}
+}
+
+
 bool
 Connection::select_db(const std::string& db)
 {
@@ -312,6 +379,17 @@ Connection::server_status() const
 }
 
 
+StatementCache&
+Connection::statement_cache()
+{
+	if (!stmt_cache_) {
+		stmt_cache_ = new StatementCache(this);
+	}
+
+	return *stmt_cache_;
+}
+
+
 std::string
 Connection::server_version() const
 {
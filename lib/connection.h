@@ -39,6 +39,8 @@
 
 #include "noexceptions.h"
 #include "options.h"
+#include "prepared.h"
+#include "refcounted.h"
 
 #include <string>
 
@@ -47,6 +49,7 @@ namespace mysqlpp {
 #if !defined(DOXYGEN_IGNORE)
 // Make Doxygen ignore this
 class MYSQLPP_EXPORT Query;
+class MYSQLPP_EXPORT StatementCache;
 class DBDriver;
 #endif
 
@@ -152,6 +155,20 @@ public:
 	/// \return true if database was created successfully
 	bool create_db(const std::string& db);
 
+	/// \brief Get the name of the current default database, or an
+	/// empty string if there isn't one
+	///
+	/// See DBDriver::current_db() for limitations.
+	std::string current_db() const;
+
+	/// \brief Returns true if this connection's session state may
+	/// have changed from the way it was just after connecting
+	///
+	/// That's so if mark_dirty() was called since the connection was
+	/// established or reset_session() last succeeded, or if the
+	/// server says a transaction is still open.
+	bool dirty() const;
+
 	/// \brief Drop the connection to the database server
 	void disconnect();
 
@@ -222,6 +239,15 @@ public:
 		return copacetic_ ? &Connection::copacetic_ : 0;
 	}
 
+	/// \brief Note that this connection's session state has changed
+	///
+	/// Call this after changing anything that would leak into the next
+	/// user's work if the connection were shared, such as session
+	/// variables, temporary tables or table locks.  An open transaction
+	/// is noticed without this.  A ConnectionPool can then reset the
+	/// session on release, while skipping that for clean connections.
+	void mark_dirty() { dirty_ = true; }
+
 	/// \brief Copy an existing Connection object's state into this
 	/// object.
 	Connection& operator=(const Connection& rhs);
@@ -255,6 +281,31 @@ public:
 	/// \param qstr initial query string
 	Query query(const std::string& qstr);
 
+	/// \brief Get a prepared statement for the given SQL, reusing one
+	/// prepared earlier on this connection if possible
+	///
+	/// \param sql SQL statement, with \c ? placeholders for parameters
+	///
+	/// Statements come from this connection's StatementCache, so
+	/// repeated calls with the same SQL only go to the server the first
+	/// time.  If the statement fails to prepare, the returned object
+	/// tests as false, or the call throws if exceptions are enabled.
+	RefCountedPointer<PreparedQuery> prepare(const std::string& sql);
+
+	/// \brief Put the session back the way it was just after
+	/// connecting, without reconnecting
+	///
+	/// Rolls back any open transaction, drops temporary tables, releases
+	/// table locks and resets session variables, then clears the
+	/// dirty() flag.  The server forgets this connection's prepared
+	/// statements too, so this empties statement_cache(); statements
+	/// you still hold prepare themselves again the next time they're
+	/// run.  See DBDriver::reset_session() for details.
+	///
+	/// \retval true if the session was reset.  If not, and exceptions
+	/// are enabled, throws ConnectionFailed instead.
+	bool reset_session();
+
 	/// \brief Change to a different database managed by the
 	/// database server we are connected to.
 	///
@@ -297,6 +348,12 @@ public:
 	/// \brief Returns information about database server's status
 	std::string server_status() const;
 
+	/// \brief Get this connection's prepared statement cache
+	///
+	/// Use this to change the cache's size, or to get its hit and miss
+	/// counts.
+	StatementCache& statement_cache();
+
 	/// \brief Returns true if both MySQL++ and database driver we're
 	/// using were compiled with thread awareness.
 	static bool thread_aware();
@@ -353,7 +410,9 @@ protected:
 
 private:
 	DBDriver* driver_;
+	StatementCache* stmt_cache_;
 	bool copacetic_;
+	bool dirty_;
 };
 
 
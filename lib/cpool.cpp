@@ -27,40 +27,289 @@
 #include "cpool.h"
 
 #include "connection.h"
+#include "noexceptions.h"
 
 #include <algorithm>
-#include <functional>
+#include <climits>
+#include <set>
 
 namespace mysqlpp {
 
+//// Unlock ////////////////////////////////////////////////////////////
+// The reverse of Monitor::Lock: releases the monitor for as long as
+// the object exists, so we can call out to create() and destroy()
+// without holding up other threads.  Reacquires it on the way out,
+// even when leaving by an exception.
 
-/// \brief Functor to test whether a given ConnectionInfo object is
-/// "too old".
-///
-/// \internal This is a template only because ConnectionInfo is private.
-/// Making it a template means the private type is only used at the point
-/// of instantiation, where it is accessible.
+namespace {
+	class Unlock
+	{
+	public:
+		explicit Unlock(Monitor& m) :
+		monitor_(m)
+		{
+			m.unlock();
+		}
+
+		~Unlock() { monitor_.lock(); }
+
+	private:
+		Unlock(const Unlock&);				// can't copy
+		Unlock& operator =(const Unlock&);	// can't assign
+
+		Monitor& monitor_;
+	};
+}
+
+
+//// SlotTable, Pools /////////////////////////////////////////////////
+// A thread's cache slots, one for each pool it keeps connections from,
+// tagged with the owning pool's serial number.  Pools all share the one
+// thread-local variable pointing to these, instead of having one each,
+// since the platform only has so many to go around.  Pools records the
+// serial numbers of pools still alive, so threads can drop the entries
+// of those destroyed.
+
+typedef std::vector<std::pair<unsigned long, void*> > SlotTable;
+
+static void
+delete_table(void* table)
+{
+	delete static_cast<SlotTable*>(table);
+}
 
-template <typename ConnInfoT>
-class TooOld : std::unary_function<ConnInfoT, bool>
+struct Pools
 {
-public:
-#if !defined(DOXYGEN_IGNORE)
-	TooOld(unsigned int tmax) :
-	min_age_(time(0) - tmax)
+	BeecryptMutex mutex;		// guards last_serial and live
+	unsigned long last_serial;
+	std::set<unsigned long> live;
+	ThreadLocal tables;			// each thread's SlotTable
+
+	Pools() :
+	last_serial(0),
+	tables(delete_table)
 	{
 	}
+};
 
-	bool operator()(const ConnInfoT& conn_info) const
-	{
-		return !conn_info.in_use && conn_info.last_used <= min_age_;
+static Pools&
+pools()
+{
+	static Pools p;
+	return p;
+}
+
+// Create that before main() can start any threads, since not every
+// compiler makes function-local statics thread-safe
+static Pools& pools_init = pools();
+
+
+//// ~ConnectionPool ///////////////////////////////////////////////////
+// Our subclass's dtor has emptied the pool already by calling clear(),
+// so only the thread cache slots are left to free.  Threads' SlotTables
+// may still point at them, but under a serial number that no longer
+// matches any pool, so they'll never be looked at again.
+
+ConnectionPool::~ConnectionPool()
+{
+	assert(empty());
+	for (size_t i = 0; i < slots_.size(); ++i) {
+		delete slots_[i];
 	}
 
-#endif
-private:
-	time_t min_age_;
-};
+	Pools& p = pools();
+	ScopedLock lock(p.mutex);
+	p.live.erase(serial_);
+}
+
+
+//// acquire ///////////////////////////////////////////////////////////
+// Common implementation of the grab() variants.  A negative timeout
+// means wait as long as it takes.  If db isn't 0, prefer a connection
+// using that database; the caller switches it if need be.
+
+Connection*
+ConnectionPool::acquire(long timeout_ms, unsigned long* waited_ms,
+		const std::string* db)
+{
+	if (Connection* pc = cache_grab(db)) {
+		if (waited_ms) {
+			*waited_ms = 0;
+		}
+		return pc;
+	}
+
+	unsigned long long start = internal::now_ms();
+	Waiter w;
+	w.start = internal::now_us();
+	Doomed doomed(*this);
+	Monitor::Lock lock(monitor_);	// ensure we're not interfered with
+	remove_old_connections(doomed);
+	start_maintenance();
+
+	if (must_wait()) {
+		if ((timeout_ms == 0) || !Thread::supported()) {
+			++stats_.timeouts;
+			if (waited_ms) {
+				*waited_ms = 0;
+			}
+			return 0;
+		}
+
+		waiters_.push_back(&w);
+		while (!w.conn && !w.may_create) {
+			if (timeout_ms < 0) {
+				monitor_.wait();
+				continue;
+			}
+
+			unsigned long long waited = internal::now_ms() - start;
+			if (waited >= static_cast<unsigned long long>(timeout_ms)) {
+				waiters_.erase(std::find(waiters_.begin(), waiters_.end(),
+						&w));
+				++stats_.timeouts;
+				if (waited_ms) {
+					*waited_ms = static_cast<unsigned long>(waited);
+				}
+				return 0;
+			}
+			monitor_.wait(static_cast<unsigned long>(timeout_ms - waited));
+		}
+	}
+
+	if (waited_ms) {
+		*waited_ms = static_cast<unsigned long>(internal::now_ms() - start);
+	}
+
+	return take(w, db, doomed);
+}
+
+
+//// add ///////////////////////////////////////////////////////////////
+// Put a newly-created connection into the pool.
+
+ConnectionPool::ConnectionInfo&
+ConnectionPool::add(Connection* pc, bool in_use)
+{
+	ConnectionInfo& ci = pool_.insert(
+			PoolT::value_type(pc, ConnectionInfo(pc))).first->second;
+	if (!in_use) {
+		ci.in_use = false;
+		push_idle(ci);
+	}
+	return ci;
+}
+
+
+//// cache_grab ////////////////////////////////////////////////////////
+// Take back the connection the calling thread kept when it last
+// released one, if any, without locking the pool.  For grab(db), only
+// take it if it's using that database; the pool may have a better
+// match than switching this one.
+
+Connection*
+ConnectionPool::cache_grab(const std::string* db)
+{
+	CacheSlot* slot = this_slot();
+	if (!slot) {
+		return 0;
+	}
+
+	ScopedLock lock(slot->mutex);
+	Connection* pc = slot->conn;
+	if (pc && db && (pc->current_db() != *db)) {
+		pc = 0;
+	}
+	if (pc) {
+		slot->conn = 0;
+		slot->last_conn = pc;
+		slot->last_ok = slot->kept;
+		slot->held = pc;
+		slot->held_since = internal::now_us();
+		slot->waits.record(0);
+	}
+	return pc;
+}
+
+
+//// cache_release /////////////////////////////////////////////////////
+// Keep a released connection for the calling thread's next grab(), if
+// thread_cache_time() says to and the thread isn't keeping one already.
+// Returns false if the caller must release it to the pool instead,
+// including when it doesn't know how long the connection was held, so
+// the pool can work that out.
+
+bool
+ConnectionPool::cache_release(Connection* pc, bool timed,
+		unsigned long long held_us)
+{
+	if (!thread_cache_time() || !Thread::supported()) {
+		return false;
+	}
 
+	CacheSlot* slot = this_slot();
+	if (!slot) {
+		// First release on this thread, so give it a slot.  Its next
+		// grab() is timed there, so that release can be kept.
+		slot = new CacheSlot;
+		try {
+			Monitor::Lock lock(monitor_);
+			slots_.push_back(slot);
+		}
+		catch (...) {
+			delete slot;
+			throw;
+		}
+		remember_slot(slot);
+	}
+
+	ScopedLock lock(slot->mutex);
+	if (!timed || slot->conn || slot->bypass) {
+		return false;
+	}
+	slot->conn = pc;
+	slot->kept = time(0);
+	slot->holds.record(held_us);
+	return true;
+}
+
+
+//// check_idle ////////////////////////////////////////////////////////
+// Ping an idle connection for the maintenance thread, dropping it if
+// it's gone bad.  Call with the lock held.  Does nothing if the
+// connection is no longer idle or in the pool.
+
+void
+ConnectionPool::check_idle(const Connection* pc, Doomed& doomed)
+{
+	PoolIt it = pool_.find(pc);
+	if ((it == pool_.end()) || it->second.in_use) {
+		return;
+	}
+
+	// Mark it in use while we ping it, so grab() passes it over
+	ConnectionInfo& ci = it->second;
+	unlink_idle(ci);
+	ci.in_use = true;
+
+	bool ok;
+	{
+		Unlock unlock(monitor_);
+		ok = ci.conn->ping();
+	}
+
+	if (!ok) {
+		++stats_.check_failures;
+		remove(it, doomed);
+	}
+	else {
+		ci.last_ok = time(0);
+		if (!wake_waiter(ci.conn)) {
+			ci.in_use = false;
+			push_idle(ci);
+		}
+	}
+}
 
 
 //// clear /////////////////////////////////////////////////////////////
@@ -71,12 +320,20 @@ private:
 void
 ConnectionPool::clear(bool all)
 {
-	ScopedLock lock(mutex_);	// ensure we're not interfered with
+	if (all) {
+		// Our subclass is going away, so the maintenance thread mustn't
+		// call its create() any more
+		stop_maintenance();
+	}
+
+	Doomed doomed(*this);
+	Monitor::Lock lock(monitor_);	// ensure we're not interfered with
+	reclaim(true);
 
 	PoolIt it = pool_.begin();
 	while (it != pool_.end()) {
-		if (all || !it->in_use) {
-			remove(it++);
+		if (all || !it->second.in_use) {
+			remove(it++, doomed);
 		}
 		else {
 			++it;
@@ -85,6 +342,49 @@ ConnectionPool::clear(bool all)
 }
 
 
+//// closed ////////////////////////////////////////////////////////////
+// Account for n connections removed from the pool having been
+// destroyed, handing the room they leave to waiting threads.
+
+void
+ConnectionPool::closed(size_t n)
+{
+	Monitor::Lock lock(monitor_);	// ensure we're not interfered with
+	closing_ -= n;
+	stats_.destroys += n;
+	while (n-- && wake_waiter(0)) {
+	}
+}
+
+
+//// Doomed::destroy_all ///////////////////////////////////////////////
+
+// Connections still count toward max_size() until they're destroyed,
+// so once they are, make room for threads waiting in grab(), if any.
+// Call without the lock held.
+
+void
+ConnectionPool::Doomed::destroy_all()
+{
+	if (conns_.empty()) {
+		return;
+	}
+
+	std::vector<Connection*> conns;
+	conns.swap(conns_);
+	try {
+		for (size_t i = 0; i < conns.size(); ++i) {
+			pool_.destroy(conns[i]);
+		}
+	}
+	catch (...) {
+		pool_.closed(conns.size());
+		throw;
+	}
+	pool_.closed(conns.size());
+}
+
+
 //// exchange //////////////////////////////////////////////////////////
 // Passed connection is defective, so remove it from the pool and return
 // a new one.
@@ -101,60 +401,526 @@ ConnectionPool::exchange(const Connection* pc)
 }
 
 
-//// find_mru //////////////////////////////////////////////////////////
-// Find most recently used available connection.  Uses operator< for
-// ConnectionInfo to order pool with MRU connection last.  Returns 0 if
-// there are no connections not in use.
+//// fill //////////////////////////////////////////////////////////////
+// Create an idle connection for min_idle(), or hand it straight to a
+// thread waiting in grab(), if any.  Call with the lock held.  Returns
+// false if create() failed.
 
-Connection*
-ConnectionPool::find_mru()
+bool
+ConnectionPool::fill()
 {
-	PoolIt mru = std::max_element(pool_.begin(), pool_.end());
-	if (mru != pool_.end() && !mru->in_use) {
-		mru->in_use = true;
-		return mru->conn;
+	++pending_;
+	Connection* pc = 0;
+	try {
+		Unlock unlock(monitor_);
+		pc = create();
+	}
+	catch (...) {
+	}
+	--pending_;
+
+	if (pc) {
+		++stats_.creates;
+		add(pc, wake_waiter(pc));
+		return true;
 	}
 	else {
-		return 0;
+		++stats_.create_failures;
+		// Pass the room we had on to the next in line, if any
+		wake_waiter(0);
+		return false;
 	}
 }
 
 
+//// finish_grab /////////////////////////////////////////////////////
+
+Connection*
+ConnectionPool::finish_grab(Waiter& w)
+{
+	if (!w.conn && !w.may_create) {
+		return 0;				// queue_grab() found we'd wait forever
+	}
+
+	Doomed doomed(*this);
+	Monitor::Lock lock(monitor_);	// ensure we're not interfered with
+	return take(w, 0, doomed);
+}
+
+
+//// full //////////////////////////////////////////////////////////////
+// Returns true if the pool has max_size() connections already, counting
+// those being created or destroyed.  Call with the lock held.
+
+bool
+ConnectionPool::full()
+{
+	unsigned int max = max_size();
+	return max && (pool_.size() + pending_ + closing_ >= max);
+}
+
+
 //// grab //////////////////////////////////////////////////////////////
+// 2 versions: the first takes whatever connection is handy, and the
+// second one using the given database, switching it over if need be.
 
 Connection*
 ConnectionPool::grab()
 {
-	ScopedLock lock(mutex_);	// ensure we're not interfered with
-	remove_old_connections();
-	if (Connection* mru = find_mru()) {
-		return mru;
+	return acquire(-1, 0, 0);
+}
+
+Connection*
+ConnectionPool::grab(const std::string& db)
+{
+	Connection* pc = acquire(-1, 0, &db);
+	if (!pc || (pc->current_db() == db)) {
+		return pc;
+	}
+
+	// Switch it over, or put it back if we can't
+	bool ok;
+	try {
+		ok = pc->select_db(db);
+	}
+	catch (...) {
+		release(pc);
+		throw;
+	}
+	if (!ok) {
+		release(pc);
+		return 0;
+	}
+
+	Monitor::Lock lock(monitor_);	// ensure we're not interfered with
+	++stats_.db_switches;
+	return pc;
+}
+
+
+//// grabbed ///////////////////////////////////////////////////////////
+// Note that acquire(), which started looking at the given time, is
+// handing out ci's connection.  If the calling thread has a cache slot,
+// it times the hold there, so release() can tell how long it was held
+// without locking the pool; any connection the thread grabbed before
+// and still holds gets its time moved to its ConnectionInfo instead.
+// Call with the lock held.
+
+Connection*
+ConnectionPool::grabbed(ConnectionInfo& ci, unsigned long long start)
+{
+	unsigned long long now = internal::now_us();
+	stats_.wait_us.record(now - start);
+	ci.grabbed = now;
+
+	if (CacheSlot* slot = this_slot()) {
+		if (slot->held && (slot->held != ci.conn)) {
+			PoolIt it = pool_.find(slot->held);
+			if ((it != pool_.end()) && it->second.in_use) {
+				it->second.grabbed = slot->held_since;
+			}
+		}
+		slot->held = ci.conn;
+		slot->held_since = now;
+	}
+	return ci.conn;
+}
+
+
+//// idle_for //////////////////////////////////////////////////////////
+// Pick the idle connection acquire() should hand out, or 0 if none are
+// idle.  Normally that's the most recently used one.  If db isn't 0,
+// it's the most recently used one already on that database, else the
+// least recently used one, which the caller will switch over.  The
+// first such call starts indexing the idle list by database.  Call
+// with the lock held.
+
+ConnectionPool::ConnectionInfo*
+ConnectionPool::idle_for(const std::string* db)
+{
+	if (!db || !newest_idle_) {
+		return newest_idle_;
+	}
+
+	if (!index_db_) {
+		for (ConnectionInfo* ci = oldest_idle_; ci; ci = ci->newer) {
+			ci->db_entry = idle_by_db_.insert(
+					DbIndex::value_type(ci->conn->current_db(), ci));
+		}
+		index_db_ = true;
+	}
+
+	// Entries with the same database are kept in the order they were
+	// added, so the last of them is the most recently used.
+	std::pair<DbIndex::iterator, DbIndex::iterator> range =
+			idle_by_db_.equal_range(*db);
+	if (range.first != range.second) {
+		return (--range.second)->second;
+	}
+	return oldest_idle_;
+}
+
+
+//// maintain //////////////////////////////////////////////////////////
+// Maintenance thread body: take back connections threads kept too
+// long, drop connections idle past max_idle_time(),
+// check idle ones every validate_interval() seconds, and keep min_idle()
+// of them ready, until stop_maintenance() tells us to quit.
+
+void
+ConnectionPool::maintain()
+{
+	unsigned long long next_check = 0, retry_at = 0;
+	std::vector<const Connection*> due;
+	Doomed doomed(*this);
+	Monitor::Lock lock(monitor_);
+	while (!stopping_) {
+		reclaim(false);
+		remove_old_connections(doomed);
+		if (!doomed.empty()) {
+			Unlock unlock(monitor_);
+			doomed.destroy_all();
+			continue;
+		}
+
+		unsigned long long now = internal::now_ms();
+		unsigned int interval = validate_interval();
+		if (interval && (now >= next_check)) {
+			// List the connections not known to be good lately, then
+			// check them one by one.  The pool can change each time we
+			// release the lock to ping one, so check_idle() looks each
+			// up again.
+			time_t since = time(0) - interval;
+			for (ConnectionInfo* ci = oldest_idle_; ci; ci = ci->newer) {
+				if (ci->last_ok <= since) {
+					due.push_back(ci->conn);
+				}
+			}
+			for (size_t i = 0; !stopping_ && (i < due.size()); ++i) {
+				check_idle(due[i], doomed);
+			}
+			due.clear();
+			next_check = internal::now_ms() +
+					static_cast<unsigned long long>(interval) * 1000;
+			continue;
+		}
+
+		if ((now >= retry_at) && needs_filling()) {
+			if (!fill()) {
+				// Don't hammer a server that just refused us
+				retry_at = internal::now_ms() + 1000;
+			}
+			continue;
+		}
+
+		// Sleep until there's something to do, or until notified that
+		// grab() took an idle connection, waking at least once a second
+		// to drop old connections and notice policy changes.
+		unsigned long long wake = now + 1000;
+		if (interval) {
+			wake = std::min(wake, next_check);
+		}
+		if (retry_at > now) {
+			wake = std::min(wake, retry_at);
+		}
+		monitor_.wait(static_cast<unsigned long>(wake - now));
+	}
+}
+
+
+//// maintain_main /////////////////////////////////////////////////////
+// Maintenance thread entry point
+
+void
+ConnectionPool::maintain_main(void* pool)
+{
+	static_cast<ConnectionPool*>(pool)->maintain();
+}
+
+
+//// must_wait ///////////////////////////////////////////////////////
+// Returns true if a grab() starting now has to wait its turn: the pool
+// is full, or others are already waiting; queue jumpers would make the
+// wait unfair.  Takes back any connections other threads are keeping
+// for themselves first.  Call with the lock held.
+
+bool
+ConnectionPool::must_wait()
+{
+	bool wait = !waiters_.empty() || (!newest_idle_ && full());
+	if (wait && !slots_.empty()) {
+		reclaim(true);
+		wait = !waiters_.empty() || (!newest_idle_ && full());
+	}
+	return wait;
+}
+
+
+//// needs_check ///////////////////////////////////////////////////////
+// Returns true if safe_grab() should ping pc, because it's not known to
+// have been good within the last validate_after() seconds.
+
+bool
+ConnectionPool::needs_check(const Connection* pc)
+{
+	unsigned int after = validate_after();
+	if (after == 0) {
+		return true;
+	}
+
+	CacheSlot* slot = this_slot();
+	if (slot && (slot->last_conn == pc) &&
+			(time(0) - slot->last_ok < time_t(after))) {
+		return false;		// kept by this thread since then
+	}
+
+	Monitor::Lock lock(monitor_);	// ensure we're not interfered with
+	PoolIt it = pool_.find(pc);
+	return (it == pool_.end()) ||
+			(time(0) - it->second.last_ok >= time_t(after));
+}
+
+
+//// needs_filling /////////////////////////////////////////////////////
+// Returns true if the maintenance thread should create another
+// connection now.  Call with the lock held.
+
+bool
+ConnectionPool::needs_filling()
+{
+	return !stopping_ && (idle_count_ < min_idle()) && !full();
+}
+
+
+//// prewarm ///////////////////////////////////////////////////////////
+
+void
+ConnectionPool::prewarm()
+{
+	Monitor::Lock lock(monitor_);	// ensure we're not interfered with
+	start_maintenance();
+}
+
+
+//// push_idle /////////////////////////////////////////////////////////
+// Put a connection on the idle list, keeping the list in last-used
+// order.  A connection just released goes on the newest end straight
+// away; only one the maintenance thread just checked can belong
+// further along.
+
+void
+ConnectionPool::push_idle(ConnectionInfo& ci)
+{
+	ConnectionInfo* newer = 0;
+	ConnectionInfo* older = newest_idle_;
+	while (older && (older->last_used > ci.last_used)) {
+		newer = older;
+		older = older->older;
+	}
+
+	ci.newer = newer;
+	ci.older = older;
+	if (newer) {
+		newer->older = &ci;
+	}
+	else {
+		newest_idle_ = &ci;
+	}
+	if (older) {
+		older->newer = &ci;
 	}
 	else {
-		// No free connections, so create and return a new one.
-		pool_.push_back(ConnectionInfo(create()));
-		return pool_.back().conn;
+		oldest_idle_ = &ci;
+	}
+	++idle_count_;
+
+	if (index_db_) {
+		ci.db_entry = idle_by_db_.insert(
+				DbIndex::value_type(ci.conn->current_db(), &ci));
+	}
+}
+
+
+//// queue_grab //////////////////////////////////////////////////////
+// acquire() up to the point of waiting, except that instead of waiting
+// we leave w in line for wake_waiter() to call back.  If there's no
+// need to wait, claim what take() will hand out now, so that another
+// thread can't get it first and leave finish_grab() blocking after all.
+
+bool
+ConnectionPool::queue_grab(Waiter& w, void (*ready)(void*),
+		void* userdata)
+{
+	w = Waiter();
+	w.start = internal::now_us();
+	Doomed doomed(*this);
+	Monitor::Lock lock(monitor_);	// ensure we're not interfered with
+	remove_old_connections(doomed);
+	start_maintenance();
+
+	if (must_wait()) {
+		if (!Thread::supported()) {
+			++stats_.timeouts;
+			return false;
+		}
+
+		w.ready = ready;
+		w.userdata = userdata;
+		waiters_.push_back(&w);
+		return true;
+	}
+
+	if (ConnectionInfo* ci = newest_idle_) {
+		unlink_idle(*ci);
+		ci->in_use = true;
+		w.conn = ci->conn;
+		if (needs_filling()) {
+			monitor_.notify_all();		// wake the maintenance thread
+		}
+	}
+	else {
+		++pending_;
+		w.may_create = true;
+	}
+	return false;
+}
+
+
+//// reclaim ///////////////////////////////////////////////////////////
+// Take back connections threads are keeping for themselves: all of
+// them, or only those unused for thread_cache_time() seconds.  Taking
+// all also makes each thread release its next connection to the pool,
+// where a waiting thread can get it.  Call with the lock held.
+
+void
+ConnectionPool::reclaim(bool all)
+{
+	time_t min_age = time(0) - thread_cache_time();
+	for (size_t i = 0; i < slots_.size(); ++i) {
+		CacheSlot* slot = slots_[i];
+		ScopedLock lock(slot->mutex);
+		if (all) {
+			slot->bypass = true;
+		}
+
+		Connection* pc = slot->conn;
+		if (!pc || (!all && (slot->kept > min_age))) {
+			continue;
+		}
+		slot->conn = 0;
+
+		PoolIt it = pool_.find(pc);
+		if (it != pool_.end()) {
+			ConnectionInfo& ci = it->second;
+			ci.last_used = ci.last_ok = slot->kept;
+			if (!wake_waiter(pc)) {
+				ci.in_use = false;
+				push_idle(ci);
+			}
+		}
 	}
 }
 
 
+//// register_pool /////////////////////////////////////////////////////
+// Hand out a new pool's serial number, noting that it's alive.
+
+unsigned long
+ConnectionPool::register_pool()
+{
+	Pools& p = pools();
+	ScopedLock lock(p.mutex);
+	p.live.insert(++p.last_serial);
+	return p.last_serial;
+}
+
+
 //// release ///////////////////////////////////////////////////////////
 
 void
 ConnectionPool::release(const Connection* pc)
 {
-	ScopedLock lock(mutex_);	// ensure we're not interfered with
+	// grab() can return 0, and ScopedConnection passes that on
+	if (!pc) {
+		return;
+	}
+
+	// It's one of ours, so we know it's not really const
+	Connection* conn = const_cast<Connection*>(pc);
 
-	for (PoolIt it = pool_.begin(); it != pool_.end(); ++it) {
-		if (it->conn == pc) {
-			it->in_use = false;
-			it->last_used = time(0);
-			break;
+	// If this thread grabbed it last, its cache slot knows when
+	unsigned long long now = internal::now_us(), held_since = 0;
+	CacheSlot* slot = this_slot();
+	bool timed = slot && (slot->held == pc);
+	if (timed) {
+		held_since = slot->held_since;
+		slot->held = 0;
+	}
+
+	if (reset_on_release() && conn->dirty()) {
+		// Don't pass on a connection whose state we can't vouch for.
+		// Put its exception setting back before remove() destroys it.
+		bool reset;
+		{
+			NoExceptions ne(*conn);
+			reset = conn->reset_session();
+		}
+		if (!reset) {
+			remove(pc);
+			return;
+		}
+	}
+
+	if (cache_release(conn, timed, now - held_since)) {
+		return;
+	}
+
+	Monitor::Lock lock(monitor_);	// ensure we're not interfered with
+	if (slot) {
+		// Keep releasing to the pool while other threads wait
+		ScopedLock slock(slot->mutex);
+		slot->bypass = !waiters_.empty();
+	}
+
+	PoolIt it = pool_.find(pc);
+	if ((it != pool_.end()) && it->second.in_use) {
+		ConnectionInfo& ci = it->second;
+		stats_.hold_us.record(now - (timed ? held_since : ci.grabbed));
+		if (!wake_waiter(ci.conn)) {
+			ci.in_use = false;
+			ci.last_used = ci.last_ok = time(0);
+			push_idle(ci);
 		}
 	}
 }
 
 
+//// remember_slot /////////////////////////////////////////////////////
+// Add this pool's new cache slot to the calling thread's SlotTable,
+// first dropping any entries for pools since destroyed.
+
+void
+ConnectionPool::remember_slot(CacheSlot* slot)
+{
+	Pools& p = pools();
+	SlotTable* table = static_cast<SlotTable*>(p.tables.get());
+	if (!table) {
+		table = new SlotTable;
+		p.tables.set(table);
+	}
+
+	{
+		ScopedLock lock(p.mutex);
+		for (size_t i = table->size(); i-- > 0; ) {
+			if (p.live.find((*table)[i].first) == p.live.end()) {
+				table->erase(table->begin() + i);
+			}
+		}
+	}
+	table->push_back(std::make_pair(serial_, static_cast<void*>(slot)));
+}
+
+
 //// remove ////////////////////////////////////////////////////////////
 // 2 versions:
 //
@@ -162,44 +928,53 @@ ConnectionPool::release(const Connection* pc)
 // the second.  It's public, because Connection pointers are all
 // outsiders see of the pool.
 //
-// Second takes an iterator into the pool, destroys the referenced
-// connection and removes it from the pool.  This is only a utility
+// Second takes an iterator into the pool, removes the referenced
+// connection from the pool, and adds it to the list of connections
+// to destroy once the lock is released.  This is only a utility
 // function for use by other class internals.
 
 void
 ConnectionPool::remove(const Connection* pc)
 {
-	ScopedLock lock(mutex_);	// ensure we're not interfered with
+	CacheSlot* slot = this_slot();
+	if (slot && (slot->held == pc)) {
+		slot->held = 0;
+	}
 
-	for (PoolIt it = pool_.begin(); it != pool_.end(); ++it) {
-		if (it->conn == pc) {
-			remove(it);
-			return;
-		}
+	Doomed doomed(*this);
+	Monitor::Lock lock(monitor_);	// ensure we're not interfered with
+
+	PoolIt it = pool_.find(pc);
+	if (it != pool_.end()) {
+		remove(it, doomed);
 	}
 }
 
 void
-ConnectionPool::remove(const PoolIt& it)
+ConnectionPool::remove(const PoolIt& it, Doomed& doomed)
 {
 	// Don't grab the mutex.  Only called from other functions that do
 	// grab it.
-	destroy(it->conn);
+	if (!it->second.in_use) {
+		unlink_idle(it->second);
+	}
+	doomed.push_back(it->second.conn);
 	pool_.erase(it);
+	++closing_;
 }
 
 
 //// remove_old_connections ////////////////////////////////////////////
-// Remove connections that were last used too long ago.
+// Remove connections that were last used too long ago.  The idle list
+// is in release order, so they're all at its old end, and we needn't
+// look at any others.
 
 void
-ConnectionPool::remove_old_connections()
+ConnectionPool::remove_old_connections(Doomed& doomed)
 {
-	TooOld<ConnectionInfo> too_old(max_idle_time());
-
-	PoolIt it = pool_.begin();
-	while ((it = std::find_if(it, pool_.end(), too_old)) != pool_.end()) {
-		remove(it++);
+	time_t min_age = time(0) - max_idle_time();
+	while (oldest_idle_ && (oldest_idle_->last_used <= min_age)) {
+		remove(pool_.find(oldest_idle_->conn), doomed);
 	}
 }
 
@@ -210,7 +985,11 @@ Connection*
 ConnectionPool::safe_grab()
 {
 	Connection* pc;
-	while (!(pc = grab())->ping()) {
+	while ((pc = grab()) && needs_check(pc) && !pc->ping()) {
+		{
+			Monitor::Lock lock(monitor_);
+			++stats_.check_failures;
+		}
 		remove(pc);
 		pc = 0;
 	}
@@ -218,5 +997,231 @@ ConnectionPool::safe_grab()
 }
 
 
+//// stats /////////////////////////////////////////////////////////////
+// Add what threads recorded in their cache slots to what the pool
+// recorded itself, and count connections as they stand.
+
+ConnectionPool::Stats
+ConnectionPool::stats() const
+{
+	Monitor::Lock lock(monitor_);	// ensure we're not interfered with
+	Stats s(stats_);
+	for (size_t i = 0; i < slots_.size(); ++i) {
+		CacheSlot* slot = slots_[i];
+		ScopedLock slock(slot->mutex);
+		s.wait_us.merge(slot->waits);
+		s.hold_us.merge(slot->holds);
+		if (slot->conn) {
+			++s.kept;
+		}
+	}
+
+	s.idle = idle_count_;
+	s.in_use = pool_.size() - idle_count_ - s.kept;
+	s.pending = pending_;
+	s.waiting = waiters_.size();
+	return s;
+}
+
+
+//// start_maintenance /////////////////////////////////////////////////
+// Start the maintenance thread if our policies call for it and it
+// isn't running already.  Call with the lock held.
+
+void
+ConnectionPool::start_maintenance()
+{
+	if (!stopping_ && !maint_.running() && (min_idle() ||
+			validate_interval() || thread_cache_time()) &&
+			Thread::supported()) {
+		maint_.start(maintain_main, this);
+	}
+}
+
+
+//// stop_maintenance //////////////////////////////////////////////////
+// Stop the maintenance thread, if it's running, and wait for it to
+// exit.
+
+void
+ConnectionPool::stop_maintenance()
+{
+	{
+		Monitor::Lock lock(monitor_);
+		if (stopping_ || !maint_.running()) {
+			return;
+		}
+		stopping_ = true;
+		monitor_.notify_all();
+	}
+
+	maint_.join();
+
+	Monitor::Lock lock(monitor_);
+	stopping_ = false;
+}
+
+
+//// take ////////////////////////////////////////////////////////////
+// Hand out the connection a grab() gets once it's done waiting, if it
+// had to: the one put in w, else an idle one, else a new one.  Call
+// with the lock held; it's let go while we create a connection.
+
+Connection*
+ConnectionPool::take(Waiter& w, const std::string* db, Doomed& doomed)
+{
+	if (w.conn) {
+		// Handed to us by release(), so it's in the pool unless a
+		// clear() raced us
+		PoolIt it = pool_.find(w.conn);
+		return it != pool_.end() ? grabbed(it->second, w.start) : w.conn;
+	}
+	else if (ConnectionInfo* ci = idle_for(db)) {
+		if (w.may_create) {
+			// We were left room to create one, but needn't now, so
+			// pass it on to the next in line, if any
+			--pending_;
+			wake_waiter(0);
+		}
+
+		unlink_idle(*ci);
+		ci->in_use = true;
+		if (needs_filling()) {
+			monitor_.notify_all();		// wake the maintenance thread
+		}
+		return grabbed(*ci, w.start);
+	}
+	else {
+		// No free connections, so create and return a new one.  Count
+		// it toward max_size() first, unless whoever woke us did that
+		// already, then let other threads use the pool while we
+		// connect.
+		if (!w.may_create) {
+			++pending_;
+		}
+
+		Connection* pc;
+		try {
+			Unlock unlock(monitor_);
+			doomed.destroy_all();
+			pc = create();
+		}
+		catch (...) {
+			// Pass the room we had on to the next in line, if any
+			--pending_;
+			++stats_.create_failures;
+			wake_waiter(0);
+			throw;
+		}
+
+		--pending_;
+		++stats_.creates;
+		return grabbed(add(pc, true), w.start);
+	}
+}
+
+
+//// this_slot /////////////////////////////////////////////////////////
+// Find the calling thread's cache slot for this pool, or 0 if it has
+// none, without locking anything.
+
+ConnectionPool::CacheSlot*
+ConnectionPool::this_slot()
+{
+	SlotTable* table = static_cast<SlotTable*>(pools().tables.get());
+	if (table) {
+		for (size_t i = 0; i < table->size(); ++i) {
+			if ((*table)[i].first == serial_) {
+				return static_cast<CacheSlot*>((*table)[i].second);
+			}
+		}
+	}
+	return 0;
+}
+
+
+//// timed_grab ////////////////////////////////////////////////////////
+
+Connection*
+ConnectionPool::timed_grab(unsigned long timeout_ms,
+		unsigned long* waited_ms)
+{
+	return acquire(long(std::min<unsigned long>(timeout_ms, LONG_MAX)),
+			waited_ms, 0);
+}
+
+
+//// try_grab //////////////////////////////////////////////////////////
+
+Connection*
+ConnectionPool::try_grab()
+{
+	return acquire(0, 0, 0);
+}
+
+
+//// unlink_idle ///////////////////////////////////////////////////////
+// Take a connection off the idle list, from wherever it is in it.
+
+void
+ConnectionPool::unlink_idle(ConnectionInfo& ci)
+{
+	if (ci.newer) {
+		ci.newer->older = ci.older;
+	}
+	else {
+		newest_idle_ = ci.older;
+	}
+
+	if (ci.older) {
+		ci.older->newer = ci.newer;
+	}
+	else {
+		oldest_idle_ = ci.newer;
+	}
+
+	ci.newer = ci.older = 0;
+	--idle_count_;
+
+	if (index_db_) {
+		idle_by_db_.erase(ci.db_entry);
+	}
+}
+
+
+//// wake_waiter ///////////////////////////////////////////////////////
+// Hand pc, a connection just released or created, to whoever has
+// waited longest in grab() or queue_grab(), or if pc is 0, let them
+// create one.  Only do the latter when there's room for another
+// connection.  Returns false if no one is waiting.
+
+bool
+ConnectionPool::wake_waiter(Connection* pc)
+{
+	if (waiters_.empty()) {
+		return false;
+	}
+
+	Waiter* w = waiters_.front();
+	waiters_.pop_front();
+	if (pc) {
+		w->conn = pc;
+	}
+	else {
+		w->may_create = true;
+		++pending_;				// the room is theirs now
+	}
+
+	// All waiters share the one condition, so wake them all; only the
+	// one we picked finds anything changed.  Those waiting without a
+	// thread get called back instead, and may be gone once they are.
+	monitor_.notify_all();
+	if (w->ready) {
+		w->ready(w->userdata);
+	}
+	return true;
+}
+
+
 } // end namespace mysqlpp
 
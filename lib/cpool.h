@@ -29,8 +29,13 @@
 #define MYSQLPP_CPOOL_H
 
 #include "beemutex.h"
+#include "histogram.h"
+#include "mythread.h"
 
-#include <list>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
 
 #include <assert.h>
 #include <time.h>
@@ -64,18 +69,133 @@ class MYSQLPP_EXPORT Connection;
 /// used connection, it would be likely to result in a large pool of
 /// sparsely used connections because we'd keep resetting the last-used 
 /// time of whichever connection is least recently used at that moment.
+///
+/// Unused connections are kept on a list in the order they were
+/// released, and the pool indexes all of its connections by address
+/// in a std::map, so grab() and release() take time logarithmic in
+/// the pool's size rather than scanning it.  That keeps the time spent
+/// holding the pool's lock short when many threads share it.
+///
+/// Connections are created and destroyed with the pool's lock
+/// released, so one slow connect doesn't hold up threads that only
+/// want to reuse an idle connection.  If min_idle() says so, a
+/// background thread keeps that many idle connections ready, so bursts
+/// of demand don't each have to wait for a connect.
+///
+/// That same thread can also check idle connections in the background
+/// every validate_interval() seconds, and drop those the server has
+/// closed, so safe_grab() only needs to ping connections that have sat
+/// idle longer than validate_after() seconds.
+///
+/// If thread_cache_time() says so, a thread releasing a connection
+/// keeps it for itself, and its next grab() gets it straight back
+/// without touching the pool's shared lock.  Worker threads then stay
+/// on the same connection, with its server-side state still warm.  The
+/// pool takes back connections kept this way once they go unused for
+/// a while, or when another thread would otherwise have to wait for a
+/// connection.
+///
+/// Programs that spread their data over many databases on one server,
+/// such as one per customer, can share one pool among them all by
+/// calling grab(db) instead of grab().  It prefers an idle connection
+/// already using that database, and otherwise switches the least
+/// recently used idle connection over with Connection::select_db().
+/// That keeps the number of connections down to what the program
+/// needs at once, while sparing most grabs a round trip to switch.
+///
+/// If reset_on_release() says so, release() puts the session state of
+/// connections marked Connection::dirty() back the way it was when
+/// they connected, so one user's transactions, session variables and
+/// temporary tables don't leak into the next user's work.  That's much
+/// cheaper than dropping the connection and making a new one.
+///
+/// The pool keeps count of what it does, and records how long each
+/// grab() waited and how long each connection was held before
+/// release().  Call stats() to see all that and how many connections
+/// are in use right now.  A pool that's often at max_size(), with
+/// grabs waiting, is a common cause of slow responses, and this is
+/// the way to see it.
 
 class MYSQLPP_EXPORT ConnectionPool
 {
 public:
+	/// \brief A snapshot of the pool's activity and state, from stats()
+	///
+	/// The counts and histograms cover the life of the pool.  To see
+	/// what happened over some period, compare two snapshots.
+	struct Stats {
+		Histogram wait_us;	///< microseconds each grab() took
+		Histogram hold_us;	///< microseconds from grab() to release()
+		unsigned long long creates;			///< connections created
+		unsigned long long create_failures;	///< create() calls that threw
+		unsigned long long destroys;		///< connections destroyed
+		unsigned long long check_failures;	///< connections that failed a ping
+		unsigned long long timeouts;		///< grabs that gave up waiting
+		unsigned long long db_switches;		///< databases grab(db) switched
+		size_t in_use;		///< connections grabbed and not released
+		size_t idle;		///< connections ready to be grabbed
+		size_t kept;		///< connections kept by threads; see thread_cache_time()
+		size_t pending;		///< connections being created
+		size_t waiting;		///< threads waiting in grab()
+
+		Stats() :
+		creates(0),
+		create_failures(0),
+		destroys(0),
+		check_failures(0),
+		timeouts(0),
+		db_switches(0),
+		in_use(0),
+		idle(0),
+		kept(0),
+		pending(0),
+		waiting(0)
+		{
+		}
+	};
+
+	/// \brief A place in line for a connection
+	///
+	/// grab() puts one of these on the waiting thread's stack when the
+	/// pool is full.  Whoever makes room hands it a released connection,
+	/// or leave to create one, with room for it already counted.  You
+	/// only use these directly with queue_grab(), for waiting without
+	/// a thread; treat the members as private.
+	struct Waiter {
+		Connection* conn;		///< connection handed to us, or 0
+		bool may_create;		///< we may create a connection
+		void (*ready)(void*);	///< called when the wait is over
+		void* userdata;			///< argument for ready
+		unsigned long long start;	///< when we started, in microseconds
+
+		Waiter() :
+		conn(0),
+		may_create(false),
+		ready(0),
+		userdata(0),
+		start(0)
+		{
+		}
+	};
+
 	/// \brief Create empty pool
-	ConnectionPool() { }
+	ConnectionPool() :
+	newest_idle_(0),
+	oldest_idle_(0),
+	idle_count_(0),
+	index_db_(false),
+	pending_(0),
+	closing_(0),
+	stopping_(false),
+	serial_(register_pool())
+	{
+	}
 
 	/// \brief Destroy object
 	///
 	/// If the pool raises an assertion on destruction, it means our
 	/// subclass isn't calling clear() in its dtor as it should.
-	virtual ~ConnectionPool() { assert(empty()); }
+	virtual ~ConnectionPool();
 
 	/// \brief Returns true if pool is empty
 	bool empty() const { return pool_.empty(); }
@@ -113,16 +233,56 @@ public:
 	/// recently used one; this allows older connections to die off over
 	/// time when the caller's need for connections decreases.
 	///
+	/// If the pool has a max_size() and that many connections are in
+	/// use already, this waits for one to be released.  Threads
+	/// waiting for a connection get them in the order they asked.
+	///
 	/// Do not delete the returned pointer.  This object manages the
 	/// lifetime of connection objects it creates.
 	///
-	/// \retval a pointer to the connection
+	/// \retval a pointer to the connection, or 0 if the pool is full
+	/// and the platform doesn't support threads, so there's no point
+	/// waiting
 	virtual Connection* grab();
 
+	/// \brief Grab a free connection from the pool, using the given
+	/// database
+	///
+	/// This is grab(), except that of the idle connections, it prefers
+	/// the most recently used one already using \c db.  If none are,
+	/// it takes the least recently used one instead, or a new one if
+	/// none are idle, and calls Connection::select_db() on it.
+	///
+	/// The pool knows which database each connection is using from
+	/// Connection::current_db(), so if you switch databases with a \c USE
+	/// statement instead of select_db(), the pool may think a connection
+	/// is still on its old database.  A later grab(db) then hands it
+	/// out as it is.
+	///
+	/// This doesn't go through grab(), so if your subclass overrides
+	/// that to do something on every grab, override this as well.
+	/// C++ hides this overload in a subclass that overrides only
+	/// grab(); add \c using \c ConnectionPool::grab; to the subclass
+	/// to make it visible again.
+	///
+	/// \retval a pointer to the connection, or 0 where grab() would
+	/// return 0, or if select_db() fails and the connection doesn't
+	/// throw exceptions.  If it does, the connection goes back to the
+	/// pool and the exception propagates.
+	virtual Connection* grab(const std::string& db);
+
 	/// \brief Return a connection to the pool
 	///
 	/// Marks the connection as no longer in use.
 	///
+	/// If reset_on_release() is true and the connection is dirty(), its
+	/// session is reset first; if that fails, the connection is removed
+	/// from the pool instead.
+	///
+	/// If thread_cache_time() is nonzero and the calling thread isn't
+	/// keeping a connection already, it keeps this one, so it's only
+	/// marked unused once the pool takes it back.
+	///
 	/// The pool updates the last-used time of a connection only on
 	/// release, on the assumption that it was used just prior.  There's
 	/// nothing forcing you to do it this way: your code is free to
@@ -133,7 +293,7 @@ public:
 	/// remove it from the pool.
 	///
 	/// \param pc pointer to a Connection object to be returned to the
-	/// pool and marked as unused.
+	/// pool and marked as unused.  Does nothing if it's 0.
 	virtual void release(const Connection* pc);
 
 	/// \brief Removes the given connection from the pool
@@ -158,12 +318,82 @@ public:
 	/// unexpectedly, such as when the DB server can be restarted out
 	/// from under your application.
 	///
-	/// \retval a pointer to the connection
+	/// Connections known to be good within the last validate_after()
+	/// seconds aren't pinged, so raising that from its default of 0
+	/// makes this nearly as cheap as grab() for busy pools.
+	///
+	/// \retval a pointer to the connection, or 0 where grab() would
+	/// return 0
 	virtual Connection* safe_grab();
 
+	/// \brief Start the pool's maintenance thread
+	///
+	/// The thread that keeps min_idle() connections ready and checks
+	/// idle connections every validate_interval() seconds starts
+	/// itself on the first grab(), but you can call this beforehand,
+	/// say at program startup, so the first requests find connections
+	/// waiting for them.  Does nothing if neither policy is enabled or
+	/// the platform doesn't support threads.
+	void prewarm();
+
 	/// \brief Remove all unused connections from the pool
 	void shrink() { clear(false); }
 
+	/// \brief Get a snapshot of the pool's activity and state
+	///
+	/// This locks the pool for as long as it takes to copy a few
+	/// kilobytes per thread keeping connections, so it's fine to call
+	/// every few seconds from a monitoring thread, but not on every
+	/// grab().
+	Stats stats() const;
+
+	/// \brief Grab a free connection from the pool, waiting no longer
+	/// than the given time for one if the pool is full
+	///
+	/// This is grab() with a limit on how long to wait when max_size()
+	/// connections are already in use.
+	///
+	/// \param timeout_ms longest time to wait, in milliseconds
+	/// \param waited_ms if not 0, receives the time we actually spent
+	///     waiting, in milliseconds
+	///
+	/// \retval a pointer to the connection, or 0 if the time ran out
+	Connection* timed_grab(unsigned long timeout_ms,
+			unsigned long* waited_ms = 0);
+
+	/// \brief Grab a free connection from the pool, unless that means
+	/// waiting for one
+	///
+	/// \retval a pointer to the connection, or 0 if max_size()
+	/// connections are in use already, or other threads are waiting
+	Connection* try_grab();
+
+	/// \brief Get in line for a connection without blocking the
+	/// calling thread
+	///
+	/// This is the first half of grab(), for callers that can't afford
+	/// to block a thread while they wait, such as grab_async() in
+	/// awaitable.h.  Call finish_grab() with the same Waiter for the
+	/// connection, once this returns false or \c ready is called.
+	///
+	/// \c ready is called with the pool locked, on whichever thread
+	/// makes room, so it must not call back into the pool; have it
+	/// hand the call to finish_grab() to another thread.  The Waiter
+	/// must stay put until then.
+	///
+	/// \retval true if the pool is full, so \c w is queued, and
+	/// \c ready will be called once it reaches the front of the line
+	/// and a connection frees up; false if there's no need to wait.
+	bool queue_grab(Waiter& w, void (*ready)(void*), void* userdata);
+
+	/// \brief Get the connection queue_grab() got in line for
+	///
+	/// If the Waiter was left to create the connection, this is where
+	/// that happens, so this can block as long as create() takes.
+	///
+	/// \retval the connection, or 0 where grab() would return 0
+	Connection* finish_grab(Waiter& w);
+
 protected:
 	/// \brief Drains the pool, freeing all allocated memory.
 	///
@@ -172,6 +402,9 @@ protected:
 	/// this level because this class's dtor can't call our subclass's
 	/// destroy() method.
 	///
+	/// This also stops the pool's maintenance thread, if it's running,
+	/// when \c all is true.
+	///
 	/// \param all if true, remove all connections, even those in use
 	void clear(bool all = true);
 
@@ -206,47 +439,200 @@ protected:
 	/// due to lack of use
 	virtual unsigned int max_idle_time() = 0;
 
+	/// \brief Returns the most connections the pool may have open at
+	/// once, or 0 for no limit
+	///
+	/// Once this many connections are in use, grab() waits for one to
+	/// be released instead of creating another.  This keeps a burst
+	/// of demand from opening more connections than the server can
+	/// serve efficiently, or more than its max_connections setting
+	/// allows.  The default is no limit.
+	virtual unsigned int max_size() { return 0; }
+
+	/// \brief Returns the number of idle connections the pool tries to
+	/// keep ready, or 0 to only create connections as grab() needs them
+	///
+	/// If this is nonzero, the maintenance thread creates connections
+	/// whenever fewer than this many are idle, within the max_size()
+	/// limit.  Idle connections are still dropped after max_idle_time()
+	/// seconds, so make that long enough for this to be useful.  The
+	/// default is 0.
+	virtual unsigned int min_idle() { return 0; }
+
+	/// \brief Returns the number of seconds a connection may sit idle
+	/// before safe_grab() pings it
+	///
+	/// A connection that was released, created or checked within this
+	/// many seconds is assumed to still be good, sparing busy programs
+	/// a round trip to the server on every safe_grab().  The default, 0,
+	/// pings every time.
+	virtual unsigned int validate_after() { return 0; }
+
+	/// \brief Returns how often, in seconds, the maintenance thread
+	/// pings idle connections, or 0 to not do that
+	///
+	/// Each time around, idle connections not known to be good within
+	/// the last this many seconds are pinged, and any that fail are
+	/// dropped; min_idle() replaces them.  Idle connections past
+	/// max_idle_time() are dropped as well, so they don't wait for the
+	/// next grab() to do it.  The default is 0.
+	virtual unsigned int validate_interval() { return 0; }
+
+	/// \brief Returns true if release() should reset the session of
+	/// connections that are Connection::dirty()
+	///
+	/// This costs a round trip to the server on releasing a dirty
+	/// connection, but nothing for clean ones.  Connections are dirty
+	/// if they have a transaction open, or if your code called
+	/// Connection::mark_dirty().  The default is false.
+	virtual bool reset_on_release() { return false; }
+
+	/// \brief Returns how long, in seconds, a thread may keep a
+	/// released connection for itself, or 0 to not do that
+	///
+	/// While a thread keeps a connection, its grab() and release()
+	/// calls just take it and put it back, without locking the rest of
+	/// the pool.  If it goes unused for this many seconds, the pool
+	/// takes it back and puts it with the other idle connections.  It
+	/// also takes back kept connections whenever the pool is at
+	/// max_size() and a thread would otherwise have to wait.  The
+	/// default is 0.
+	///
+	/// A connection is only kept for the thread that released it, so
+	/// turn this on only if the threads that use the pool live on; a
+	/// little memory is used for each thread that ever releases a
+	/// connection, until the pool is destroyed.
+	virtual unsigned int thread_cache_time() { return 0; }
+
 	/// \brief Returns the current size of the internal connection pool.
 	size_t size() const { return pool_.size(); }
 
 private:
 	//// Internal types
+	struct ConnectionInfo;
+	typedef std::multimap<std::string, ConnectionInfo*> DbIndex;
+
 	struct ConnectionInfo {
 		Connection* conn;
 		time_t last_used;
+		time_t last_ok;		// last time we knew it was good
+		unsigned long long grabbed;	// last grab() time, in microseconds
 		bool in_use;
 
+		// Neighbors in the idle list, while !in_use
+		ConnectionInfo* newer;
+		ConnectionInfo* older;
+
+		// Entry in idle_by_db_, while !in_use and it's kept up
+		DbIndex::iterator db_entry;
+
 		ConnectionInfo(Connection* c) :
 		conn(c),
 		last_used(time(0)),
-		in_use(true)
+		last_ok(last_used),
+		grabbed(0),
+		in_use(true),
+		newer(0),
+		older(0)
 		{
 		}
+	};
+	typedef std::map<const Connection*, ConnectionInfo> PoolT;
+	typedef PoolT::iterator PoolIt;
 
-		// Strict weak ordering for ConnectionInfo objects.
-		// 
-		// This ordering defines all in-use connections to be "less
-		// than" those not in use.  Within each group, connections
-		// less recently touched are less than those more recent.
-		bool operator<(const ConnectionInfo& rhs) const
+	// A connection kept by one thread for its next grab(), and that
+	// thread's share of the pool's statistics.  The mutex guards conn,
+	// kept and the histograms, which the pool reads under it; the
+	// last_* and held* fields are touched only by the owning thread.
+	struct CacheSlot {
+		BeecryptMutex mutex;
+		Connection* conn;			// connection kept, or 0
+		time_t kept;				// when conn was released
+		bool bypass;				// release to the pool, for waiters
+		const Connection* last_conn;	// last connection grab() took
+		time_t last_ok;				// ...and when it was released
+		const Connection* held;		// last connection grabbed, until
+		unsigned long long held_since;	// ...released, and when
+		Histogram waits;			// grabs that only touched this slot
+		Histogram holds;			// ...and releases likewise
+
+		CacheSlot() :
+		conn(0),
+		kept(0),
+		bypass(false),
+		last_conn(0),
+		last_ok(0),
+		held(0),
+		held_since(0)
 		{
-			const ConnectionInfo& lhs = *this;
-			return lhs.in_use == rhs.in_use ?
-					lhs.last_used < rhs.last_used :
-					lhs.in_use;
 		}
 	};
-	typedef std::list<ConnectionInfo> PoolT;
-	typedef PoolT::iterator PoolIt;
+
+	// Connections taken out of the pool while holding the lock.
+	// Declare one before the Monitor::Lock, so it destroys them after
+	// the lock is released.
+	class Doomed {
+	public:
+		explicit Doomed(ConnectionPool& pool) : pool_(pool) { }
+		~Doomed() { destroy_all(); }
+
+		void destroy_all();
+		bool empty() const { return conns_.empty(); }
+		void push_back(Connection* pc) { conns_.push_back(pc); }
+
+	private:
+		ConnectionPool& pool_;
+		std::vector<Connection*> conns_;
+	};
+	friend class Doomed;
 
 	//// Internal support functions
-	Connection* find_mru();
-	void remove(const PoolIt& it);
-	void remove_old_connections();
+	Connection* acquire(long timeout_ms, unsigned long* waited_ms,
+			const std::string* db);
+	ConnectionInfo& add(Connection* pc, bool in_use);
+	Connection* cache_grab(const std::string* db);
+	bool cache_release(Connection* pc, bool timed,
+			unsigned long long held_us);
+	void check_idle(const Connection* pc, Doomed& doomed);
+	void closed(size_t n);
+	bool fill();
+	bool full();
+	Connection* grabbed(ConnectionInfo& ci, unsigned long long start);
+	ConnectionInfo* idle_for(const std::string* db);
+	void maintain();
+	static void maintain_main(void* pool);
+	bool must_wait();
+	bool needs_check(const Connection* pc);
+	bool needs_filling();
+	void push_idle(ConnectionInfo& ci);
+	void reclaim(bool all);
+	static unsigned long register_pool();
+	void remember_slot(CacheSlot* slot);
+	void remove(const PoolIt& it, Doomed& doomed);
+	void remove_old_connections(Doomed& doomed);
+	void start_maintenance();
+	void stop_maintenance();
+	Connection* take(Waiter& w, const std::string* db, Doomed& doomed);
+	CacheSlot* this_slot();
+	void unlink_idle(ConnectionInfo& ci);
+	bool wake_waiter(Connection* pc);
 
 	//// Internal data
 	PoolT pool_;
-	BeecryptMutex mutex_;
+	ConnectionInfo* newest_idle_;
+	ConnectionInfo* oldest_idle_;
+	size_t idle_count_;			// length of the idle list
+	DbIndex idle_by_db_;		// idle list by database, once grab(db) is used
+	bool index_db_;				// ...which is when this becomes true
+	size_t pending_;			// connections being created
+	size_t closing_;			// ...and removed but not yet destroyed
+	std::deque<Waiter*> waiters_;
+	bool stopping_;				// maintenance thread should exit
+	std::vector<CacheSlot*> slots_;
+	Stats stats_;				// all but what's in slots_ and the sizes
+	mutable Monitor monitor_;
+	unsigned long serial_;		// tells our CacheSlots from other pools'
+	Thread maint_;
 };
 
 } // end namespace mysqlpp
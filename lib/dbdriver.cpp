@@ -44,7 +44,9 @@ using namespace std;
 namespace mysqlpp {
 
 DBDriver::DBDriver() :
-is_connected_(false)
+is_connected_(false),
+escape_csname_(0),
+escape_cs_(internal::ec_unknown)
 {
 	// We won't allow calls to mysql_*() functions that take a MYSQL
 	// object until we get a connection up.  Such calls are nonsense.
@@ -54,7 +56,9 @@ is_connected_(false)
 
 
 DBDriver::DBDriver(const DBDriver& other) :
-is_connected_(false)
+is_connected_(false),
+escape_csname_(0),
+escape_cs_(internal::ec_unknown)
 {
 	copy(other);
 }
@@ -167,6 +171,48 @@ DBDriver::enable_ssl(const char* key, const char* cert,
 }
 
 
+internal::escape_charset
+DBDriver::escape_charset()
+{
+	if (!is_connected_) {
+		return internal::ec_unknown;
+	}
+
+#if defined(SERVER_STATUS_NO_BACKSLASH_ESCAPES)
+	// In this mode the C API doubles quote characters instead of using
+	// backslashes.  It's rare enough that we don't bother copying it.
+	if (mysql_.server_status & SERVER_STATUS_NO_BACKSLASH_ESCAPES) {
+		return internal::ec_unknown;
+	}
+#endif
+
+	// The C API hands back a pointer into its static character set
+	// table, so we only need to look at the name when it changes.
+	const char* csname = mysql_character_set_name(&mysql_);
+	if (csname != escape_csname_) {
+		escape_csname_ = csname;
+		escape_cs_ = internal::classify_charset(csname);
+	}
+	return escape_cs_;
+}
+
+
+size_t
+DBDriver::escape_string(char* to, const char* from, size_t length)
+{
+	error_message_.clear();
+
+	internal::escape_charset ec = escape_charset();
+	if (ec != internal::ec_unknown) {
+		return internal::escape_string(to, from, length, ec);
+	}
+	else {
+		return mysql_real_escape_string(&mysql_, to, from, 
+				static_cast<unsigned long>(length));
+	}
+}
+
+
 size_t
 DBDriver::escape_string(std::string* ps, const char* original,
 		size_t length)
@@ -190,12 +236,38 @@ DBDriver::escape_string(std::string* ps, const char* original,
 		length = strlen(original);
 	}
 
-	char* escaped = new char[length * 2 + 1];
-	length = escape_string(escaped, original, length);
-	ps->assign(escaped, length);
-	delete[] escaped;
+	if ((original >= ps->data()) && (original < ps->data() + ps->size())) {
+		// Escaping the string onto itself, so we need a second buffer.
+		std::string escaped(length * 2 + 1, '\0');
+		escaped.resize(escape_string(&escaped[0], original, length));
+		ps->swap(escaped);
+	}
+	else {
+		// Escape straight into the caller's string.
+		ps->resize(length * 2 + 1);
+		ps->resize(escape_string(&(*ps)[0], original, length));
+	}
+
+	return ps->length();
+}
+
+
+size_t
+DBDriver::escape_string(std::ostream& os, const char* from,
+		size_t length)
+{
+	error_message_.clear();
 
-	return length;
+	internal::escape_charset ec = escape_charset();
+	if (ec != internal::ec_unknown) {
+		return internal::escape_string(os.rdbuf(), from, length, ec);
+	}
+	else {
+		std::string escaped;
+		escape_string(&escaped, from, length);
+		os.write(escaped.data(), escaped.length());
+		return escaped.length();
+	}
 }
 
 
@@ -220,12 +292,56 @@ DBDriver::escape_string_no_conn(std::string* ps, const char* original,
 		length = strlen(original);
 	}
 
-	char* escaped = new char[length * 2 + 1];
-	length = DBDriver::escape_string_no_conn(escaped, original, length);
-	ps->assign(escaped, length);
-	delete[] escaped;
+	std::string escaped(length * 2 + 1, '\0');
+	escaped.resize(DBDriver::escape_string_no_conn(&escaped[0], original,
+			length));
+	ps->swap(escaped);
 
-	return length;
+	return ps->length();
+}
+
+
+size_t
+DBDriver::escape_string_no_conn(std::ostream& os, const char* from,
+		size_t length)
+{
+	// Escape a piece at a time through a buffer on the stack, and
+	// write each piece straight to the stream.  We only cut the input
+	// just after a byte below 0x80: no character set MySQL supports
+	// starts a multibyte character with one, so that's always a
+	// character boundary, and the C API does the same as it would
+	// have done with the whole string.
+	const size_t piece = 1024;
+	char buf[piece * 2 + 1];
+	std::streambuf* sb = os.rdbuf();
+	const char* const end = from + length;
+	size_t total = 0;
+
+	while (from < end) {
+		size_t n = end - from;
+		if (n > piece) {
+			n = piece;
+			while (n > 0 &&
+					static_cast<unsigned char>(from[n - 1]) >= 0x80) {
+				--n;
+			}
+
+			if (n == 0) {
+				// No safe place to cut, so do the rest in one go.
+				std::string escaped;
+				escape_string_no_conn(&escaped, from, end - from);
+				sb->sputn(escaped.data(), escaped.length());
+				return total + escaped.length();
+			}
+		}
+
+		size_t len = escape_string_no_conn(buf, from, n);
+		sb->sputn(buf, len);
+		total += len;
+		from += n;
+	}
+
+	return total;
 }
 
 
@@ -246,6 +362,26 @@ DBDriver::query_info()
 }
 
 
+bool
+DBDriver::reset_session()
+{
+	error_message_.clear();
+#if defined(MYSQLPP_HAVE_RESET_CONNECTION)
+	if (mysql_reset_connection(&mysql_) == 0) {
+		return true;
+	}
+#endif
+
+	// Copy the login details first, since mysql_change_user() replaces
+	// the strings they're in.
+	string user(mysql_.user ? mysql_.user : "");
+	string password(mysql_.passwd ? mysql_.passwd : "");
+	string db(mysql_.db ? mysql_.db : "");
+	return !mysql_change_user(&mysql_, user.c_str(), password.c_str(),
+			db.empty() ? 0 : db.c_str());
+}
+
+
 bool
 DBDriver::set_option(unsigned int o, bool arg)
 {
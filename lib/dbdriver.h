@@ -30,12 +30,27 @@
 
 #include "common.h"
 
+#include "escape.h"
 #include "options.h"
 
+#include <ostream>
 #include <typeinfo>
 
 #include <limits.h>
 
+// MySQL 8.0.16 added non-blocking versions of the query calls.
+// MariaDB's non-blocking API is different, so we don't use it.
+#if MYSQL_VERSION_ID >= 80016 && !defined(MARIADB_BASE_VERSION) && \
+		!defined(MARIADB_PACKAGE_VERSION)
+#	define MYSQLPP_HAVE_NONBLOCKING_API
+#endif
+
+// MySQL 5.7.3 added a way to reset session state without logging in
+// again.  MariaDB's client library has it too, from Connector/C 3.0.
+#if MYSQL_VERSION_ID >= 50703
+#	define MYSQLPP_HAVE_RESET_CONNECTION
+#endif
+
 namespace mysqlpp {
 
 /// \brief Provides a thin abstraction layer over the underlying database 
@@ -88,6 +103,15 @@ public:
 		return mysql_affected_rows(&mysql_);
 	}
 
+	/// \brief Get the name of the connection's default character set
+	///
+	/// Wraps \c mysql_character_set_name() in the MySQL C API.
+	const char* character_set_name()
+	{
+		error_message_.clear();
+		return mysql_character_set_name(&mysql_);
+	}
+
 	/// \brief Get database client library version
 	///
 	/// Wraps \c mysql_get_client_info() in the MySQL C API.
@@ -133,6 +157,16 @@ public:
 	/// \return true if database was created successfully
 	bool create_db(const char* db) const;
 
+	/// \brief Get the name of the current default database, or an
+	/// empty string if there isn't one
+	///
+	/// This is the C API's own record, which connecting and
+	/// select_db() keep up to date.  A \c USE statement only updates it
+	/// if the server reports schema changes, as MySQL 5.7 and newer do
+	/// when asked.
+	std::string current_db() const
+			{ return mysql_.db ? mysql_.db : ""; }
+
 	/// \brief Seeks to a particualr row within the result set
 	///
 	/// Wraps mysql_data_seek() in MySQL C API.
@@ -201,19 +235,20 @@ public:
 	///
 	/// \retval number of characters placed in escaped
 	///
-	/// Wraps \c mysql_real_escape_string() in the MySQL C API.
+	/// Behaves like \c mysql_real_escape_string() in the MySQL C API.
+	/// For the common single-byte and UTF-8 character sets, MySQL++
+	/// does the escaping itself, scanning for bytes that need it many
+	/// at a time and block-copying the stretches between them, so
+	/// mostly-clean data escapes at close to \c memcpy() speed.  For
+	/// other character sets, or when the server's \c sql_mode has
+	/// \c NO_BACKSLASH_ESCAPES set, we call the C API instead.
 	///
 	/// Proper SQL escaping takes the database's current character set 
 	/// into account, however if a database connection isn't available
 	/// DBDriver also provides a static version of this same method.
 	///
 	/// \sa escape_string_no_conn(char*, const char*, size_t)
-	size_t escape_string(char* to, const char* from, size_t length)
-	{
-		error_message_.clear();
-		return mysql_real_escape_string(&mysql_, to, from, 
-				static_cast<unsigned long>(length));
-	}
+	size_t escape_string(char* to, const char* from, size_t length);
 
 	/// \brief Return a SQL-escaped version of a character buffer
 	///
@@ -257,6 +292,23 @@ public:
 	size_t escape_string(std::string* ps, const char* original,
 			size_t length);
 
+	/// \brief SQL-escapes a character buffer, inserting the result
+	/// directly into a stream
+	///
+	/// \param os stream to receive the escaped version
+	/// \param from pointer to the character buffer to escape
+	/// \param length number of characters to escape
+	///
+	/// \retval number of characters inserted into \c os
+	///
+	/// This does the same job as escape_string(std::string*, const
+	/// char*, size_t) followed by an insertion of that string into the
+	/// stream, but it doesn't make that intermediate copy when it can
+	/// avoid it.  Query and SQLStream use this to escape values
+	/// straight into the query being built.
+	size_t escape_string(std::ostream& os, const char* from,
+			size_t length);
+
 	/// \brief SQL-escapes the given string without reference to the 
 	/// character set of a database server.
 	///
@@ -278,6 +330,13 @@ public:
 	static size_t escape_string_no_conn(std::string* ps, 
 			const char* original = 0, size_t length = 0);
 
+	/// \brief SQL-escapes a character buffer into a stream without
+	/// reference to the character set of a database server.
+	///
+	/// \sa escape_string(std::ostream&, const char*, size_t)
+	static size_t escape_string_no_conn(std::ostream& os,
+			const char* from, size_t length);
+
 	/// \brief Executes the given query string
 	///
 	/// Wraps \c mysql_real_query() in the MySQL C API.
@@ -288,6 +347,21 @@ public:
 				static_cast<unsigned long>(length));
 	}
 
+	#if defined(MYSQLPP_HAVE_NONBLOCKING_API)
+	/// \brief Start or continue executing a query without blocking
+	///
+	/// Call it again with the same arguments until it stops returning
+	/// \c NET_ASYNC_NOT_READY.  AsyncResult is the only intended user.
+	///
+	/// Wraps \c mysql_real_query_nonblocking() in the MySQL C API.
+	net_async_status execute_nonblocking(const char* qstr, size_t length)
+	{
+		error_message_.clear();
+		return mysql_real_query_nonblocking(&mysql_, qstr,
+				static_cast<unsigned long>(length));
+	}
+	#endif
+
 	/// \brief Returns the next raw C API row structure from the given
 	/// result set.
 	///
@@ -382,6 +456,15 @@ public:
 		return mysql_insert_id(&mysql_);
 	}
 
+	/// \brief Returns true if the server says a transaction is open
+	///
+	/// This tests the status the server sent back with the most recent
+	/// statement, so it doesn't cost a round trip.
+	bool in_transaction() const
+	{
+		return (mysql_.server_status & SERVER_STATUS_IN_TRANS) != 0;
+	}
+
 	/// \brief Kill a MySQL server thread
 	///
 	/// \param tid ID of thread to kill
@@ -409,6 +492,20 @@ public:
 		#endif
 	}
 
+	/// \brief Returns true if the connection was set up to allow more
+	/// than one statement per query
+	///
+	/// This reflects MultiStatementsOption as set before connecting,
+	/// not any later change made with it.
+	bool multi_statements() const
+	{
+		#if MYSQL_VERSION_ID >= 40101
+			return (mysql_.client_flag & CLIENT_MULTI_STATEMENTS) != 0;
+		#else
+			return false;
+		#endif
+	}
+
 	/// \brief Moves to the next result set from a multi-query
 	///
 	/// \return A code indicating whether we successfully found another
@@ -495,6 +592,18 @@ public:
 		return !mysql_refresh(&mysql_, options);
 	}
 
+	/// \brief Puts the session back the way it was just after we
+	/// connected
+	///
+	/// This rolls back any open transaction, drops temporary tables,
+	/// releases locks, resets session variables, and closes prepared
+	/// statements, all without a new connection.  Wraps
+	/// \c mysql_reset_connection() in the MySQL C API where available.
+	/// Where it isn't, or if the server is too old to support it, it
+	/// falls back to \c mysql_change_user() with the current login,
+	/// which has the same effect, but has to log in again.
+	bool reset_session();
+
 	/// \brief Returns true if the most recent result set was empty
 	///
 	/// Wraps \c mysql_field_count() in the MySQL C API, returning true
@@ -576,6 +685,44 @@ public:
 		return set_option(o);
 	}
 
+	/// \brief Install callbacks that supply the file contents for
+	/// \c LOAD \c DATA \c LOCAL \c INFILE statements
+	///
+	/// The callbacks stay in effect for all such statements on this
+	/// connection until you call set_local_infile_default().
+	/// Query::load_data() is the only intended user.
+	///
+	/// Wraps \c mysql_set_local_infile_handler() in the MySQL C API.
+	void set_local_infile_handler(
+			int (*init)(void**, const char*, void*),
+			int (*read)(void*, char*, unsigned int),
+			void (*end)(void*),
+			int (*error)(void*, char*, unsigned int),
+			void* userdata)
+	{
+		error_message_.clear();
+		mysql_set_local_infile_handler(&mysql_, init, read, end, error,
+				userdata);
+	}
+
+	/// \brief Restore the C API's default \c LOAD \c DATA \c LOCAL
+	/// \c INFILE behavior, which reads a file from the client's disk
+	///
+	/// Wraps \c mysql_set_local_infile_default() in the MySQL C API.
+	void set_local_infile_default()
+	{
+		error_message_.clear();
+		mysql_set_local_infile_default(&mysql_);
+	}
+
+	/// \brief Get the socket the connection talks to the server
+	/// through
+	///
+	/// This is for watching with \c select(), \c poll() and such while
+	/// an asynchronous query is pending; see AsyncResult::fd().  Don't
+	/// read from or write to it yourself.
+	int socket_fd() const { return is_connected_ ? int(mysql_.net.fd) : -1; }
+
 	/// \brief Ask database server to shut down.
 	///
 	/// User must have the "shutdown" privilege.
@@ -597,6 +744,183 @@ public:
 		return mysql_stat(&mysql_);
 	}
 
+	/// \brief Returns the number of rows changed by the last execution
+	/// of a prepared statement
+	///
+	/// Wraps \c mysql_stmt_affected_rows() in the MySQL C API.
+	ulonglong stmt_affected_rows(MYSQL_STMT* stmt) const
+	{
+		error_message_.clear();
+		return mysql_stmt_affected_rows(stmt);
+	}
+
+	/// \brief Bind a prepared statement's parameters to the given
+	/// buffers
+	///
+	/// Wraps \c mysql_stmt_bind_param() in the MySQL C API.
+	bool stmt_bind_param(MYSQL_STMT* stmt, MYSQL_BIND* binds) const
+	{
+		error_message_.clear();
+		return !mysql_stmt_bind_param(stmt, binds);
+	}
+
+	/// \brief Bind a prepared statement's result set columns to the
+	/// given buffers
+	///
+	/// Wraps \c mysql_stmt_bind_result() in the MySQL C API.
+	bool stmt_bind_result(MYSQL_STMT* stmt, MYSQL_BIND* binds) const
+	{
+		error_message_.clear();
+		return !mysql_stmt_bind_result(stmt, binds);
+	}
+
+	/// \brief Release a prepared statement handle made by stmt_init()
+	///
+	/// Wraps \c mysql_stmt_close() in the MySQL C API.
+	void stmt_close(MYSQL_STMT* stmt) const
+	{
+		error_message_.clear();
+		mysql_stmt_close(stmt);
+	}
+
+	/// \brief Returns the error number of the last prepared statement
+	/// operation that failed
+	///
+	/// Wraps \c mysql_stmt_errno() in the MySQL C API.
+	unsigned int stmt_errno(MYSQL_STMT* stmt) const
+	{
+		return mysql_stmt_errno(stmt);
+	}
+
+	/// \brief Returns the error message of the last prepared statement
+	/// operation that failed
+	///
+	/// Wraps \c mysql_stmt_error() in the MySQL C API.
+	const char* stmt_error(MYSQL_STMT* stmt) const
+	{
+		return mysql_stmt_error(stmt);
+	}
+
+	/// \brief Execute a prepared statement with the bound parameters
+	///
+	/// Wraps \c mysql_stmt_execute() in the MySQL C API.
+	bool stmt_execute(MYSQL_STMT* stmt) const
+	{
+		error_message_.clear();
+		return !mysql_stmt_execute(stmt);
+	}
+
+	/// \brief Fetch the next row of a prepared statement's result set
+	/// into the bound buffers
+	///
+	/// Returns 0, \c MYSQL_NO_DATA, \c MYSQL_DATA_TRUNCATED, or 1 on
+	/// error, just as the C API function it wraps,
+	/// \c mysql_stmt_fetch(), does.
+	int stmt_fetch(MYSQL_STMT* stmt) const
+	{
+		error_message_.clear();
+		return mysql_stmt_fetch(stmt);
+	}
+
+	/// \brief Fetch one column of the current row of a prepared
+	/// statement's result set into the given buffer
+	///
+	/// Wraps \c mysql_stmt_fetch_column() in the MySQL C API.
+	bool stmt_fetch_column(MYSQL_STMT* stmt, MYSQL_BIND* bind,
+			unsigned int column, unsigned long offset) const
+	{
+		error_message_.clear();
+		return !mysql_stmt_fetch_column(stmt, bind, column, offset);
+	}
+
+	/// \brief Abandon the rest of a prepared statement's result set
+	///
+	/// Wraps \c mysql_stmt_free_result() in the MySQL C API.
+	bool stmt_free_result(MYSQL_STMT* stmt) const
+	{
+		error_message_.clear();
+		return !mysql_stmt_free_result(stmt);
+	}
+
+	/// \brief Create a new prepared statement handle on this
+	/// connection
+	///
+	/// The caller owns the handle, and must release it with
+	/// stmt_close().  PreparedQuery is the only intended user of this
+	/// and the other \c stmt_* wrappers.
+	///
+	/// Wraps \c mysql_stmt_init() in the MySQL C API.
+	MYSQL_STMT* stmt_init()
+	{
+		error_message_.clear();
+		return mysql_stmt_init(&mysql_);
+	}
+
+	/// \brief Returns the ID generated for an \c AUTO_INCREMENT column
+	/// by the last execution of a prepared statement
+	///
+	/// Wraps \c mysql_stmt_insert_id() in the MySQL C API.
+	ulonglong stmt_insert_id(MYSQL_STMT* stmt) const
+	{
+		error_message_.clear();
+		return mysql_stmt_insert_id(stmt);
+	}
+
+	/// \brief Returns the number of rows in a prepared statement's
+	/// result set, once stmt_store_result() has read them all
+	///
+	/// Wraps \c mysql_stmt_num_rows() in the MySQL C API.
+	ulonglong stmt_num_rows(MYSQL_STMT* stmt) const
+	{
+		error_message_.clear();
+		return mysql_stmt_num_rows(stmt);
+	}
+
+	/// \brief Returns the number of placeholders in a prepared
+	/// statement
+	///
+	/// Wraps \c mysql_stmt_param_count() in the MySQL C API.
+	size_t stmt_param_count(MYSQL_STMT* stmt) const
+	{
+		error_message_.clear();
+		return mysql_stmt_param_count(stmt);
+	}
+
+	/// \brief Send a SQL statement to the server to be prepared on the
+	/// given handle
+	///
+	/// Wraps \c mysql_stmt_prepare() in the MySQL C API.
+	bool stmt_prepare(MYSQL_STMT* stmt, const char* qstr,
+			size_t length) const
+	{
+		error_message_.clear();
+		return !mysql_stmt_prepare(stmt, qstr,
+				static_cast<unsigned long>(length));
+	}
+
+	/// \brief Returns a prepared statement's result set metadata, or
+	/// null if it doesn't return rows
+	///
+	/// The caller owns the returned result, and must release it with
+	/// free_result().
+	///
+	/// Wraps \c mysql_stmt_result_metadata() in the MySQL C API.
+	MYSQL_RES* stmt_result_metadata(MYSQL_STMT* stmt) const
+	{
+		error_message_.clear();
+		return mysql_stmt_result_metadata(stmt);
+	}
+
+	/// \brief Read a prepared statement's whole result set into
+	/// client memory
+	///
+	/// Wraps \c mysql_stmt_store_result() in the MySQL C API.
+	bool stmt_store_result(MYSQL_STMT* stmt) const
+	{
+		error_message_.clear();
+		return !mysql_stmt_store_result(stmt);
+	}
+
 	/// \brief Saves the results of the query just execute()d in memory
 	/// and returns a pointer to the MySQL C API data structure the
 	/// results are stored in.
@@ -610,6 +934,21 @@ public:
 		return mysql_store_result(&mysql_);
 	}
 
+	#if defined(MYSQLPP_HAVE_NONBLOCKING_API)
+	/// \brief Start or continue retrieving a result set without
+	/// blocking
+	///
+	/// Call it again until it stops returning \c NET_ASYNC_NOT_READY.
+	/// AsyncResult is the only intended user.
+	///
+	/// Wraps \c mysql_store_result_nonblocking() in the MySQL C API.
+	net_async_status store_result_nonblocking(MYSQL_RES** res)
+	{
+		error_message_.clear();
+		return mysql_store_result_nonblocking(&mysql_, res);
+	}
+	#endif
+
 	/// \brief Returns true if MySQL++ and the underlying MySQL C API
 	/// library were both compiled with thread awareness.
 	///
@@ -693,6 +1032,12 @@ protected:
 	/// delayed option setting code in connect_prepare()
 	bool set_option_impl(Option* o);
 
+	/// \brief Decide whether we can escape strings ourselves with the
+	/// connection's current character set and server SQL mode
+	///
+	/// \retval internal::ec_unknown if we have to call the C API
+	internal::escape_charset escape_charset();
+
 private:
 	/// \brief Data type of the list of applied connection options
 	typedef std::deque<Option*> OptionList;
@@ -709,6 +1054,8 @@ private:
 	OptionList applied_options_;
 	OptionList pending_options_;
 	mutable std::string error_message_;
+	const char* escape_csname_;
+	internal::escape_charset escape_cs_;
 };
 
 
@@ -0,0 +1,370 @@
+/***********************************************************************
+ escape.cpp - Implements the library-side SQL string escaping routines.
+
+ Copyright (c) 2015 by Educational Technology Resources, Inc.  Others
+ may also hold copyrights on code in this file.  See the CREDITS.txt
+ file in the top directory of the distribution for details.
+
+ This file is part of MySQL++.
+
+ MySQL++ is free software; you can redistribute it and/or modify it
+ under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 2.1 of the License, or
+ (at your option) any later version.
+
+ MySQL++ is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with MySQL++; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+ USA
+***********************************************************************/
+
+#define MYSQLPP_NOT_HEADER
+#include "escape.h"
+
+#include <cstring>
+
+// Use SSE2 to find the next byte needing attention 16 at a time, if
+// the target is guaranteed to have it.  Every x86-64 CPU does.
+#if defined(__SSE2__) || defined(_M_X64) || \
+		(defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#	define MYSQLPP_ESCAPE_SSE2
+#	include <emmintrin.h>
+#	if defined(_MSC_VER)
+#		include <intrin.h>
+#	endif
+#endif
+
+namespace mysqlpp {
+	namespace internal {
+
+// Character sets where every byte is a whole character, and which
+// agree with ASCII on the bytes we have to escape.  Anything not in
+// this list and not UTF-8 goes through the C API instead.
+static const char* const single_byte_charsets[] = {
+	"armscii8", "ascii", "binary", "cp1250", "cp1251", "cp1256",
+	"cp1257", "cp850", "cp852", "cp866", "dec8", "geostd8", "greek",
+	"hebrew", "hp8", "keybcs2", "koi8r", "koi8u", "latin1", "latin2",
+	"latin5", "latin7", "macce", "macroman", "swe7", "tis620", 0
+};
+
+
+//// escape_char ///////////////////////////////////////////////////////
+// Returns the character to put after a backslash to escape c, or 0 if
+// c doesn't need escaping.  This is the same set of characters that
+// mysql_real_escape_string() escapes.
+
+static inline char
+escape_char(unsigned char c)
+{
+	switch (c) {
+		case 0:			return '0';
+		case '\n':		return 'n';
+		case '\r':		return 'r';
+		case '\\':		return '\\';
+		case '\'':		return '\'';
+		case '"':		return '"';
+		case '\032':	return 'Z';
+		default:		return 0;
+	}
+}
+
+
+//// utf8_lead_len /////////////////////////////////////////////////////
+// Length of the multibyte character c appears to start, or 0 if c
+// can't start one.  Mirrors the C API's my_mbcharlen_utf8*().
+
+static inline size_t
+utf8_lead_len(unsigned char c, escape_charset ec)
+{
+	if (c < 0xc2) return 0;
+	if (c < 0xe0) return 2;
+	if (c < 0xf0) return 3;
+	if (c < 0xf8 && ec == ec_utf8mb4) return 4;
+	return 0;
+}
+
+
+//// utf8_valid_len ////////////////////////////////////////////////////
+// Length of the well-formed multibyte character at s, or 0 if there
+// isn't one.  Mirrors the C API's my_valid_mbcharlen_utf8*(), which
+// is what decides whether mysql_real_escape_string() copies the bytes
+// through untouched.
+
+static size_t
+utf8_valid_len(const unsigned char* s, const unsigned char* e,
+		escape_charset ec)
+{
+	unsigned char c = s[0];
+	if (c < 0xc2) {
+		return 0;
+	}
+	else if (c < 0xe0) {
+		if (e - s < 2) return 0;
+		return (s[1] ^ 0x80) < 0x40 ? 2 : 0;
+	}
+	else if (c < 0xf0) {
+		if (e - s < 3) return 0;
+		return ((s[1] ^ 0x80) < 0x40 && (s[2] ^ 0x80) < 0x40 &&
+				(c >= 0xe1 || s[1] >= 0xa0)) ? 3 : 0;
+	}
+	else if (c < 0xf5 && ec == ec_utf8mb4) {
+		if (e - s < 4) return 0;
+		return ((s[1] ^ 0x80) < 0x40 && (s[2] ^ 0x80) < 0x40 &&
+				(s[3] ^ 0x80) < 0x40 &&
+				(c >= 0xf1 || s[1] >= 0x90) &&
+				(c <= 0xf3 || s[1] <= 0x8f)) ? 4 : 0;
+	}
+	else {
+		return 0;
+	}
+}
+
+
+#if defined(MYSQLPP_ESCAPE_SSE2)
+//// special_mask //////////////////////////////////////////////////////
+// Returns a bit mask with bit i set if byte i of v needs attention.
+
+static inline int
+special_mask(__m128i v, bool stop_on_high)
+{
+	const __m128i hits = _mm_or_si128(
+			_mm_or_si128(
+				_mm_or_si128(
+					_mm_cmpeq_epi8(v, _mm_setzero_si128()),
+					_mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))),
+				_mm_or_si128(
+					_mm_cmpeq_epi8(v, _mm_set1_epi8('\r')),
+					_mm_cmpeq_epi8(v, _mm_set1_epi8('\\')))),
+			_mm_or_si128(
+				_mm_or_si128(
+					_mm_cmpeq_epi8(v, _mm_set1_epi8('\'')),
+					_mm_cmpeq_epi8(v, _mm_set1_epi8('"'))),
+				_mm_cmpeq_epi8(v, _mm_set1_epi8('\032'))));
+	int mask = _mm_movemask_epi8(hits);
+	return stop_on_high ? mask | _mm_movemask_epi8(v) : mask;
+}
+
+
+//// first_bit /////////////////////////////////////////////////////////
+// Index of the lowest set bit in a nonzero mask
+
+static inline size_t
+first_bit(int mask)
+{
+#	if defined(_MSC_VER)
+	unsigned long bit;
+	_BitScanForward(&bit, static_cast<unsigned long>(mask));
+	return bit;
+#	else
+	return __builtin_ctz(static_cast<unsigned>(mask));
+#	endif
+}
+#endif
+
+
+//// is_special ////////////////////////////////////////////////////////
+// Scalar version of special_mask(), for one byte
+
+static inline bool
+is_special(char c, bool stop_on_high)
+{
+	unsigned char uc = static_cast<unsigned char>(c);
+	return (stop_on_high && uc >= 0x80) || escape_char(uc);
+}
+
+
+//// clean_run /////////////////////////////////////////////////////////
+// Returns the number of bytes at the start of p that can be copied
+// through as-is.  With a UTF-8 character set, we also stop on any byte
+// with the high bit set, so escape_one() can decide what it is.
+
+static inline size_t
+clean_run(const char* p, size_t n, bool stop_on_high)
+{
+	size_t i = 0;
+
+#if defined(MYSQLPP_ESCAPE_SSE2)
+	for (/* */; i + 16 <= n; i += 16) {
+		const __m128i v = _mm_loadu_si128(
+				reinterpret_cast<const __m128i*>(p + i));
+		if (int mask = special_mask(v, stop_on_high)) {
+			return i + first_bit(mask);
+		}
+	}
+#endif
+
+	while (i < n && !is_special(p[i], stop_on_high)) {
+		++i;
+	}
+
+	return i;
+}
+
+
+//// copy_clean ////////////////////////////////////////////////////////
+// Like clean_run(), but also copies the clean bytes to to, in the same
+// pass.  Each block is stored whole, even if it holds a special byte;
+// the caller overwrites the tail.  This is safe because the caller's
+// buffer is sized for the worst case, twice the input length, so
+// there's always at least 16 bytes of room past where we are.
+
+static inline size_t
+copy_clean(char* to, const char* from, size_t n, bool stop_on_high)
+{
+	size_t i = 0;
+
+#if defined(MYSQLPP_ESCAPE_SSE2)
+	for (/* */; i + 16 <= n; i += 16) {
+		const __m128i v = _mm_loadu_si128(
+				reinterpret_cast<const __m128i*>(from + i));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(to + i), v);
+		if (int mask = special_mask(v, stop_on_high)) {
+			return i + first_bit(mask);
+		}
+	}
+#endif
+
+	for (/* */; i < n && !is_special(from[i], stop_on_high); ++i) {
+		to[i] = from[i];
+	}
+
+	return i;
+}
+
+
+//// escape_one ////////////////////////////////////////////////////////
+// Handles the byte at from that clean_run() stopped on, writing at
+// most 4 bytes to to.  Advances from past whatever it consumed, and
+// returns the number of bytes written.
+
+static inline size_t
+escape_one(char* to, const char*& from, const char* end, escape_charset ec)
+{
+	unsigned char c = static_cast<unsigned char>(*from);
+	if (c >= 0x80) {
+		// Only reachable with UTF-8.  A well-formed multibyte
+		// character is copied through.  A byte that merely looks like
+		// the start of one gets a backslash in front, same as the C
+		// API does.  Anything else is copied as-is.
+		const unsigned char* s = reinterpret_cast<const unsigned char*>(from);
+		size_t len = utf8_valid_len(s,
+				reinterpret_cast<const unsigned char*>(end), ec);
+		if (len > 1) {
+			memcpy(to, from, len);
+			from += len;
+			return len;
+		}
+		else if (utf8_lead_len(c, ec) > 1) {
+			to[0] = '\\';
+			to[1] = *from++;
+			return 2;
+		}
+		else {
+			to[0] = *from++;
+			return 1;
+		}
+	}
+	else {
+		to[0] = '\\';
+		to[1] = escape_char(c);
+		++from;
+		return 2;
+	}
+}
+
+
+escape_charset
+classify_charset(const char* csname)
+{
+	if (csname == 0) {
+		return ec_unknown;
+	}
+	else if (strcmp(csname, "utf8") == 0 ||
+			strcmp(csname, "utf8mb3") == 0) {
+		return ec_utf8mb3;
+	}
+	else if (strcmp(csname, "utf8mb4") == 0) {
+		return ec_utf8mb4;
+	}
+
+	for (const char* const* pcs = single_byte_charsets; *pcs; ++pcs) {
+		if (strcmp(csname, *pcs) == 0) {
+			return ec_single_byte;
+		}
+	}
+
+	return ec_unknown;
+}
+
+
+size_t
+escape_string(char* to, const char* from, size_t length,
+		escape_charset ec)
+{
+	const bool utf8 = ec != ec_single_byte;
+	const char* const end = from + length;
+	char* const start = to;
+
+	while (from < end) {
+		size_t run = copy_clean(to, from, end - from, utf8);
+		to += run;
+		from += run;
+
+		if (from < end) {
+			to += escape_one(to, from, end, ec);
+		}
+	}
+
+	*to = '\0';
+	return to - start;
+}
+
+
+size_t
+escape_string(std::streambuf* sb, const char* from, size_t length,
+		escape_charset ec)
+{
+	// Escaped bytes and short clean runs between them are gathered
+	// here, so heavily-escaped data doesn't turn into a stream call
+	// per byte.  Long clean runs go straight to the stream buffer.
+	char buf[256];
+	size_t used = 0, total = 0;
+
+	const bool utf8 = ec != ec_single_byte;
+	const char* const end = from + length;
+
+	while (from < end) {
+		size_t run = clean_run(from, end - from, utf8);
+		if (used + run <= sizeof(buf)) {
+			memcpy(buf + used, from, run);
+			used += run;
+		}
+		else {
+			sb->sputn(buf, used);
+			sb->sputn(from, run);
+			total += used + run;
+			used = 0;
+		}
+		from += run;
+
+		if (from < end) {
+			if (used + 4 > sizeof(buf)) {
+				sb->sputn(buf, used);
+				total += used;
+				used = 0;
+			}
+			used += escape_one(buf + used, from, end, ec);
+		}
+	}
+
+	sb->sputn(buf, used);
+	return total + used;
+}
+
+	} // end namespace mysqlpp::internal
+} // end namespace mysqlpp
@@ -0,0 +1,84 @@
+/// \file escape.h
+/// \brief Declares the library-side SQL string escaping routines
+///
+/// None of this is meant to be used outside the library itself.  None
+/// of this is considered part of the library interface.  It is subject
+/// to change at any time, with no notice.  Use the escape_string()
+/// methods in DBDriver, Query or SQLStream instead.
+
+/***********************************************************************
+ Copyright (c) 2015 by Educational Technology Resources, Inc.  Others
+ may also hold copyrights on code in this file.  See the CREDITS.txt
+ file in the top directory of the distribution for details.
+
+ This file is part of MySQL++.
+
+ MySQL++ is free software; you can redistribute it and/or modify it
+ under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 2.1 of the License, or
+ (at your option) any later version.
+
+ MySQL++ is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with MySQL++; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+ USA
+***********************************************************************/
+
+#if !defined(MYSQLPP_ESCAPE_H)
+#define MYSQLPP_ESCAPE_H
+
+#include "common.h"
+
+#include <streambuf>
+
+namespace mysqlpp {
+	namespace internal {
+		/// \brief Character set families our own escaping code knows
+		/// how to handle exactly like \c mysql_real_escape_string()
+		enum escape_charset {
+			ec_unknown,		///< must defer to the C API
+			ec_single_byte,	///< ASCII superset, one byte per character
+			ec_utf8mb3,		///< MySQL's 3-byte "utf8"
+			ec_utf8mb4		///< full 4-byte UTF-8
+		};
+
+		/// \brief Map a MySQL character set name to the family of
+		/// escaping rules it needs
+		///
+		/// Returns ec_unknown for null, unrecognized, and multibyte
+		/// character sets other than UTF-8 (e.g. GBK, SJIS) where a
+		/// trailing byte can look like a quote or backslash.
+		escape_charset MYSQLPP_EXPORT classify_charset(const char* csname);
+
+		/// \brief SQL-escape a character buffer into another buffer
+		///
+		/// \param to buffer to receive the escaped data; must point
+		/// to at least (length * 2 + 1) bytes
+		/// \param from the data to escape
+		/// \param length number of bytes in \c from
+		/// \param ec character set family, anything but ec_unknown
+		///
+		/// \retval number of bytes placed in \c to, not counting the
+		/// null terminator we always add
+		size_t MYSQLPP_EXPORT escape_string(char* to, const char* from,
+				size_t length, escape_charset ec);
+
+		/// \brief SQL-escape a character buffer, writing the result
+		/// directly to a stream buffer
+		///
+		/// Stretches of the input not needing escaping are passed to
+		/// \c sb in a single call, so there is no intermediate copy
+		/// in the common case.
+		///
+		/// \retval number of bytes written to \c sb
+		size_t MYSQLPP_EXPORT escape_string(std::streambuf* sb,
+				const char* from, size_t length, escape_charset ec);
+	} // end namespace mysqlpp::internal
+} // end namespace mysqlpp
+
+#endif // !defined(MYSQLPP_ESCAPE_H)
@@ -0,0 +1,147 @@
+/***********************************************************************
+ histogram.cpp - Implements the Histogram class.
+
+ Copyright (c) 2015 by Educational Technology Resources, Inc.  Others
+ may also hold copyrights on code in this file.  See the CREDITS.txt
+ file in the top directory of the distribution for details.
+
+ This file is part of MySQL++.
+
+ MySQL++ is free software; you can redistribute it and/or modify it
+ under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 2.1 of the License, or
+ (at your option) any later version.
+
+ MySQL++ is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with MySQL++; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+ USA
+***********************************************************************/
+
+#define MYSQLPP_NOT_HEADER
+#include "histogram.h"
+
+#include <math.h>
+#include <string.h>
+
+namespace mysqlpp {
+
+// Bucket i >= 8 covers octave (i - 8) / 8 + 3, that is, values with
+// their top bit there, split by the 3 bits below it.
+static const unsigned int sub_bits = 3;
+static const unsigned int sub_buckets = 1 << sub_bits;
+
+
+//// bucket_floor //////////////////////////////////////////////////////
+
+unsigned long long
+Histogram::bucket_floor(size_t i)
+{
+	if (i < sub_buckets) {
+		return i;
+	}
+
+	unsigned int octave =
+			static_cast<unsigned int>(i - sub_buckets) / sub_buckets +
+			sub_bits;
+	unsigned long long sub = (i - sub_buckets) % sub_buckets;
+	return (sub_buckets + sub) << (octave - sub_bits);
+}
+
+
+//// bucket_of /////////////////////////////////////////////////////////
+
+size_t
+Histogram::bucket_of(unsigned long long value)
+{
+	if (value < sub_buckets) {
+		return size_t(value);
+	}
+
+	unsigned int octave = sub_bits;
+	while ((value >> (octave + 1)) && (octave < 63)) {
+		++octave;
+	}
+
+	size_t i = sub_buckets + (octave - sub_bits) * sub_buckets +
+			size_t((value >> (octave - sub_bits)) & (sub_buckets - 1));
+	return i < num_buckets ? i : num_buckets - 1;
+}
+
+
+//// clear /////////////////////////////////////////////////////////////
+
+void
+Histogram::clear()
+{
+	memset(counts_, 0, sizeof(counts_));
+	count_ = sum_ = max_ = 0;
+}
+
+
+//// merge /////////////////////////////////////////////////////////////
+
+void
+Histogram::merge(const Histogram& other)
+{
+	for (size_t i = 0; i < num_buckets; ++i) {
+		counts_[i] += other.counts_[i];
+	}
+	count_ += other.count_;
+	sum_ += other.sum_;
+	if (other.max_ > max_) {
+		max_ = other.max_;
+	}
+}
+
+
+//// percentile ////////////////////////////////////////////////////////
+
+unsigned long long
+Histogram::percentile(double pct) const
+{
+	if (count_ == 0) {
+		return 0;
+	}
+
+	// Find the bucket holding the value with this rank
+	unsigned long long rank =
+			static_cast<unsigned long long>(ceil(pct / 100.0 *
+			double(count_)));
+	if (rank < 1) {
+		rank = 1;
+	}
+	unsigned long long seen = 0;
+	for (size_t i = 0; i < num_buckets; ++i) {
+		seen += counts_[i];
+		if (seen >= rank) {
+			if (i + 1 < num_buckets) {
+				unsigned long long top = bucket_floor(i + 1) - 1;
+				return top < max_ ? top : max_;
+			}
+			break;
+		}
+	}
+	return max_;
+}
+
+
+//// record ////////////////////////////////////////////////////////////
+
+void
+Histogram::record(unsigned long long value)
+{
+	++counts_[bucket_of(value)];
+	++count_;
+	sum_ += value;
+	if (value > max_) {
+		max_ = value;
+	}
+}
+
+} // end namespace mysqlpp
@@ -0,0 +1,106 @@
+/// \file histogram.h
+/// \brief Declares the Histogram class, for recording the spread of
+/// many time measurements in fixed space.
+
+/***********************************************************************
+ Copyright (c) 2015 by Educational Technology Resources, Inc.  Others
+ may also hold copyrights on code in this file.  See the CREDITS.txt
+ file in the top directory of the distribution for details.
+
+ This file is part of MySQL++.
+
+ MySQL++ is free software; you can redistribute it and/or modify it
+ under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 2.1 of the License, or
+ (at your option) any later version.
+
+ MySQL++ is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with MySQL++; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+ USA
+***********************************************************************/
+
+#if !defined(MYSQLPP_HISTOGRAM_H)
+#define MYSQLPP_HISTOGRAM_H
+
+#include "common.h"
+
+#include <stddef.h>
+
+namespace mysqlpp {
+
+/// \brief Counts values, such as times in microseconds, in buckets
+/// whose width grows with the values they hold
+///
+/// Values under 8 each get a bucket of their own.  Above that, each
+/// power of 2 is split into 8 buckets, so a bucket is never wider than
+/// an eighth of the values in it, and percentiles come out within
+/// about 12% of the truth.  Values up to about 2^36, some 19 hours of
+/// microseconds, are told apart; larger ones go in the last bucket.
+///
+/// Recording a value is just a bucket lookup and a few additions, and
+/// the object never allocates memory, so it's cheap enough to use on
+/// every connection grabbed from a pool.  It does no locking of its
+/// own; the caller must keep threads from using one at the same time.
+
+class MYSQLPP_EXPORT Histogram
+{
+public:
+	/// \brief Number of buckets
+	enum { num_buckets = 8 + 33 * 8 };
+
+	/// \brief Create an empty histogram
+	Histogram() { clear(); }
+
+	/// \brief Get the number of values recorded in bucket i
+	unsigned long long bucket(size_t i) const { return counts_[i]; }
+
+	/// \brief Get the smallest value bucket i holds
+	static unsigned long long bucket_floor(size_t i);
+
+	/// \brief Forget all recorded values
+	void clear();
+
+	/// \brief Get the number of values recorded
+	unsigned long long count() const { return count_; }
+
+	/// \brief Get the largest value recorded, or 0 if none
+	unsigned long long max() const { return max_; }
+
+	/// \brief Get the average of the values recorded, or 0 if none
+	double mean() const
+			{ return count_ ? double(sum_) / double(count_) : 0.0; }
+
+	/// \brief Add another histogram's values to this one's
+	void merge(const Histogram& other);
+
+	/// \brief Estimate the value that the given percentage of recorded
+	/// values are at or below, or 0 if none were recorded
+	///
+	/// The estimate is the top of the bucket that value is in, but
+	/// never more than max(), so percentile(100) is exact.
+	unsigned long long percentile(double pct) const;
+
+	/// \brief Record a value
+	void record(unsigned long long value);
+
+	/// \brief Get the sum of the values recorded
+	unsigned long long sum() const { return sum_; }
+
+private:
+	static size_t bucket_of(unsigned long long value);
+
+	unsigned long long counts_[num_buckets];
+	unsigned long long count_;
+	unsigned long long sum_;
+	unsigned long long max_;
+};
+
+} // end namespace mysqlpp
+
+#endif // !defined(MYSQLPP_HISTOGRAM_H)
@@ -158,9 +158,11 @@ private:
 /// if the object to be added would cause the statement to exceed
 /// a maximum size.
 ///
-/// This differs from the SizeThresholdInsertPolicy in that it builds
-/// the VALUES expression and checks whether it would cause the
-/// length of the INSERT statement to exceed the maximum size.
+/// This differs from the SizeThresholdInsertPolicy in that it checks
+/// the actual length of the INSERT statement with each row added.
+/// Query::insertfrom() appends each row to the statement just once,
+/// then uses fits() to decide whether to keep it or to roll it back
+/// out and send what it has built so far.
 template <class AccessController = Transaction>
 class MYSQLPP_EXPORT MaxPacketInsertPolicy
 {
@@ -175,6 +177,18 @@ public:
 	{
 	}
 
+	/// \brief Constructor
+	///
+	/// This version asks the server for its \c max_allowed_packet
+	/// setting, and uses that as the maximum statement size.
+	///
+	/// \param con connection object used for escaping text and
+	///     for finding the packet size limit
+	explicit MaxPacketInsertPolicy(Connection* con) :
+	conn_(con), size_(internal::max_statement_size(con))
+	{
+	}
+
 	/// \brief Constructor
 	///
 	/// This version does not use a Connection* so it will not be
@@ -214,6 +228,16 @@ public:
 		}
 	}
 
+	/// \brief Is a statement of the given length within the limit?
+	///
+	/// \param size length of the INSERT statement, including the
+	///     row just added to it
+	bool fits(int size) const { return size <= size_; }
+
+	/// \brief Tells Query::insertfrom() that we support fits(), so it
+	/// doesn't have to render each row twice through can_add()
+	typedef void speculative_append;
+
 	/// \brief Alias for our access controller type
 	typedef AccessController access_controller;
 
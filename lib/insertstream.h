@@ -0,0 +1,307 @@
+/// \file insertstream.h
+/// \brief Declares the InsertStream class template, which inserts
+/// rows as they're pushed into it, in constant memory.
+
+/***********************************************************************
+ Copyright (c) 2015 by Educational Technology Resources, Inc.  Others
+ may also hold copyrights on code in this file.  See the CREDITS.txt
+ file in the top directory of the distribution for details.
+
+ This file is part of MySQL++.
+
+ MySQL++ is free software; you can redistribute it and/or modify it
+ under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 2.1 of the License, or
+ (at your option) any later version.
+
+ MySQL++ is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with MySQL++; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+ USA
+***********************************************************************/
+
+#if !defined(MYSQLPP_INSERTSTREAM_H)
+#define MYSQLPP_INSERTSTREAM_H
+
+#include "common.h"
+
+#include "connection.h"
+#include "query.h"
+
+#include <cstddef>
+#include <iterator>
+
+namespace mysqlpp {
+
+/// \brief Inserts SSQLS rows into a table as you push them in
+///
+/// Query::insertfrom() needs the whole range up front.  When the rows
+/// come from somewhere else a piece at a time, such as a file parser,
+/// push them into one of these instead.  Each row is added to an
+/// INSERT statement under construction, which is sent whenever the
+/// insert policy says it's full, so memory use stays constant however
+/// many rows go through.  Call close() at the end to send the last
+/// statement and commit.
+///
+/// You can also use it as the destination of an algorithm like
+/// std::copy(), via inserter().
+///
+/// The policy's access controller decides whether statements are
+/// wrapped in transactions.  By default, one transaction spans the
+/// whole stream, as with Query::insertfrom(); you can ask for it to be
+/// committed every so many statements instead, so a long load doesn't
+/// keep a huge transaction open.
+///
+/// Errors are reported as the connection's exception setting says:
+/// thrown, or signalled by a false return.  After an error, the open
+/// transaction has been rolled back, rows not yet sent are discarded,
+/// and the stream refuses further rows.
+///
+/// \param T an SSQLS type
+/// \param InsertPolicy one of the Query insert policies, such as
+///     Query::MaxPacketInsertPolicy<>
+template <class T, class InsertPolicy>
+class InsertStream
+{
+public:
+	/// \brief Output iterator pushing each row assigned through it
+	/// into an InsertStream
+	class iterator
+	{
+	public:
+		typedef std::output_iterator_tag iterator_category;
+		typedef void value_type;
+		typedef void difference_type;
+		typedef void pointer;
+		typedef void reference;
+
+		/// \brief Create an iterator feeding the given stream
+		explicit iterator(InsertStream& s) : s_(&s) { }
+
+		/// \brief Push a row into the stream
+		iterator& operator =(const T& row)
+		{
+			s_->push(row);
+			return *this;
+		}
+
+		iterator& operator *() { return *this; }	///< no-op
+		iterator& operator ++() { return *this; }	///< no-op
+		iterator& operator ++(int) { return *this; }	///< no-op
+
+	private:
+		InsertStream* s_;
+	};
+
+	/// \brief Create the stream
+	///
+	/// \param conn connection to insert rows through
+	/// \param policy insert policy object deciding when to send each
+	///     statement; see insertpolicy.h
+	/// \param group number of statements to send in each transaction,
+	///     or 0 to use one transaction for the whole stream.  Ignored
+	///     if the policy's access controller is NoTransaction.
+	/// \param replace if true, build REPLACE statements instead of
+	///     INSERT
+	InsertStream(Connection* conn, InsertPolicy& policy,
+			unsigned int group = 0, bool replace = false) :
+	conn_(conn),
+	query_(conn->query()),
+	policy_(policy),
+	sink_(*this),
+	group_(group),
+	verb_(replace ? "REPLACE" : "INSERT"),
+	ac_(0),
+	empty_(true),
+	failed_(false),
+	closed_(false),
+	group_statements_(0),
+	rows_(0),
+	statements_(0)
+	{
+	}
+
+	/// \brief Destroy the stream
+	///
+	/// This doesn't send any pending rows: call close() first if you
+	/// want them.  The open transaction, if any, is rolled back.
+	~InsertStream() { delete ac_; }
+
+	/// \brief Send any pending rows, and commit the open transaction
+	///
+	/// The stream accepts no more rows after this.
+	///
+	/// \retval true if all rows pushed into the stream were inserted
+	bool close()
+	{
+		if (closed_ || failed_) {
+			return !failed_;
+		}
+
+		try {
+			if (!flush()) {
+				return false;
+			}
+			if (ac_) {
+				ac_->commit();
+				delete ac_;
+				ac_ = 0;
+			}
+		}
+		catch (...) {
+			abort();
+			throw;
+		}
+
+		closed_ = true;
+		return true;
+	}
+
+	/// \brief Send the statement under construction now, without
+	/// waiting for it to fill up
+	///
+	/// This doesn't commit it, unless that completes a group.
+	bool flush()
+	{
+		if (failed_) {
+			return false;
+		}
+		else if (empty_) {
+			return true;
+		}
+
+		try {
+			if (query_.send_insert(sink_)) {
+				empty_ = true;
+				return true;
+			}
+		}
+		catch (...) {
+			abort();
+			throw;
+		}
+
+		abort();
+		return false;
+	}
+
+	/// \brief Get an output iterator pushing rows into this stream
+	iterator inserter() { return iterator(*this); }
+
+	/// \brief Add a row to the stream
+	///
+	/// This sends the statement under construction first, if the row
+	/// won't fit in it.
+	///
+	/// \retval false if the stream failed, or was closed
+	bool push(const T& row)
+	{
+		if (failed_ || closed_) {
+			return false;
+		}
+
+		try {
+			if (query_.append_insert(row, policy_, verb_, std::string(),
+					sink_, empty_, internal::bool_tag<
+					internal::is_speculative_policy<InsertPolicy>::value>())) {
+				return true;
+			}
+		}
+		catch (...) {
+			abort();
+			throw;
+		}
+
+		abort();
+		return false;
+	}
+
+	/// \brief Alias for push(), allowing chained pushes
+	InsertStream& operator <<(const T& row)
+	{
+		push(row);
+		return *this;
+	}
+
+	/// \brief Get the number of rows inserted so far
+	///
+	/// This counts the rows affected by each statement sent, including
+	/// any later rolled back.
+	ulonglong rows() const { return rows_; }
+
+	/// \brief Get the number of statements sent so far
+	size_t statements() const { return statements_; }
+
+private:
+	typedef typename InsertPolicy::access_controller AccessController;
+
+	/// \brief StatementSink sending each statement through our Query,
+	/// inside a transaction as needed
+	class Sink : public internal::StatementSink
+	{
+	public:
+		explicit Sink(InsertStream& is) : is_(is) { }
+		bool send(const std::string& sql) { return is_.send(sql); }
+
+	private:
+		InsertStream& is_;
+	};
+
+	InsertStream(const InsertStream&);				// can't copy
+	InsertStream& operator =(const InsertStream&);	// can't assign
+
+	/// \brief Give up: roll back, drop pending rows, and refuse more
+	void abort()
+	{
+		failed_ = true;
+		delete ac_;
+		ac_ = 0;
+		query_.reset();
+	}
+
+	/// \brief Send one finished statement
+	bool send(const std::string& sql)
+	{
+		if (!ac_) {
+			ac_ = new AccessController(*conn_);
+			group_statements_ = 0;
+		}
+
+		if (!query_.exec(sql)) {
+			return false;
+		}
+
+		rows_ += query_.affected_rows();
+		++statements_;
+		if (group_ && (++group_statements_ == group_)) {
+			ac_->commit();
+			delete ac_;
+			ac_ = 0;
+		}
+
+		return true;
+	}
+
+	Connection* conn_;
+	Query query_;
+	InsertPolicy& policy_;
+	Sink sink_;
+	unsigned int group_;
+	const char* verb_;
+	AccessController* ac_;
+	bool empty_;
+	bool failed_;
+	bool closed_;
+	unsigned int group_statements_;
+	ulonglong rows_;
+	size_t statements_;
+};
+
+} // end namespace mysqlpp
+
+#endif // !defined(MYSQLPP_INSERTSTREAM_H)
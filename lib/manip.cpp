@@ -38,9 +38,11 @@ SQLQueryParms&
 operator <<(quote_type2 p, SQLTypeAdapter& in)
 {
 	if (in.quote_q()) {
-		string temp("'", 1), escaped;
-		p.qparms->escape_string(&escaped, in.data(), in.length());
-		temp.append(escaped);
+		// Escape straight into temp, after the opening quote
+		string temp("'", 1);
+		temp.resize(1 + in.length() * 2 + 1);
+		temp.resize(1 + p.qparms->escape_string(&temp[1], in.data(),
+				in.length()));
 		temp.append("'", 1);
 		*p.qparms << SQLTypeAdapter(temp, true);
 		return *p.qparms;
@@ -66,17 +68,13 @@ operator <<(quote_type1 o, const SQLTypeAdapter& in)
 
 		// Now, is escaping appropriate for source data type of 'in'?
 		if (in.escape_q()) {
-			string escaped;
-
 			// If it's not a Query*, then it has to be a SQLStream.
 			if (pq) {
-				pq->escape_string(&escaped, in.data(), in.length());
+				pq->write_escaped(in.data(), in.length());
 			}
 			else {
-				psqls->escape_string(&escaped, in.data(), in.length());
+				psqls->write_escaped(in.data(), in.length());
 			}
-
-			o.ostr->write(escaped.data(), escaped.length());
 		}
 		else {
 			o.ostr->write(in.data(), in.length());
@@ -224,17 +222,15 @@ operator <<(escape_type1 o, const SQLTypeAdapter& in)
 		// It's a Query or a SQLStream, so we'll be using unformatted output.
 		// Now, is escaping appropriate for source data type of 'in'?
 		if (in.escape_q()) {
-			string escaped;
-
 			// If it's not a Query*, then it has to be a SQLStream.
 			if (pq) {
-				pq->escape_string(&escaped, in.data(), in.length());
+				pq->write_escaped(in.data(), in.length());
 			}
 			else {
-				psqls->escape_string(&escaped, in.data(), in.length());
+				psqls->write_escaped(in.data(), in.length());
 			}
 
-			return o.ostr->write(escaped.data(), escaped.length());
+			return *o.ostr;
 		}
 		else {
 			// It's not escaped, so just write the unformatted output
@@ -0,0 +1,414 @@
+/***********************************************************************
+ mythread.cpp - Implements the Thread and Monitor classes.
+
+ Copyright (c) 2015 by Educational Technology Resources, Inc.  Others
+ may also hold copyrights on code in this file.  See the CREDITS.txt
+ file in the top directory of the distribution for details.
+
+ This file is part of MySQL++.
+
+ MySQL++ is free software; you can redistribute it and/or modify it
+ under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 2.1 of the License, or
+ (at your option) any later version.
+
+ MySQL++ is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with MySQL++; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+ USA
+***********************************************************************/
+
+#define MYSQLPP_NOT_HEADER
+#include "mythread.h"
+
+#include "connection.h"
+
+#include <errno.h>
+#include <string.h>
+
+#if defined(MYSQLPP_PLATFORM_WINDOWS)
+#	include <process.h>
+#else
+#	if defined(HAVE_PTHREAD)
+#		include <pthread.h>
+#	endif
+#	include <sys/time.h>
+#	include <time.h>
+#endif
+
+namespace mysqlpp {
+
+#define ACTUALLY_DOES_SOMETHING
+#if defined(MYSQLPP_PLATFORM_WINDOWS)
+	struct MonitorImpl
+	{
+		CRITICAL_SECTION mutex;
+		CONDITION_VARIABLE cond;
+	};
+#elif defined(HAVE_PTHREAD)
+	struct MonitorImpl
+	{
+		pthread_mutex_t mutex;
+		pthread_cond_t cond;
+		bool monotonic;			// cond times out on CLOCK_MONOTONIC
+	};
+#else
+// No supported thread type found, so these classes become no-ops.
+#	undef ACTUALLY_DOES_SOMETHING
+#endif
+
+#if defined(ACTUALLY_DOES_SOMETHING)
+	static MonitorImpl* impl_ptr(void* p)
+			{ return static_cast<MonitorImpl*>(p); }
+#endif
+
+
+//// thread_main ///////////////////////////////////////////////////////
+// Platform thread start routine.  The argument is the Thread object,
+// which knows what the caller actually wants run.
+
+#if defined(MYSQLPP_PLATFORM_WINDOWS)
+	static unsigned __stdcall
+	thread_main(void* p)
+	{
+		static_cast<Thread*>(p)->run();
+		return 0;
+	}
+#elif defined(HAVE_PTHREAD)
+	extern "C" {
+		static void*
+		thread_main(void* p)
+		{
+			static_cast<Thread*>(p)->run();
+			return 0;
+		}
+	}
+#endif
+
+
+Thread::Thread() :
+handle_(0),
+fn_(0),
+arg_(0)
+{
+}
+
+
+void
+Thread::join()
+{
+	if (!handle_) {
+		return;
+	}
+
+#if defined(MYSQLPP_PLATFORM_WINDOWS)
+	WaitForSingleObject(static_cast<HANDLE>(handle_), INFINITE);
+	CloseHandle(static_cast<HANDLE>(handle_));
+#elif defined(HAVE_PTHREAD)
+	pthread_t* pt = static_cast<pthread_t*>(handle_);
+	pthread_join(*pt, 0);
+	delete pt;
+#endif
+	handle_ = 0;
+}
+
+
+//// run ///////////////////////////////////////////////////////////////
+// Our threads use connections made on other threads, so the C API's
+// implicit per-thread setup in mysql_init() never happens on them.
+
+void
+Thread::run()
+{
+	Connection::thread_start();
+	fn_(arg_);
+	Connection::thread_end();
+}
+
+
+bool
+Thread::start(Function f, void* arg)
+{
+	if (handle_) {
+		return false;
+	}
+
+	fn_ = f;
+	arg_ = arg;
+
+#if defined(MYSQLPP_PLATFORM_WINDOWS)
+	uintptr_t h = _beginthreadex(0, 0, thread_main, this, 0, 0);
+	handle_ = reinterpret_cast<void*>(h);
+	return h != 0;
+#elif defined(HAVE_PTHREAD)
+	pthread_t* pt = new pthread_t;
+	if (pthread_create(pt, 0, thread_main, this) == 0) {
+		handle_ = pt;
+		return true;
+	}
+	else {
+		delete pt;
+		return false;
+	}
+#else
+	return false;
+#endif
+}
+
+
+bool
+Thread::supported()
+{
+#if defined(ACTUALLY_DOES_SOMETHING)
+	return true;
+#else
+	return false;
+#endif
+}
+
+
+Monitor::Monitor() MYSQLPP_MAY_THROW(MutexFailed)
+#if defined(ACTUALLY_DOES_SOMETHING)
+	: pimpl_(new MonitorImpl)
+#else
+	: pimpl_(0)
+#endif
+{
+#if defined(MYSQLPP_PLATFORM_WINDOWS)
+	InitializeCriticalSection(&impl_ptr(pimpl_)->mutex);
+	InitializeConditionVariable(&impl_ptr(pimpl_)->cond);
+#elif defined(HAVE_PTHREAD)
+	int rc;
+	if ((rc = pthread_mutex_init(&impl_ptr(pimpl_)->mutex, 0)) != 0) {
+		delete impl_ptr(pimpl_);
+		throw MutexFailed(strerror(rc));
+	}
+
+	// Time out timed waits on a clock that doesn't jump when someone
+	// sets the system time, where the platform lets us
+	pthread_condattr_t attr;
+	pthread_condattr_init(&attr);
+	impl_ptr(pimpl_)->monotonic = false;
+#	if defined(HAVE_PTHREAD_CONDATTR_SETCLOCK) && defined(CLOCK_MONOTONIC)
+	impl_ptr(pimpl_)->monotonic =
+			pthread_condattr_setclock(&attr, CLOCK_MONOTONIC) == 0;
+#	endif
+	rc = pthread_cond_init(&impl_ptr(pimpl_)->cond, &attr);
+	pthread_condattr_destroy(&attr);
+	if (rc != 0) {
+		pthread_mutex_destroy(&impl_ptr(pimpl_)->mutex);
+		delete impl_ptr(pimpl_);
+		throw MutexFailed(strerror(rc));
+	}
+#endif
+}
+
+
+Monitor::~Monitor()
+{
+#if defined(ACTUALLY_DOES_SOMETHING)
+#	if defined(MYSQLPP_PLATFORM_WINDOWS)
+		DeleteCriticalSection(&impl_ptr(pimpl_)->mutex);
+#	else
+		pthread_cond_destroy(&impl_ptr(pimpl_)->cond);
+		pthread_mutex_destroy(&impl_ptr(pimpl_)->mutex);
+#	endif
+
+	delete impl_ptr(pimpl_);
+#endif
+}
+
+
+void
+Monitor::lock() MYSQLPP_MAY_THROW(MutexFailed)
+{
+#if defined(MYSQLPP_PLATFORM_WINDOWS)
+	EnterCriticalSection(&impl_ptr(pimpl_)->mutex);
+#elif defined(HAVE_PTHREAD)
+	int rc;
+	if ((rc = pthread_mutex_lock(&impl_ptr(pimpl_)->mutex)) != 0)
+		throw MutexFailed(strerror(rc));
+#endif
+}
+
+
+void
+Monitor::notify_one()
+{
+#if defined(MYSQLPP_PLATFORM_WINDOWS)
+	WakeConditionVariable(&impl_ptr(pimpl_)->cond);
+#elif defined(HAVE_PTHREAD)
+	pthread_cond_signal(&impl_ptr(pimpl_)->cond);
+#endif
+}
+
+
+void
+Monitor::notify_all()
+{
+#if defined(MYSQLPP_PLATFORM_WINDOWS)
+	WakeAllConditionVariable(&impl_ptr(pimpl_)->cond);
+#elif defined(HAVE_PTHREAD)
+	pthread_cond_broadcast(&impl_ptr(pimpl_)->cond);
+#endif
+}
+
+
+void
+Monitor::unlock() MYSQLPP_MAY_THROW(MutexFailed)
+{
+#if defined(MYSQLPP_PLATFORM_WINDOWS)
+	LeaveCriticalSection(&impl_ptr(pimpl_)->mutex);
+#elif defined(HAVE_PTHREAD)
+	int rc;
+	if ((rc = pthread_mutex_unlock(&impl_ptr(pimpl_)->mutex)) != 0)
+		throw MutexFailed(strerror(rc));
+#endif
+}
+
+
+void
+Monitor::wait()
+{
+#if defined(MYSQLPP_PLATFORM_WINDOWS)
+	SleepConditionVariableCS(&impl_ptr(pimpl_)->cond,
+			&impl_ptr(pimpl_)->mutex, INFINITE);
+#elif defined(HAVE_PTHREAD)
+	pthread_cond_wait(&impl_ptr(pimpl_)->cond, &impl_ptr(pimpl_)->mutex);
+#endif
+}
+
+
+bool
+Monitor::wait(unsigned long ms)
+{
+#if defined(MYSQLPP_PLATFORM_WINDOWS)
+	return SleepConditionVariableCS(&impl_ptr(pimpl_)->cond,
+			&impl_ptr(pimpl_)->mutex, DWORD(ms)) != 0;
+#elif defined(HAVE_PTHREAD)
+	// Convert our relative timeout to an absolute time on the clock
+	// the condition variable uses, which is the wall clock unless the
+	// ctor managed to switch it to the monotonic one.
+	struct timespec now;
+#	if defined(HAVE_PTHREAD_CONDATTR_SETCLOCK) && defined(CLOCK_MONOTONIC)
+	if (impl_ptr(pimpl_)->monotonic) {
+		clock_gettime(CLOCK_MONOTONIC, &now);
+	}
+	else
+#	endif
+	{
+		struct timeval tv;
+		gettimeofday(&tv, 0);
+		now.tv_sec = tv.tv_sec;
+		now.tv_nsec = long(tv.tv_usec) * 1000;
+	}
+	unsigned long long ns = static_cast<unsigned long long>(now.tv_nsec) +
+			static_cast<unsigned long long>(ms % 1000) * 1000000;
+	struct timespec until;
+	until.tv_sec = now.tv_sec + time_t(ms / 1000) + time_t(ns / 1000000000);
+	until.tv_nsec = long(ns % 1000000000);
+
+	return pthread_cond_timedwait(&impl_ptr(pimpl_)->cond,
+			&impl_ptr(pimpl_)->mutex, &until) != ETIMEDOUT;
+#else
+	(void)ms;
+	return false;
+#endif
+}
+
+
+ThreadLocal::ThreadLocal(Cleanup cleanup) MYSQLPP_MAY_THROW(MutexFailed) :
+pimpl_(0)
+{
+#if defined(MYSQLPP_PLATFORM_WINDOWS)
+	(void)cleanup;			// TLS indexes have no such thing
+	DWORD index = TlsAlloc();
+	if (index == TLS_OUT_OF_INDEXES) {
+		throw MutexFailed("TlsAlloc() failed");
+	}
+	pimpl_ = new DWORD(index);
+#elif defined(HAVE_PTHREAD)
+	pthread_key_t* pk = new pthread_key_t;
+	int rc;
+	if ((rc = pthread_key_create(pk, cleanup)) != 0) {
+		delete pk;
+		throw MutexFailed(strerror(rc));
+	}
+	pimpl_ = pk;
+#else
+	(void)cleanup;
+#endif
+}
+
+
+ThreadLocal::~ThreadLocal()
+{
+#if defined(MYSQLPP_PLATFORM_WINDOWS)
+	TlsFree(*static_cast<DWORD*>(pimpl_));
+	delete static_cast<DWORD*>(pimpl_);
+#elif defined(HAVE_PTHREAD)
+	pthread_key_delete(*static_cast<pthread_key_t*>(pimpl_));
+	delete static_cast<pthread_key_t*>(pimpl_);
+#endif
+}
+
+
+void*
+ThreadLocal::get() const
+{
+#if defined(MYSQLPP_PLATFORM_WINDOWS)
+	return TlsGetValue(*static_cast<DWORD*>(pimpl_));
+#elif defined(HAVE_PTHREAD)
+	return pthread_getspecific(*static_cast<pthread_key_t*>(pimpl_));
+#else
+	return pimpl_;
+#endif
+}
+
+
+void
+ThreadLocal::set(void* p)
+{
+#if defined(MYSQLPP_PLATFORM_WINDOWS)
+	TlsSetValue(*static_cast<DWORD*>(pimpl_), p);
+#elif defined(HAVE_PTHREAD)
+	pthread_setspecific(*static_cast<pthread_key_t*>(pimpl_), p);
+#else
+	pimpl_ = p;
+#endif
+}
+
+
+unsigned long long
+internal::now_us()
+{
+#if defined(MYSQLPP_PLATFORM_WINDOWS)
+	LARGE_INTEGER freq, count;
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&count);
+	return (unsigned long long)(count.QuadPart / freq.QuadPart) * 1000000 +
+			(unsigned long long)(count.QuadPart % freq.QuadPart) *
+			1000000 / freq.QuadPart;
+#else
+#	if defined(CLOCK_MONOTONIC)
+	struct timespec ts;
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0) {
+		return static_cast<unsigned long long>(ts.tv_sec) * 1000000 +
+				ts.tv_nsec / 1000;
+	}
+#	endif
+
+	// No monotonic clock, so the wall clock will have to do
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+	return static_cast<unsigned long long>(tv.tv_sec) * 1000000 +
+			tv.tv_usec;
+#endif
+}
+
+} // end namespace mysqlpp
@@ -0,0 +1,234 @@
+/// \file mythread.h
+/// \brief Declares the Thread and Monitor classes, thin wrappers
+/// around the platform's threads and condition variables.
+
+/***********************************************************************
+ Copyright (c) 2015 by Educational Technology Resources, Inc.  Others
+ may also hold copyrights on code in this file.  See the CREDITS.txt
+ file in the top directory of the distribution for details.
+
+ This file is part of MySQL++.
+
+ MySQL++ is free software; you can redistribute it and/or modify it
+ under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 2.1 of the License, or
+ (at your option) any later version.
+
+ MySQL++ is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with MySQL++; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+ USA
+***********************************************************************/
+
+#if !defined(MYSQLPP_MYTHREAD_H)
+#define MYSQLPP_MYTHREAD_H
+
+#include "common.h"
+
+#include "exceptions.h"
+
+namespace mysqlpp {
+
+/// \brief Wrapper around platform-specific threads
+///
+/// Like BeecryptMutex, this class is only intended to be used within
+/// the library.  It supports POSIX threads and Windows threads; on
+/// other platforms, supported() returns false and start() always
+/// fails, so callers must be prepared to do the work themselves.
+///
+/// The new thread calls Connection::thread_start() before running
+/// the given function and Connection::thread_end() after, so the
+/// function may use connections made on other threads.
+
+class MYSQLPP_EXPORT Thread
+{
+public:
+	/// \brief Type of function a thread runs
+	typedef void (*Function)(void*);
+
+	/// \brief Create the object, without starting a thread
+	Thread();
+
+	/// \brief Destroy the object, first waiting for the thread to
+	/// finish if it is still running
+	~Thread() { join(); }
+
+	/// \brief Wait for the thread to finish
+	///
+	/// Does nothing if the thread isn't running.
+	void join();
+
+	/// \brief Returns true if a thread is running, or has finished but
+	/// not yet been joined
+	bool running() const { return handle_ != 0; }
+
+	/// \brief Start a new thread running \c f(arg)
+	///
+	/// \retval false if a thread is already running, if the thread
+	/// couldn't be created, or if threads aren't supported()
+	bool start(Function f, void* arg);
+
+	/// \brief Returns true if this platform supports threads
+	static bool supported();
+
+#if !defined(DOXYGEN_IGNORE)
+	// Called on the new thread by the platform start routine
+	void run();
+#endif
+
+private:
+	Thread(const Thread&);				// can't copy
+	Thread& operator =(const Thread&);	// can't assign
+
+	void* handle_;
+	Function fn_;
+	void* arg_;
+};
+
+
+/// \brief A mutex paired with a condition variable
+///
+/// This is for code that has to wait for some shared state to change,
+/// such as a thread waiting for work to do.  Lock it with a
+/// Monitor::Lock, then call wait() in a loop until the state you're
+/// waiting for comes about.  Code changing that state must hold the
+/// lock while it does so, then call notify_one() or notify_all().
+///
+/// As with BeecryptMutex, if the platform has no supported threads,
+/// this class becomes a no-op.  wait() returns immediately then, so
+/// never wait for something that only another thread can bring about
+/// without checking Thread::supported() first.
+
+class MYSQLPP_EXPORT Monitor
+{
+public:
+	/// \brief Scope-bound locking of a Monitor, like ScopedLock
+	class Lock
+	{
+	public:
+		/// \brief Lock the monitor
+		explicit Lock(Monitor& m) :
+		monitor_(m)
+		{
+			m.lock();
+		}
+
+		/// \brief Unlock the monitor
+		~Lock() { monitor_.unlock(); }
+
+	private:
+		Lock(const Lock&);				// can't copy
+		Lock& operator =(const Lock&);	// can't assign
+
+		Monitor& monitor_;
+	};
+
+	/// \brief Create the monitor
+	///
+	/// Throws MutexFailed if the underlying objects can't be created.
+	Monitor() MYSQLPP_MAY_THROW(MutexFailed);
+
+	/// \brief Destroy the monitor
+	~Monitor();
+
+	/// \brief Acquire the monitor's mutex, blocking until we can
+	void lock() MYSQLPP_MAY_THROW(MutexFailed);
+
+	/// \brief Wake one thread blocked in wait(), if there are any
+	void notify_one();
+
+	/// \brief Wake all threads blocked in wait()
+	void notify_all();
+
+	/// \brief Release the monitor's mutex
+	void unlock() MYSQLPP_MAY_THROW(MutexFailed);
+
+	/// \brief Release the mutex, wait to be notified, and then
+	/// reacquire it
+	///
+	/// Wakeups can be spurious, so always call this in a loop that
+	/// tests for the condition you're waiting on.  You must hold the
+	/// lock when calling this.
+	void wait();
+
+	/// \brief As wait(), but give up after the given number of
+	/// milliseconds
+	///
+	/// \retval false if the time ran out without our being notified
+	bool wait(unsigned long ms);
+
+private:
+	Monitor(const Monitor&);				// can't copy
+	Monitor& operator =(const Monitor&);	// can't assign
+
+	void* pimpl_;
+};
+
+
+/// \brief A pointer with a separate value for each thread
+///
+/// Every thread sees 0 until it calls set().  Nothing is done with
+/// the values when this object is destroyed, so the owner must keep
+/// track of whatever they point to.
+///
+/// The platform has only so many of these to go around, as few as 64
+/// on Windows, so a library shouldn't create one per object.
+///
+/// If the platform has no supported threads, this is just a pointer.
+
+class MYSQLPP_EXPORT ThreadLocal
+{
+public:
+	/// \brief Type of function called with a thread's value when it
+	/// exits
+	typedef void (*Cleanup)(void*);
+
+	/// \brief Create the object
+	///
+	/// If \c cleanup isn't 0, it's called with each thread's value as
+	/// the thread exits, unless the value is 0.  Only POSIX threads
+	/// support this; elsewhere, the values are left as they are.
+	///
+	/// Throws MutexFailed if the underlying thread-local storage slot
+	/// can't be created.
+	explicit ThreadLocal(Cleanup cleanup = 0) MYSQLPP_MAY_THROW(MutexFailed);
+
+	/// \brief Destroy the object
+	~ThreadLocal();
+
+	/// \brief Get the calling thread's value
+	void* get() const;
+
+	/// \brief Change the calling thread's value
+	void set(void* p);
+
+private:
+	ThreadLocal(const ThreadLocal&);				// can't copy
+	ThreadLocal& operator =(const ThreadLocal&);	// can't assign
+
+	void* pimpl_;
+};
+
+
+namespace internal {
+
+/// \brief Get the time in microseconds on a monotonic clock
+///
+/// The clock has no particular starting point, so its only use is
+/// measuring intervals, but setting the system time doesn't move it.
+/// That makes it the right clock for timeouts and statistics.
+MYSQLPP_EXPORT unsigned long long now_us();
+
+/// \brief Get the time in milliseconds on the now_us() clock
+inline unsigned long long now_ms() { return now_us() / 1000; }
+
+} // end namespace internal
+
+} // end namespace mysqlpp
+
+#endif // !defined(MYSQLPP_MYTHREAD_H)
@@ -0,0 +1,289 @@
+/***********************************************************************
+ parallelinsert.cpp - Implements the ParallelInsert class.
+
+ Copyright (c) 2015 by Educational Technology Resources, Inc.  Others
+ may also hold copyrights on code in this file.  See the CREDITS.txt
+ file in the top directory of the distribution for details.
+
+ This file is part of MySQL++.
+
+ MySQL++ is free software; you can redistribute it and/or modify it
+ under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 2.1 of the License, or
+ (at your option) any later version.
+
+ MySQL++ is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with MySQL++; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+ USA
+***********************************************************************/
+
+#define MYSQLPP_NOT_HEADER
+#include "parallelinsert.h"
+
+#if defined(MYSQLPP_MYSQL_HEADERS_BURIED)
+#	include <mysql/errmsg.h>
+#	include <mysql/mysqld_error.h>
+#else
+#	include <errmsg.h>
+#	include <mysqld_error.h>
+#endif
+
+namespace mysqlpp {
+
+// How many chunks each writer may have waiting in the queue.  Enough
+// that a writer finishing a chunk never has to wait for the renderer,
+// but small enough to keep memory use in check.
+static const size_t chunks_per_writer = 2;
+
+// Why a chunk failed when we couldn't get a connection for it, or for
+// an earlier chunk
+static const char* const no_connection =
+		"Timed out waiting for a connection from the pool";
+static const char* const abandoned =
+		"Not sent, because the run failed to get a pool connection";
+
+
+ParallelInsert::ParallelInsert(ConnectionPool& pool, unsigned int writers,
+		unsigned int retries, unsigned long grab_timeout) :
+OptionalExceptions(),
+pool_(pool),
+writers_(writers ? writers : 1),
+retries_(retries),
+grab_timeout_(grab_timeout),
+render_conn_(0),
+inline_conn_(0),
+done_(false),
+abandoned_(false)
+{
+}
+
+
+//// abandon ///////////////////////////////////////////////////////////
+// Record that a chunk couldn't get a connection, and stop the run: we
+// render no more chunks, and those already queued fail unsent.  This
+// is what keeps a bounded pool with fewer free connections than we have
+// writers from hanging the run.
+
+void
+ParallelInsert::abandon(size_t chunk)
+{
+	Monitor::Lock lock(monitor_);
+	abandoned_ = true;
+	fail(chunk, 0, no_connection);
+	monitor_.notify_all();
+}
+
+
+Connection*
+ParallelInsert::begin()
+{
+	result_ = ParallelInsertResult();
+	queue_.clear();
+	done_ = false;
+	abandoned_ = false;
+
+	if ((render_conn_ = pool_.timed_grab(grab_timeout_)) == 0) {
+		abandon(0);
+		return 0;
+	}
+
+	if (Thread::supported()) {
+		for (unsigned int i = 0; i < writers_; ++i) {
+			Thread* pt = new Thread;
+			if (pt->start(writer_main, this)) {
+				threads_.push_back(pt);
+			}
+			else {
+				delete pt;
+				break;
+			}
+		}
+	}
+
+	return render_conn_;
+}
+
+
+const ParallelInsertResult&
+ParallelInsert::end(bool rethrowing)
+{
+	{
+		Monitor::Lock lock(monitor_);
+		done_ = true;
+		monitor_.notify_all();
+	}
+
+	for (size_t i = 0; i < threads_.size(); ++i) {
+		threads_[i]->join();
+		delete threads_[i];
+	}
+	threads_.clear();
+
+	if (render_conn_) {
+		pool_.release(render_conn_);
+		render_conn_ = 0;
+	}
+	if (inline_conn_) {
+		pool_.release(inline_conn_);
+		inline_conn_ = 0;
+	}
+
+	if (!rethrowing && !result_.ok() && throw_exceptions()) {
+		const ParallelInsertResult::Failure& f = result_.failures.front();
+		throw BadQuery(f.error, f.errnum);
+	}
+
+	return result_;
+}
+
+
+//// fail //////////////////////////////////////////////////////////////
+// Add a chunk to the failure list.  The caller holds the lock.
+
+void
+ParallelInsert::fail(size_t chunk, int errnum, const std::string& error)
+{
+	ParallelInsertResult::Failure f;
+	f.chunk = chunk;
+	f.errnum = errnum;
+	f.error = error;
+	result_.failures.push_back(f);
+}
+
+
+bool
+ParallelInsert::submit(const std::string& sql)
+{
+	if (threads_.empty()) {
+		// No writers, so do it ourselves
+		write_chunk(inline_conn_, Chunk(result_.chunks++, sql));
+		return !abandoned_;
+	}
+
+	Monitor::Lock lock(monitor_);
+	while (!abandoned_ &&
+			(queue_.size() >= threads_.size() * chunks_per_writer)) {
+		monitor_.wait();
+	}
+	if (abandoned_) {
+		return false;
+	}
+
+	queue_.push_back(Chunk(result_.chunks++, sql));
+	monitor_.notify_all();
+	return true;
+}
+
+
+void
+ParallelInsert::write_chunk(Connection*& conn, const Chunk& chunk)
+{
+	int errnum = 0;
+	std::string error;
+	ulonglong rows = 0;
+	unsigned int tries = 0;
+	bool ok = false;
+
+	{
+		Monitor::Lock lock(monitor_);
+		if (abandoned_) {
+			fail(chunk.first, 0, abandoned);
+			return;
+		}
+	}
+
+	for (;;) {
+		try {
+			if (!conn && ((conn = pool_.timed_grab(grab_timeout_)) == 0)) {
+				abandon(chunk.first);
+				return;
+			}
+
+			Query q(conn->query());
+			q.disable_exceptions();
+			if (q.exec(chunk.second)) {
+				rows = q.affected_rows();
+				ok = true;
+				break;
+			}
+
+			errnum = q.errnum();
+			error = q.error();
+		}
+		catch (const std::exception& e) {
+			errnum = 0;
+			error = e.what();
+		}
+
+		bool lost = errnum == CR_SERVER_GONE_ERROR ||
+				errnum == CR_SERVER_LOST;
+		bool transient = lost || errnum == ER_LOCK_DEADLOCK ||
+				errnum == ER_LOCK_WAIT_TIMEOUT;
+		if (!transient || (tries++ == retries_)) {
+			break;
+		}
+
+		if (lost) {
+			// Get a fresh connection on the next try
+			pool_.remove(conn);
+			conn = 0;
+		}
+
+		Monitor::Lock lock(monitor_);
+		++result_.retries;
+	}
+
+	Monitor::Lock lock(monitor_);
+	if (ok) {
+		result_.rows += rows;
+	}
+	else {
+		fail(chunk.first, errnum, error);
+	}
+}
+
+
+void
+ParallelInsert::write_loop()
+{
+	Connection* conn = 0;
+
+	for (;;) {
+		Chunk chunk;
+		{
+			Monitor::Lock lock(monitor_);
+			while (queue_.empty() && !done_) {
+				monitor_.wait();
+			}
+
+			if (queue_.empty()) {
+				break;			// done, and nothing left to do
+			}
+
+			chunk = queue_.front();
+			queue_.pop_front();
+			monitor_.notify_all();	// there's room in the queue now
+		}
+
+		write_chunk(conn, chunk);
+	}
+
+	if (conn) {
+		pool_.release(conn);
+	}
+}
+
+
+void
+ParallelInsert::writer_main(void* pi)
+{
+	static_cast<ParallelInsert*>(pi)->write_loop();
+}
+
+} // end namespace mysqlpp
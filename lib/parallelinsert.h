@@ -0,0 +1,261 @@
+/// \file parallelinsert.h
+/// \brief Declares the ParallelInsert class, which spreads a bulk
+/// insert across several connections from a ConnectionPool.
+
+/***********************************************************************
+ Copyright (c) 2015 by Educational Technology Resources, Inc.  Others
+ may also hold copyrights on code in this file.  See the CREDITS.txt
+ file in the top directory of the distribution for details.
+
+ This file is part of MySQL++.
+
+ MySQL++ is free software; you can redistribute it and/or modify it
+ under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 2.1 of the License, or
+ (at your option) any later version.
+
+ MySQL++ is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with MySQL++; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+ USA
+***********************************************************************/
+
+#if !defined(MYSQLPP_PARALLELINSERT_H)
+#define MYSQLPP_PARALLELINSERT_H
+
+#include "common.h"
+
+#include "connection.h"
+#include "cpool.h"
+#include "mythread.h"
+#include "noexceptions.h"
+#include "query.h"
+
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace mysqlpp {
+
+/// \brief Outcome of a ParallelInsert::insertfrom() or replacefrom()
+/// call
+
+struct MYSQLPP_EXPORT ParallelInsertResult
+{
+	/// \brief Details about a chunk that could not be sent
+	struct Failure
+	{
+		size_t chunk;		///< chunk number, counting from 0
+		int errnum;			///< MySQL error number, or 0
+		std::string error;	///< error message
+	};
+
+	/// \brief Number of statements the range was split into
+	size_t chunks;
+
+	/// \brief Total rows affected by the chunks that succeeded
+	ulonglong rows;
+
+	/// \brief Number of times a chunk was re-sent after a transient
+	/// error
+	size_t retries;
+
+	/// \brief Chunks that failed even after retrying, in no
+	/// particular order
+	std::vector<Failure> failures;
+
+	/// \brief Create an empty result
+	ParallelInsertResult() :
+	chunks(0),
+	rows(0),
+	retries(0)
+	{
+	}
+
+	/// \brief Returns true if every chunk succeeded
+	bool ok() const { return failures.empty(); }
+};
+
+
+/// \brief Runs Query::insertfrom() or replacefrom() style bulk
+/// inserts over several pooled connections at once
+///
+/// A single connection can only keep one InnoDB writer busy, so for
+/// big loads it pays to run several INSERT statements at once.  This
+/// class splits the range into statements just as
+/// Query::insertfrom() does, as sized by the insert policy you give,
+/// then hands them to a set of writer threads, each with its own
+/// connection grabbed from the pool.
+///
+/// Each chunk is its own statement, sent with autocommit in effect,
+/// so unlike Query::insertfrom(), there is no transaction spanning
+/// the whole load, and the policy's access controller isn't used.
+/// A chunk that fails with a lost connection, a deadlock or a lock
+/// wait timeout is retried, on a fresh connection from the pool in
+/// the first case.  Retrying an INSERT after a lost connection can
+/// get a duplicate-key error if the first try actually went through,
+/// so prefer replacefrom() where that matters.
+///
+/// Rows are rendered on the calling thread, on one more connection
+/// from the pool, and at most a few chunks are queued ahead of the
+/// writers, so memory use stays bounded however big the range is.
+///
+/// If the pool has a max_size(), it may not have a connection for
+/// every writer, so no one waits more than \c grab_timeout for one.
+/// When that runs out, the run fails: no more rows are rendered, and
+/// the chunk that had to wait and all chunks still queued are listed
+/// as failures.  Give the pool at least \c writers + 1 connections
+/// to spare for the run to succeed.
+///
+/// If the platform doesn't support threads, chunks are sent one at a
+/// time on the calling thread instead.
+
+class MYSQLPP_EXPORT ParallelInsert : public OptionalExceptions
+{
+public:
+	/// \brief Create the object
+	///
+	/// \param pool where to get connections from
+	/// \param writers number of chunks to insert at once
+	/// \param retries number of times to re-send a chunk that failed
+	///     due to a transient error
+	/// \param grab_timeout longest time to wait for a connection from
+	///     the pool, in milliseconds
+	ParallelInsert(ConnectionPool& pool, unsigned int writers = 4,
+			unsigned int retries = 2, unsigned long grab_timeout = 30000);
+
+	/// \brief Insert multiple new rows, spread over several connections
+	///
+	/// \param first iterator pointing to first element in range to
+	///    insert
+	/// \param last iterator pointing to one past the last element to
+	///    insert
+	/// \param policy insert policy object deciding how many rows go
+	///    in each chunk; see insertpolicy.h
+	///
+	/// \return the outcome of the run, also available from result()
+	/// later.  If any chunk failed and exceptions are enabled, throws
+	/// BadQuery instead, after all other chunks are done.  An empty
+	/// range succeeds at once, without touching the pool.
+	template <class Iter, class InsertPolicy>
+	const ParallelInsertResult& insertfrom(Iter first, Iter last,
+			InsertPolicy& policy)
+	{
+		return run(first, last, policy, "INSERT");
+	}
+
+	/// \brief Replace multiple rows, spread over several connections
+	///
+	/// Just like insertfrom(), except that it builds REPLACE statements.
+	template <class Iter, class InsertPolicy>
+	const ParallelInsertResult& replacefrom(Iter first, Iter last,
+			InsertPolicy& policy)
+	{
+		return run(first, last, policy, "REPLACE");
+	}
+
+	/// \brief Get the outcome of the most recent run
+	const ParallelInsertResult& result() const { return result_; }
+
+private:
+	/// \brief A built statement waiting for a writer
+	typedef std::pair<size_t, std::string> Chunk;
+
+	/// \brief StatementSink queuing each statement for the writers
+	class Sink : public internal::StatementSink
+	{
+	public:
+		explicit Sink(ParallelInsert& pi) : pi_(pi) { }
+		bool send(const std::string& sql) { return pi_.submit(sql); }
+
+	private:
+		ParallelInsert& pi_;
+	};
+
+	ParallelInsert(const ParallelInsert&);				// can't copy
+	ParallelInsert& operator =(const ParallelInsert&);	// can't assign
+
+	/// \brief Fail the given chunk for want of a connection, and the
+	/// rest of the run with it
+	void abandon(size_t chunk);
+
+	/// \brief Start a run: start the writers and get a connection to
+	/// render statements with
+	///
+	/// \retval the connection, or 0 if the pool didn't give us one in
+	/// time, which fails the run
+	Connection* begin();
+
+	/// \brief Finish a run: wait for the writers to drain the queue
+	/// and stop, then report
+	const ParallelInsertResult& end(bool rethrowing = false);
+
+	/// \brief Record a failed chunk, with the lock held
+	void fail(size_t chunk, int errnum, const std::string& error);
+
+	/// \brief Do the whole job for insertfrom() and replacefrom()
+	template <class Iter, class InsertPolicy>
+	const ParallelInsertResult& run(Iter first, Iter last,
+			InsertPolicy& policy, const char* verb)
+	{
+		if (first == last) {
+			result_ = ParallelInsertResult();
+			return result_;				// empty set!
+		}
+
+		try {
+			Connection* conn = begin();
+			if (conn) {
+				Query q(conn->query());
+				Sink sink(*this);
+				q.build_inserts(first, last, policy, verb, sink);
+			}
+		}
+		catch (...) {
+			end(true);
+			throw;
+		}
+
+		return end();
+	}
+
+	/// \brief Queue a statement for the writers, or send it ourselves
+	/// if there are none
+	///
+	/// \retval false if the run has been abandoned
+	bool submit(const std::string& sql);
+
+	/// \brief Send one chunk, retrying on transient errors
+	///
+	/// \param conn connection to use, or 0 to grab one from the
+	///     pool; replaced if it goes bad
+	void write_chunk(Connection*& conn, const Chunk& chunk);
+
+	/// \brief Writer thread body
+	void write_loop();
+
+	/// \brief Writer thread entry point
+	static void writer_main(void* pi);
+
+	ConnectionPool& pool_;
+	unsigned int writers_;
+	unsigned int retries_;
+	unsigned long grab_timeout_;
+	ParallelInsertResult result_;
+	Connection* render_conn_;
+	Connection* inline_conn_;
+	std::vector<Thread*> threads_;
+	std::deque<Chunk> queue_;
+	bool done_;
+	bool abandoned_;		// a chunk couldn't get a connection
+	Monitor monitor_;
+};
+
+} // end namespace mysqlpp
+
+#endif // !defined(MYSQLPP_PARALLELINSERT_H)
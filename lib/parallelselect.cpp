@@ -0,0 +1,188 @@
+/***********************************************************************
+ parallelselect.cpp - Implements the ParallelSelect class.
+
+ Copyright (c) 2015 by Educational Technology Resources, Inc.  Others
+ may also hold copyrights on code in this file.  See the CREDITS.txt
+ file in the top directory of the distribution for details.
+
+ This file is part of MySQL++.
+
+ MySQL++ is free software; you can redistribute it and/or modify it
+ under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 2.1 of the License, or
+ (at your option) any later version.
+
+ MySQL++ is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with MySQL++; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+ USA
+***********************************************************************/
+
+#define MYSQLPP_NOT_HEADER
+#include "parallelselect.h"
+
+#if defined(MYSQLPP_MYSQL_HEADERS_BURIED)
+#	include <mysql/errmsg.h>
+#else
+#	include <errmsg.h>
+#endif
+
+#include <algorithm>
+
+namespace mysqlpp {
+
+
+ParallelSelect::ParallelSelect(ConnectionPool& pool, unsigned int readers,
+		unsigned int retries) :
+OptionalExceptions(),
+pool_(pool),
+readers_(readers ? readers : 1),
+retries_(retries),
+chunks_(0),
+merger_(0),
+next_(0),
+failed_(false),
+errnum_(0)
+{
+}
+
+
+bool
+ParallelSelect::read_chunk(Connection*& conn, const std::string& sql,
+		StoreQueryResult& res, int& errnum, std::string& error)
+{
+	for (unsigned int tries = 0; ; ++tries) {
+		try {
+			if (!conn) {
+				conn = pool_.grab();
+			}
+
+			Query q(conn->query());
+			q.disable_exceptions();
+			res = q.store(sql);
+			if (q) {
+				return true;
+			}
+
+			errnum = q.errnum();
+			error = q.error();
+		}
+		catch (const std::exception& e) {
+			errnum = 0;
+			error = e.what();
+		}
+
+		bool lost = errnum == CR_SERVER_GONE_ERROR ||
+				errnum == CR_SERVER_LOST;
+		if (!lost || (tries == retries_)) {
+			return false;
+		}
+
+		// Get a fresh connection on the next try
+		pool_.remove(conn);
+		conn = 0;
+	}
+}
+
+
+void
+ParallelSelect::read_loop()
+{
+	Connection* conn = 0;
+
+	for (;;) {
+		size_t i;
+		{
+			Monitor::Lock lock(monitor_);
+			if (failed_ || (next_ == chunks_->size())) {
+				break;
+			}
+			i = next_++;
+		}
+
+		StoreQueryResult res;
+		int errnum = 0;
+		std::string error;
+		bool ok = read_chunk(conn, (*chunks_)[i], res, errnum, error);
+
+		Monitor::Lock lock(monitor_);
+		if (ok) {
+			try {
+				merger_->merge(res);
+			}
+			catch (const std::exception& e) {
+				ok = false;
+				errnum = 0;
+				error = e.what();
+			}
+		}
+
+		if (!ok && !failed_) {
+			failed_ = true;
+			errnum_ = errnum;
+			error_ = error;
+		}
+	}
+
+	if (conn) {
+		pool_.release(conn);
+	}
+}
+
+
+void
+ParallelSelect::reader_main(void* ps)
+{
+	static_cast<ParallelSelect*>(ps)->read_loop();
+}
+
+
+bool
+ParallelSelect::run(const std::vector<std::string>& chunks,
+		internal::ResultMerger& merger)
+{
+	chunks_ = &chunks;
+	merger_ = &merger;
+	next_ = 0;
+	failed_ = false;
+	errnum_ = 0;
+	error_.clear();
+
+	std::vector<Thread*> threads;
+	if (Thread::supported() && (chunks.size() > 1)) {
+		size_t n = std::min<size_t>(readers_, chunks.size());
+		for (size_t i = 0; i < n; ++i) {
+			Thread* pt = new Thread;
+			if (pt->start(reader_main, this)) {
+				threads.push_back(pt);
+			}
+			else {
+				delete pt;
+				break;
+			}
+		}
+	}
+
+	if (threads.empty()) {
+		// No readers, so do it ourselves
+		read_loop();
+	}
+
+	for (size_t i = 0; i < threads.size(); ++i) {
+		threads[i]->join();
+		delete threads[i];
+	}
+
+	if (failed_ && throw_exceptions()) {
+		throw BadQuery(error_, errnum_);
+	}
+
+	return !failed_;
+}
+
+} // end namespace mysqlpp
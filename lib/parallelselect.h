@@ -0,0 +1,191 @@
+/// \file parallelselect.h
+/// \brief Declares the ParallelSelect class, which spreads a big
+/// select-by-key-list across several connections from a ConnectionPool.
+
+/***********************************************************************
+ Copyright (c) 2015 by Educational Technology Resources, Inc.  Others
+ may also hold copyrights on code in this file.  See the CREDITS.txt
+ file in the top directory of the distribution for details.
+
+ This file is part of MySQL++.
+
+ MySQL++ is free software; you can redistribute it and/or modify it
+ under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 2.1 of the License, or
+ (at your option) any later version.
+
+ MySQL++ is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with MySQL++; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+ USA
+***********************************************************************/
+
+#if !defined(MYSQLPP_PARALLELSELECT_H)
+#define MYSQLPP_PARALLELSELECT_H
+
+#include "common.h"
+
+#include "connection.h"
+#include "cpool.h"
+#include "mythread.h"
+#include "noexceptions.h"
+#include "query.h"
+#include "scopedconnection.h"
+
+#include <string>
+#include <vector>
+
+namespace mysqlpp {
+
+namespace internal {
+	/// \brief Receives each query's result set in ParallelSelect, with
+	/// the object's lock held
+	class MYSQLPP_EXPORT ResultMerger
+	{
+	public:
+		virtual ~ResultMerger() { }
+
+		/// \brief Add the rows to the caller's container
+		virtual void merge(const StoreQueryResult& res) = 0;
+	};
+} // end namespace mysqlpp::internal
+
+
+/// \brief Runs Query::select_in() style lookups over several pooled
+/// connections at once
+///
+/// For a big enough key list, Query::select_in() has to send many
+/// queries, one after another.  This class builds the same queries,
+/// then runs them on a set of reader threads, each with its own
+/// connection grabbed from the pool, merging the rows into your
+/// container as they arrive.  The rows therefore arrive in no
+/// particular order.
+///
+/// A query that fails because the connection was lost is retried on
+/// a fresh connection from the pool.  Any other failure stops the run
+/// once the queries already under way finish.
+///
+/// If the platform doesn't support threads, the queries are run one
+/// at a time on the calling thread instead.
+
+class MYSQLPP_EXPORT ParallelSelect : public OptionalExceptions
+{
+public:
+	/// \brief Create the object
+	///
+	/// \param pool where to get connections from
+	/// \param readers number of queries to run at once
+	/// \param retries number of times to re-send a query that failed
+	///     due to a lost connection
+	ParallelSelect(ConnectionPool& pool, unsigned int readers = 4,
+			unsigned int retries = 2);
+
+	/// \brief Fetch the rows matching a list of keys into an STL
+	/// container of SSQLS objects
+	///
+	/// \param keys STL container of key values; anything SQLTypeAdapter
+	///     accepts will do
+	/// \param con container to add the matching rows to; any STL
+	///     container with an insert(iterator, value) member will do
+	/// \param column name of the key column; defaults to the SSQLS's
+	///     first field
+	///
+	/// \retval true if all queries succeeded.  If one failed and
+	/// exceptions are enabled, throws BadQuery instead.  Either way,
+	/// \c con may hold rows from the queries that succeeded.
+	template <class Keys, class Container>
+	bool select_in(const Keys& keys, Container& con, const char* column = 0)
+	{
+		if (keys.begin() == keys.end()) {
+			return true;	// empty set!
+		}
+
+		typename Container::value_type proto;
+		std::vector<std::string> chunks;
+		{
+			ScopedConnection conn(pool_);
+			Query q(conn->query());
+			CollectSink sink(chunks);
+			q.build_select_in(proto, keys.begin(), keys.end(),
+					column ? column : proto.names[0],
+					internal::max_statement_size(&*conn), sink);
+		}
+
+		Merger<Container> merger(con);
+		return run(chunks, merger);
+	}
+
+private:
+	/// \brief StatementSink saving each statement for the readers
+	class CollectSink : public internal::StatementSink
+	{
+	public:
+		explicit CollectSink(std::vector<std::string>& v) : v_(v) { }
+		bool send(const std::string& sql)
+		{
+			v_.push_back(sql);
+			return true;
+		}
+
+	private:
+		std::vector<std::string>& v_;
+	};
+
+	/// \brief ResultMerger adding rows to an STL container
+	template <class Container>
+	class Merger : public internal::ResultMerger
+	{
+	public:
+		explicit Merger(Container& con) : con_(con) { }
+		void merge(const StoreQueryResult& res)
+		{
+			for (size_t i = 0; i < res.num_rows(); ++i) {
+				con_.insert(con_.end(),
+						typename Container::value_type(res[i]));
+			}
+		}
+
+	private:
+		Container& con_;
+	};
+
+	ParallelSelect(const ParallelSelect&);				// can't copy
+	ParallelSelect& operator =(const ParallelSelect&);	// can't assign
+
+	/// \brief Run the queries, handing each result set to merger
+	bool run(const std::vector<std::string>& chunks,
+			internal::ResultMerger& merger);
+
+	/// \brief Run one query, retrying on a lost connection
+	///
+	/// \param conn connection to use, or 0 to grab one from the
+	///     pool; replaced if it goes bad
+	bool read_chunk(Connection*& conn, const std::string& sql,
+			StoreQueryResult& res, int& errnum, std::string& error);
+
+	/// \brief Reader thread body
+	void read_loop();
+
+	/// \brief Reader thread entry point
+	static void reader_main(void* ps);
+
+	ConnectionPool& pool_;
+	unsigned int readers_;
+	unsigned int retries_;
+	const std::vector<std::string>* chunks_;
+	internal::ResultMerger* merger_;
+	size_t next_;
+	bool failed_;
+	int errnum_;
+	std::string error_;
+	Monitor monitor_;
+};
+
+} // end namespace mysqlpp
+
+#endif // !defined(MYSQLPP_PARALLELSELECT_H)
@@ -0,0 +1,754 @@
+/***********************************************************************
+ prepared.cpp - Implements the PreparedQuery class.
+
+ Copyright (c) 2015 by Educational Technology Resources, Inc.  Others
+ may also hold copyrights on code in this file.  See the CREDITS.txt
+ file in the top directory of the distribution for details.
+
+ This file is part of MySQL++.
+
+ MySQL++ is free software; you can redistribute it and/or modify it
+ under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 2.1 of the License, or
+ (at your option) any later version.
+
+ MySQL++ is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with MySQL++; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+ USA
+***********************************************************************/
+
+#define MYSQLPP_NOT_HEADER
+#include "prepared.h"
+
+#include "connection.h"
+#include "dbdriver.h"
+#include "sql_types.h"
+
+#if defined(MYSQLPP_MYSQL_HEADERS_BURIED)
+#	include <mysql/errmsg.h>
+#	include <mysql/mysqld_error.h>
+#else
+#	include <errmsg.h>
+#	include <mysqld_error.h>
+#endif
+
+#include <cstdlib>
+#include <cstring>
+#include <typeinfo>
+
+using namespace std;
+
+namespace mysqlpp {
+
+// Initial size of the buffer for a string-bound result column.  We
+// grow it on demand when a value doesn't fit, so this only needs to be
+// big enough that typical short values don't cost a second trip.
+static const size_t initial_column_buffer = 64;
+
+
+//// set_flag_ptr //////////////////////////////////////////////////////
+// Point one of MYSQL_BIND's flag pointers at our char storage.  The
+// pointee type is my_bool in older C APIs and bool in newer ones;
+// both are a single byte, and deducing it here saves us from having
+// to know which we've got.
+
+template <typename T>
+static inline void
+set_flag_ptr(T*& member, char* storage)
+{
+	*storage = 0;
+	member = reinterpret_cast<T*>(storage);
+}
+
+
+//// native_type ///////////////////////////////////////////////////////
+// The buffer type we ask the C API to give us a column's values in
+// when the caller wants them in native form.  Anything we don't have a
+// better idea for comes back as a string.
+
+static enum_field_types
+native_type(enum_field_types t)
+{
+	switch (t) {
+		case MYSQL_TYPE_TINY:
+		case MYSQL_TYPE_SHORT:
+		case MYSQL_TYPE_INT24:
+		case MYSQL_TYPE_LONG:
+		case MYSQL_TYPE_LONGLONG:
+		case MYSQL_TYPE_YEAR:
+			return MYSQL_TYPE_LONGLONG;
+
+		case MYSQL_TYPE_FLOAT:
+		case MYSQL_TYPE_DOUBLE:
+			return MYSQL_TYPE_DOUBLE;
+
+		case MYSQL_TYPE_DATE:
+		case MYSQL_TYPE_TIME:
+		case MYSQL_TYPE_DATETIME:
+		case MYSQL_TYPE_TIMESTAMP:
+			return MYSQL_TYPE_DATETIME;
+
+		default:
+			return MYSQL_TYPE_STRING;
+	}
+}
+
+
+//// needs_reprepare ///////////////////////////////////////////////////
+// Returns true if a statement execution error means the server has
+// lost track of the prepared statement, or the C API has closed its
+// side of it, as it does on a session reset, so that preparing it
+// again and retrying is the right fix.
+
+static bool
+needs_reprepare(unsigned int err)
+{
+	switch (err) {
+		case CR_STMT_CLOSED:
+		case ER_UNKNOWN_STMT_HANDLER:
+#if defined(ER_NEED_REPREPARE)
+		case ER_NEED_REPREPARE:
+#endif
+			return true;
+
+		default:
+			return false;
+	}
+}
+
+
+//// parse_integer /////////////////////////////////////////////////////
+// Turn the text form of an integer SQLTypeAdapter holds back into a
+// number.  We made that text with stream2string(), so it's always a
+// plain run of digits with an optional leading minus sign.
+
+static ulonglong
+parse_integer(const char* p, size_t len, bool& negative)
+{
+	const char* end = p + len;
+	negative = (p < end) && (*p == '-');
+	if (negative) ++p;
+
+	ulonglong n = 0;
+	for (/* */; (p < end) && (*p >= '0') && (*p <= '9'); ++p) {
+		n = n * 10 + (*p - '0');
+	}
+
+	return n;
+}
+
+
+PreparedQuery::PreparedQuery(Connection* c, const char* qstr) :
+OptionalExceptions(c ? c->throw_exceptions() : true),
+conn_(c),
+stmt_(0),
+prepared_(false),
+copacetic_(true),
+results_bound_(false),
+text_bound_(false),
+thread_id_(0),
+reprepares_(0)
+{
+	if (qstr) {
+		prepare(qstr, strlen(qstr));
+	}
+}
+
+
+PreparedQuery::PreparedQuery(Connection* c, const std::string& qstr) :
+OptionalExceptions(c ? c->throw_exceptions() : true),
+conn_(c),
+stmt_(0),
+prepared_(false),
+copacetic_(true),
+results_bound_(false),
+text_bound_(false),
+thread_id_(0),
+reprepares_(0)
+{
+	prepare(qstr);
+}
+
+
+PreparedQuery::~PreparedQuery()
+{
+	release();
+}
+
+
+//// bind_param ////////////////////////////////////////////////////////
+// Point a parameter's C API binding at its value, in binary form where
+// the value is a number.
+
+void
+internal::bind_param(MYSQL_BIND& b, PreparedParam& p,
+		const SQLTypeAdapter& value)
+{
+	memset(&b, 0, sizeof(b));
+
+	if (value.is_null()) {
+		b.buffer_type = MYSQL_TYPE_NULL;
+		return;
+	}
+
+	// Integers and floating-point values go over in binary.  The text
+	// SQLTypeAdapter holds is the only form it keeps, so we parse it
+	// back, which is still far cheaper than having the server do it.
+	const std::type_info& t = value.type().c_type();
+	bool is_unsigned = t == typeid(sql_tinyint_unsigned) ||
+			t == typeid(sql_smallint_unsigned) ||
+			t == typeid(sql_int_unsigned) ||
+			t == typeid(sql_bigint_unsigned);
+	if (is_unsigned || t == typeid(sql_tinyint) ||
+			t == typeid(sql_smallint) || t == typeid(sql_int) ||
+			t == typeid(sql_bigint)) {
+		bool negative;
+		ulonglong n = parse_integer(value.data(), value.length(), negative);
+		// Negate n - 1 and then subtract 1, as the most negative value's
+		// magnitude doesn't fit in a longlong
+		p.ival = negative && n ? -static_cast<longlong>(n - 1) - 1 :
+				static_cast<longlong>(n);
+		b.buffer_type = MYSQL_TYPE_LONGLONG;
+		b.buffer = &p.ival;
+		b.is_unsigned = is_unsigned;
+	}
+	else if (t == typeid(sql_float) || t == typeid(sql_double)) {
+		p.dval = strtod(value.data(), 0);
+		b.buffer_type = MYSQL_TYPE_DOUBLE;
+		b.buffer = &p.dval;
+	}
+	else {
+		// Everything else goes as a string, and the server converts it
+		// to the column type.  Dates and times work this way, too.
+		p.length = static_cast<unsigned long>(value.length());
+		b.buffer_type = t == typeid(sql_blob) ?
+				MYSQL_TYPE_BLOB : MYSQL_TYPE_STRING;
+		b.buffer = const_cast<char*>(value.data());
+		b.buffer_length = p.length;
+		b.length = &p.length;
+	}
+}
+
+
+bool
+PreparedQuery::bind_results(bool text)
+{
+	if (results_bound_ && (text_bound_ == text)) {
+		return true;
+	}
+
+	for (size_t i = 0; i < columns_.size(); ++i) {
+		Column& col = columns_[i];
+		MYSQL_BIND& b = result_binds_[i];
+		memset(&b, 0, sizeof(b));
+
+		col.bound_type = text ? MYSQL_TYPE_STRING :
+				native_type(col.field_type);
+		b.buffer_type = col.bound_type;
+		switch (col.bound_type) {
+			case MYSQL_TYPE_LONGLONG:
+				b.buffer = &col.ival;
+				b.is_unsigned = col.is_unsigned;
+				break;
+
+			case MYSQL_TYPE_DOUBLE:
+				b.buffer = &col.dval;
+				break;
+
+			case MYSQL_TYPE_DATETIME:
+				b.buffer = &col.tval;
+				break;
+
+			default:
+				b.buffer = &col.text[0];
+				b.buffer_length = static_cast<unsigned long>(col.text.size());
+				break;
+		}
+		b.length = &col.length;
+		set_flag_ptr(b.is_null, &col.is_null);
+		set_flag_ptr(b.error, &col.error);
+	}
+
+	if (!driver()->stmt_bind_result(stmt_, &result_binds_[0])) {
+		results_bound_ = false;
+		return fail();
+	}
+
+	results_bound_ = true;
+	text_bound_ = text;
+	return true;
+}
+
+
+const PreparedQuery::Column&
+PreparedQuery::column(size_t i) const
+{
+	if (i < columns_.size()) {
+		return columns_[i];
+	}
+	else {
+		throw BadIndex("PreparedQuery", int(i), int(columns_.size()));
+	}
+}
+
+
+DBDriver*
+PreparedQuery::driver() const
+{
+	return conn_->driver();
+}
+
+
+int
+PreparedQuery::errnum() const
+{
+	return error_.empty() && stmt_ ? int(driver()->stmt_errno(stmt_)) : 0;
+}
+
+
+const char*
+PreparedQuery::error() const
+{
+	if (!error_.empty()) {
+		return error_.c_str();
+	}
+	else if (stmt_) {
+		return driver()->stmt_error(stmt_);
+	}
+	else {
+		return "";
+	}
+}
+
+
+SimpleResult
+PreparedQuery::execute()
+{
+	SQLQueryParms p;
+	return execute(p);
+}
+
+
+SimpleResult
+PreparedQuery::execute(SQLQueryParms& p)
+{
+	if (run(p, true)) {
+		if (!columns_.empty()) {
+			// Caller used execute() for a statement that returns rows.
+			// Throw them away so the connection stays in sync.
+			free_result();
+		}
+		DBDriver* dbd = driver();
+		return SimpleResult(true, dbd->stmt_insert_id(stmt_),
+				dbd->stmt_affected_rows(stmt_), "");
+	}
+	else {
+		return SimpleResult();
+	}
+}
+
+
+bool
+PreparedQuery::fail(const char* msg)
+{
+	copacetic_ = false;
+	if (msg) {
+		error_ = msg;
+	}
+	else {
+		error_.clear();
+	}
+
+	if (throw_exceptions()) {
+		throw BadQuery(error(), errnum());
+	}
+
+	return false;
+}
+
+
+bool
+PreparedQuery::fetch()
+{
+	if (!prepared() || !results_bound_) {
+		return false;
+	}
+
+	int rc = driver()->stmt_fetch(stmt_);
+	if (rc == MYSQL_DATA_TRUNCATED) {
+		// At least one string column didn't fit in its buffer.  Grow
+		// each one that overflowed, and fetch its value again.
+		rc = 0;
+		bool rebind = false;
+		for (size_t i = 0; i < columns_.size(); ++i) {
+			Column& col = columns_[i];
+			if (col.error && (col.bound_type == MYSQL_TYPE_STRING) &&
+					(col.length > col.text.size())) {
+				col.text.resize(col.length);
+				MYSQL_BIND& b = result_binds_[i];
+				b.buffer = &col.text[0];
+				b.buffer_length = static_cast<unsigned long>(col.text.size());
+				if (!driver()->stmt_fetch_column(stmt_, &b, unsigned(i), 0)) {
+					rc = 1;
+					break;
+				}
+				rebind = true;
+			}
+		}
+
+		// Point the C API at the bigger buffers for the next row
+		if (rebind && !driver()->stmt_bind_result(stmt_, &result_binds_[0])) {
+			rc = 1;
+		}
+	}
+
+	if (rc == 0) {
+		return true;
+	}
+	else if (rc == MYSQL_NO_DATA) {
+		return false;
+	}
+	else {
+		return fail();
+	}
+}
+
+
+void
+PreparedQuery::free_result()
+{
+	if (stmt_) {
+		driver()->stmt_free_result(stmt_);
+	}
+}
+
+
+DateTime
+PreparedQuery::get_datetime(size_t i) const
+{
+	const Column& col = column(i);
+	if (col.is_null) {
+		return DateTime(0, 0, 0, 0, 0, 0);
+	}
+	else if (col.bound_type == MYSQL_TYPE_DATETIME) {
+		const MYSQL_TIME& t = col.tval;
+		return DateTime(t.year, t.month, t.day, t.hour, t.minute, t.second);
+	}
+	else {
+		return DateTime(get_string(i));
+	}
+}
+
+
+double
+PreparedQuery::get_double(size_t i) const
+{
+	const Column& col = column(i);
+	if (col.is_null) {
+		return 0;
+	}
+
+	switch (col.bound_type) {
+		case MYSQL_TYPE_DOUBLE:
+			return col.dval;
+
+		case MYSQL_TYPE_LONGLONG:
+			return col.is_unsigned ?
+					double(static_cast<ulonglong>(col.ival)) :
+					double(col.ival);
+
+		default:
+			return get_string(i).conv(double(0));
+	}
+}
+
+
+longlong
+PreparedQuery::get_longlong(size_t i) const
+{
+	const Column& col = column(i);
+	if (col.is_null) {
+		return 0;
+	}
+
+	switch (col.bound_type) {
+		case MYSQL_TYPE_LONGLONG:
+			return col.ival;
+
+		case MYSQL_TYPE_DOUBLE:
+			return static_cast<longlong>(col.dval);
+
+		default:
+			return get_string(i).conv(longlong(0));
+	}
+}
+
+
+String
+PreparedQuery::get_string(size_t i) const
+{
+	const Column& col = column(i);
+	if (col.is_null) {
+		return String("NULL", 4, col.field.type(), true);
+	}
+	else if (col.bound_type == MYSQL_TYPE_STRING) {
+		return String(&col.text[0], col.length, col.field.type());
+	}
+
+	// It's bound in native form, so ask the C API to convert this
+	// column of the current row to text for us.  That gets us the same
+	// formatting the text protocol would have.
+	std::vector<char> buf(initial_column_buffer);
+	unsigned long length = 0;
+	MYSQL_BIND b;
+	memset(&b, 0, sizeof(b));
+	b.buffer_type = MYSQL_TYPE_STRING;
+	b.buffer = &buf[0];
+	b.buffer_length = static_cast<unsigned long>(buf.size());
+	b.length = &length;
+	if (driver()->stmt_fetch_column(stmt_, &b, unsigned(i), 0) &&
+			(length > buf.size())) {
+		buf.resize(length);
+		b.buffer = &buf[0];
+		b.buffer_length = length;
+		driver()->stmt_fetch_column(stmt_, &b, unsigned(i), 0);
+	}
+
+	return String(&buf[0], min(size_t(length), buf.size()),
+			col.field.type());
+}
+
+
+ulonglong
+PreparedQuery::get_ulonglong(size_t i) const
+{
+	const Column& col = column(i);
+	if (col.is_null) {
+		return 0;
+	}
+
+	switch (col.bound_type) {
+		case MYSQL_TYPE_LONGLONG:
+			return static_cast<ulonglong>(col.ival);
+
+		case MYSQL_TYPE_DOUBLE:
+			return static_cast<ulonglong>(col.dval);
+
+		default:
+			return get_string(i).conv(ulonglong(0));
+	}
+}
+
+
+ulonglong
+PreparedQuery::insert_id()
+{
+	return stmt_ ? driver()->stmt_insert_id(stmt_) : 0;
+}
+
+
+MYSQL_RES*
+PreparedQuery::metadata()
+{
+	return driver()->stmt_result_metadata(stmt_);
+}
+
+
+bool
+PreparedQuery::prepare(const char* qstr, size_t length)
+{
+	release();
+	sql_.assign(qstr, length);
+	copacetic_ = true;
+	error_.clear();
+
+	if (!conn_ || !conn_->connected()) {
+		return fail("Can't prepare a statement without a connection");
+	}
+	else if ((stmt_ = driver()->stmt_init()) == 0) {
+		return fail(conn_->error());
+	}
+	else if (!driver()->stmt_prepare(stmt_, qstr, length)) {
+		return fail();
+	}
+
+	params_.resize(driver()->stmt_param_count(stmt_));
+	param_binds_.resize(params_.size());
+
+	if (MYSQL_RES* res = metadata()) {
+		DBDriver* dbd = driver();
+		columns_.resize(dbd->num_fields(res));
+		for (size_t i = 0; i < columns_.size(); ++i) {
+			const MYSQL_FIELD* pf = dbd->fetch_field(res, i);
+			Column& col = columns_[i];
+			col.field = Field(pf);
+			col.field_type = pf->type;
+			col.is_unsigned = (pf->flags & UNSIGNED_FLAG) != 0;
+			col.text.resize(min(size_t(pf->length) + 1,
+					initial_column_buffer));
+		}
+		dbd->free_result(res);
+	}
+	result_binds_.resize(columns_.size());
+	row_data_.resize(columns_.size());
+	row_lengths_.resize(columns_.size());
+
+	thread_id_ = driver()->thread_id();
+	prepared_ = true;
+	return true;
+}
+
+
+void
+PreparedQuery::release()
+{
+	if (stmt_) {
+		driver()->stmt_close(stmt_);
+		stmt_ = 0;
+	}
+
+	prepared_ = false;
+	results_bound_ = false;
+	thread_id_ = 0;
+	columns_.clear();
+	result_binds_.clear();
+	params_.clear();
+	param_binds_.clear();
+}
+
+
+bool
+PreparedQuery::reprepare()
+{
+	++reprepares_;
+	std::string qstr(sql_);
+	return prepare(qstr);
+}
+
+
+bool
+PreparedQuery::run(SQLQueryParms& p, bool text)
+{
+	if (!prepared()) {
+		return fail("No statement prepared");
+	}
+
+	// A statement handle dies with the server session it was prepared
+	// in, so if the connection has been re-established since then,
+	// whether by us or by the C API's auto-reconnect feature, we need
+	// a new one.
+	if (conn_->connected() && (driver()->thread_id() != thread_id_) &&
+			!reprepare()) {
+		return false;
+	}
+
+	copacetic_ = true;
+	error_.clear();
+
+	if (p.size() < params_.size()) {
+		copacetic_ = false;
+		if (throw_exceptions()) {
+			throw BadParamCount("Not enough parameters to fill the "
+					"prepared statement's placeholders");
+		}
+		return false;
+	}
+
+	if (!send(p)) {
+		// The server can also invalidate a statement on its own, as when
+		// a table it refers to is altered.  Prepare it again and retry,
+		// but only once, and only for errors that say the statement
+		// never ran.
+		if (!needs_reprepare(driver()->stmt_errno(stmt_))) {
+			return fail();
+		}
+		else if (!reprepare()) {
+			return false;
+		}
+		else if (!send(p)) {
+			return fail();
+		}
+	}
+
+	return columns_.empty() || bind_results(text);
+}
+
+
+bool
+PreparedQuery::send(SQLQueryParms& p)
+{
+	if (!params_.empty()) {
+		for (size_t i = 0; i < params_.size(); ++i) {
+			internal::bind_param(param_binds_[i], params_[i], p[i]);
+		}
+		if (!driver()->stmt_bind_param(stmt_, &param_binds_[0])) {
+			return false;
+		}
+	}
+
+	return driver()->stmt_execute(stmt_);
+}
+
+
+StoreQueryResult
+PreparedQuery::store()
+{
+	SQLQueryParms p;
+	return store(p);
+}
+
+
+StoreQueryResult
+PreparedQuery::store(SQLQueryParms& p)
+{
+	if (!run(p, true)) {
+		return StoreQueryResult();
+	}
+	else if (columns_.empty()) {
+		// Not a SELECT or similar; Query::store() gives an empty result
+		// in this case, too.
+		return StoreQueryResult();
+	}
+
+	// Build the result's field list from the statement's metadata.
+	// The ctor takes ownership of the MYSQL_RES, but since it holds
+	// no rows, all it does is copy the field info out of it.
+	StoreQueryResult res(metadata(), driver(), throw_exceptions());
+	if (driver()->stmt_store_result(stmt_)) {
+		res.reserve(size_t(driver()->stmt_num_rows(stmt_)));
+	}
+	while (fetch()) {
+		res.push_back(text_row(res));
+	}
+
+	return res;
+}
+
+
+Row
+PreparedQuery::text_row(const ResultBase& res)
+{
+	for (size_t i = 0; i < columns_.size(); ++i) {
+		Column& col = columns_[i];
+		row_data_[i] = col.is_null ? 0 : &col.text[0];
+		row_lengths_[i] = col.length;
+	}
+
+	return Row(&row_data_[0], &res, &row_lengths_[0], throw_exceptions());
+}
+
+
+bool
+PreparedQuery::use()
+{
+	SQLQueryParms p;
+	return use(p);
+}
+
+} // end namespace mysqlpp
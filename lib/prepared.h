@@ -0,0 +1,430 @@
+/// \file prepared.h
+/// \brief Declares the PreparedQuery class, a wrapper around MySQL's
+/// server-side prepared statements.
+///
+/// Unlike Query, this uses the binary protocol: parameters travel to
+/// the server in native form instead of being escaped and spliced into
+/// the SQL, and the statement is parsed only once, no matter how many
+/// times you execute it.
+
+/***********************************************************************
+ Copyright (c) 2015 by Educational Technology Resources, Inc.  Others
+ may also hold copyrights on code in this file.  See the CREDITS.txt
+ file in the top directory of the distribution for details.
+
+ This file is part of MySQL++.
+
+ MySQL++ is free software; you can redistribute it and/or modify it
+ under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 2.1 of the License, or
+ (at your option) any later version.
+
+ MySQL++ is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with MySQL++; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+ USA
+***********************************************************************/
+
+#if !defined(MYSQLPP_PREPARED_H)
+#define MYSQLPP_PREPARED_H
+
+#include "common.h"
+
+#include "datetime.h"
+#include "exceptions.h"
+#include "field.h"
+#include "mystring.h"
+#include "noexceptions.h"
+#include "qparms.h"
+#include "querydef.h"
+#include "refcounted.h"
+#include "result.h"
+#include "row.h"
+#include "stadapter.h"
+
+#include <string>
+#include <vector>
+
+namespace mysqlpp {
+
+#if !defined(DOXYGEN_IGNORE)
+// Make Doxygen ignore this
+class MYSQLPP_EXPORT Connection;
+#endif
+
+namespace internal {
+
+/// \brief Storage for a prepared statement parameter's value in the
+/// native form it's sent in
+struct PreparedParam
+{
+	longlong ival;			///< integer parameter value
+	double dval;			///< floating-point parameter value
+	unsigned long length;	///< length of string parameter value
+};
+
+/// \brief Set up the C API binding that sends a value as a prepared
+/// statement parameter
+///
+/// Integers and floating-point values are parsed back out of the text
+/// the SQLTypeAdapter holds into \c p, and bound in binary form.
+/// Everything else is bound as a string pointing into \c value, so it
+/// must outlive the statement's execution.
+///
+/// This is an implementation detail of PreparedQuery, exposed so it
+/// can be tested without a database server.
+MYSQLPP_EXPORT void bind_param(MYSQL_BIND& b, PreparedParam& p,
+		const SQLTypeAdapter& value);
+
+} // end namespace internal
+
+/// \brief A server-side prepared statement
+///
+/// You give this class a SQL statement with \c ? placeholders where
+/// the parameters go, either in the constructor or via prepare().  It
+/// is sent to the server once, and can then be executed any number of
+/// times with different parameters:
+///
+/// \code
+/// mysqlpp::PreparedQuery pq(&conn,
+///         "SELECT item, num FROM stock WHERE id = ?");
+/// mysqlpp::StoreQueryResult res = pq.store(42);
+/// \endcode
+///
+/// Parameters are passed the same way as with template queries, as
+/// SQLTypeAdapter objects, so anything you can put into a template
+/// query works here, too.  Integer and floating-point values are sent
+/// to the server in binary form, and everything else as a string; none
+/// of it needs escaping.
+///
+/// There are two ways to get at a result set.  store() and storein()
+/// give you the usual StoreQueryResult or container of SSQLS objects,
+/// built from Row objects.  use() followed by repeated fetch() calls
+/// instead gives you each row's values in native form through
+/// get_longlong(), get_double() and friends, without going through
+/// text at all.  That's the fastest path for hot queries.
+///
+/// The statement belongs to the connection it was prepared on.  If
+/// that connection is dropped and re-established, the statement is
+/// prepared again automatically the next time you execute it.
+/// Like Query, this class is not thread-safe; don't use one object
+/// from more than one thread at a time.
+///
+/// This class cannot be copied.
+
+class MYSQLPP_EXPORT PreparedQuery : public OptionalExceptions
+{
+private:
+	/// \brief Pointer to bool data member, for use by safe bool
+	/// conversion operator.
+	///
+	/// \see http://www.artima.com/cppsource/safebool.html
+	typedef bool PreparedQuery::*private_bool_type;
+
+public:
+	/// \brief Create a prepared statement object
+	///
+	/// \param c connection the statement will run on
+	/// \param qstr if not null, the SQL statement to prepare right away
+	///
+	/// Exceptions are enabled or disabled to match \c c.
+	explicit PreparedQuery(Connection* c, const char* qstr = 0);
+
+	/// \brief Create a prepared statement object, and prepare the
+	/// given statement
+	PreparedQuery(Connection* c, const std::string& qstr);
+
+	/// \brief Destroy object, releasing the statement on the server
+	~PreparedQuery();
+
+	/// \brief Return the last error number for this statement
+	int errnum() const;
+
+	/// \brief Return the last error message for this statement
+	const char* error() const;
+
+	/// \brief Execute the statement
+	///
+	/// Use this for statements that don't return rows: \c INSERT,
+	/// \c UPDATE, \c DELETE and such.
+	///
+	/// \param p values for the statement's placeholders, in order
+	///
+	/// \return SimpleResult, which tests as false on failure when
+	/// exceptions are disabled
+	SimpleResult execute(SQLQueryParms& p);
+
+	/// \brief Execute a statement that has no placeholders
+	SimpleResult execute();
+
+	/// \brief Execute the statement with a single parameter
+	///
+	/// There are overloads taking up to 25 parameters.
+	SimpleResult execute(const SQLTypeAdapter& arg0)
+			{ return execute(SQLQueryParms() << arg0); }
+
+	/// \brief Fetch the next row of the result set started by use()
+	///
+	/// \return false at the end of the result set, or on error
+	///
+	/// After this returns true, you can retrieve the row's values with
+	/// is_null() and the get_*() accessors.
+	bool fetch();
+
+	/// \brief Get the number of columns in the statement's result set
+	size_t field_count() const { return columns_.size(); }
+
+	/// \brief Get the name of the given result set column
+	const char* field_name(size_t i) const
+			{ return column(i).field.name(); }
+
+	/// \brief Abandon any unread rows of the current result set
+	///
+	/// Call this if you stop calling fetch() before it returns false,
+	/// else the connection will be out of sync for other queries.
+	void free_result();
+
+	/// \brief Get a value from the current row as a DateTime
+	///
+	/// Works with any \c DATE, \c TIME, \c DATETIME or \c TIMESTAMP
+	/// column, and with strings that parse as one.
+	DateTime get_datetime(size_t i) const;
+
+	/// \brief Get a value from the current row as a double
+	double get_double(size_t i) const;
+
+	/// \brief Get a value from the current row as a signed integer
+	///
+	/// Integer columns come straight out of the binary result, with
+	/// no conversion.  Others are converted with String::conv(),
+	/// which throws BadConversion if the value isn't a number.
+	///
+	/// Returns 0 for SQL null; check is_null() if that matters.
+	longlong get_longlong(size_t i) const;
+
+	/// \brief Get a value from the current row in string form
+	String get_string(size_t i) const;
+
+	/// \brief Get a value from the current row as an unsigned integer
+	ulonglong get_ulonglong(size_t i) const;
+
+	/// \brief Get the ID generated for an AUTO_INCREMENT column by
+	/// the last execution of the statement
+	ulonglong insert_id();
+
+	/// \brief Returns true if the given column of the current row is
+	/// SQL null
+	bool is_null(size_t i) const { return column(i).is_null != 0; }
+
+	/// \brief Test whether the object is in a good state
+	///
+	/// It's false if there is no statement prepared, or if the last
+	/// operation failed.
+	operator private_bool_type() const
+	{
+		return stmt_ && prepared_ && copacetic_ ?
+				&PreparedQuery::copacetic_ : 0;
+	}
+
+	/// \brief Get the number of \c ? placeholders in the statement
+	size_t param_count() const { return params_.size(); }
+
+	/// \brief Send a SQL statement to the server to be prepared
+	///
+	/// Any previously-prepared statement is released first.
+	///
+	/// \return true on success; on failure, throws BadQuery if
+	/// exceptions are enabled
+	bool prepare(const char* qstr, size_t length);
+
+	/// \brief Prepare a SQL statement given as a C++ string
+	bool prepare(const std::string& qstr)
+			{ return prepare(qstr.data(), qstr.length()); }
+
+	/// \brief Returns true if a statement has been prepared
+	bool prepared() const { return stmt_ && prepared_; }
+
+	/// \brief Get the number of times we've had to prepare the
+	/// statement again behind the scenes
+	///
+	/// This happens when the connection was re-established since the
+	/// statement was last prepared, or when the server says it has
+	/// lost track of the statement, as with \c ER_NEED_REPREPARE.  In
+	/// either case, execution retries transparently.
+	ulonglong reprepares() const { return reprepares_; }
+
+	/// \brief Get the SQL of the currently-prepared statement
+	const std::string& sql() const { return sql_; }
+
+	/// \brief Execute the statement and return the whole result set
+	///
+	/// The rows are given to you as Row objects, just as with
+	/// Query::store(), so this is interchangeable with it.  Column
+	/// values are converted to text by the C API to build those rows,
+	/// so if you want values in native form, use use() instead.
+	StoreQueryResult store(SQLQueryParms& p);
+
+	/// \brief Execute a statement that has no placeholders, and
+	/// return its result set
+	StoreQueryResult store();
+
+	/// \brief Execute the statement with a single parameter, and
+	/// return its result set
+	StoreQueryResult store(const SQLTypeAdapter& arg0)
+			{ return store(SQLQueryParms() << arg0); }
+
+	/// \brief Execute the statement, storing the result set in a
+	/// sequence container
+	///
+	/// This is the prepared statement version of
+	/// Query::storein_sequence().  Each row is converted to
+	/// \c Sequence::value_type, typically an SSQLS.
+	template <class Sequence>
+	void storein(Sequence& con, SQLQueryParms& p)
+	{
+		if (run(p, true) && !columns_.empty()) {
+			StoreQueryResult proto(metadata(), driver(),
+					throw_exceptions());
+			while (fetch()) {
+				con.push_back(typename Sequence::value_type(text_row(proto)));
+			}
+		}
+	}
+
+	/// \brief Execute a statement with no placeholders, storing the
+	/// result set in a sequence container
+	template <class Sequence>
+	void storein(Sequence& con)
+	{
+		SQLQueryParms p;
+		storein(con, p);
+	}
+
+	/// \brief Execute a statement with a single parameter, storing
+	/// the result set in a sequence container
+	template <class Sequence>
+	void storein(Sequence& con, const SQLTypeAdapter& arg0)
+	{
+		storein(con, SQLQueryParms() << arg0);
+	}
+
+	/// \brief Execute the statement, leaving its result set on the
+	/// server to be read a row at a time with fetch()
+	///
+	/// \return true on success
+	bool use(SQLQueryParms& p) { return run(p, false); }
+
+	/// \brief Execute a statement that has no placeholders, in use()
+	/// fashion
+	bool use();
+
+	/// \brief Execute a statement with a single parameter, in use()
+	/// fashion
+	bool use(const SQLTypeAdapter& arg0)
+			{ return use(SQLQueryParms() << arg0); }
+
+#if !defined(DOXYGEN_IGNORE)
+	// Declare the remaining overloads.  These are hidden down here partly
+	// to keep the above code clear, but also so that we may hide them
+	// from Doxygen, which gets confused by macro instantiations that are
+	// not properly hidden.
+	mysql_query_define0(SimpleResult, execute)
+	mysql_query_define0(StoreQueryResult, store)
+	mysql_query_define0(bool, use)
+	mysql_query_define1(storein)
+#endif // !defined(DOXYGEN_IGNORE)
+
+private:
+	/// \brief Everything we need to bind one result set column
+	struct Column
+	{
+		Field field;			///< column metadata
+		enum_field_types field_type;	///< type the server sends
+		bool is_unsigned;		///< integer column is unsigned
+		enum_field_types bound_type;	///< type we asked the C API for
+		std::vector<char> text;	///< buffer for string-bound columns
+		longlong ival;			///< buffer for integer-bound columns
+		double dval;			///< buffer for float-bound columns
+		MYSQL_TIME tval;		///< buffer for temporal-bound columns
+		unsigned long length;	///< length of value in text
+		char is_null;			///< C API sets this for SQL null
+		char error;				///< C API sets this on truncation
+	};
+
+	/// \brief Bind the result set columns, either all as text or each
+	/// in its native form
+	bool bind_results(bool text);
+
+	/// \brief Get a column descriptor, with range checking
+	const Column& column(size_t i) const;
+
+	/// \brief Get the DB driver of our connection
+	DBDriver* driver() const;
+
+	/// \brief Handle an error, either by throwing or by setting our
+	/// failure flag, depending on the exceptions setting
+	bool fail(const char* msg = 0);
+
+	/// \brief Fetch column metadata for building a StoreQueryResult
+	///
+	/// The caller owns the returned result, but the StoreQueryResult
+	/// ctor frees it for us.
+	MYSQL_RES* metadata();
+
+	/// \brief Release the statement handle, if any
+	void release();
+
+	/// \brief Prepare the current statement again
+	bool reprepare();
+
+	/// \brief Bind the given parameters and execute the statement,
+	/// then bind the result columns in text or native form
+	///
+	/// Re-prepares the statement and retries if need be.
+	bool run(SQLQueryParms& p, bool text);
+
+	/// \brief Bind the given parameters and execute the statement,
+	/// once, leaving error handling to the caller
+	bool send(SQLQueryParms& p);
+
+	/// \brief Build a Row from the current row of a text-bound result
+	///
+	/// \param res supplies the field names and types for the Row
+	Row text_row(const ResultBase& res);
+
+	/// \brief Hidden copy ctor and assignment operator; we can't share
+	/// a statement handle.
+	PreparedQuery(const PreparedQuery&);
+	PreparedQuery& operator=(const PreparedQuery&);
+
+	Connection* conn_;
+	MYSQL_STMT* stmt_;
+	bool prepared_;
+	bool copacetic_;
+	bool results_bound_;
+	bool text_bound_;
+	unsigned long thread_id_;
+	ulonglong reprepares_;
+	std::string sql_;
+	std::string error_;
+	std::vector<Column> columns_;
+	std::vector<MYSQL_BIND> result_binds_;
+	std::vector<internal::PreparedParam> params_;
+	std::vector<MYSQL_BIND> param_binds_;
+	std::vector<char*> row_data_;
+	std::vector<unsigned long> row_lengths_;
+};
+
+
+/// \brief Smart pointer to a PreparedQuery, as handed out by
+/// Connection::prepare()
+typedef RefCountedPointer<PreparedQuery> PreparedQueryPtr;
+
+} // end namespace mysqlpp
+
+#endif // !defined(MYSQLPP_PREPARED_H)
@@ -0,0 +1,130 @@
+/***********************************************************************
+ prober.cpp - Implements the Prober class and probe_pool().
+
+ Copyright (c) 2015 by Educational Technology Resources, Inc.  Others
+ may also hold copyrights on code in this file.  See the CREDITS.txt
+ file in the top directory of the distribution for details.
+
+ This file is part of MySQL++.
+
+ MySQL++ is free software; you can redistribute it and/or modify it
+ under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 2.1 of the License, or
+ (at your option) any later version.
+
+ MySQL++ is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with MySQL++; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+ USA
+***********************************************************************/
+
+#define MYSQLPP_NOT_HEADER
+#include "prober.h"
+
+#include "connection.h"
+#include "cpool.h"
+
+namespace mysqlpp {
+namespace internal {
+
+
+Prober::Prober(Thread::Function f, void* arg, unsigned int interval) :
+fn_(f),
+arg_(arg),
+interval_(interval),
+stopping_(false),
+woken_(false)
+{
+}
+
+
+//// main //////////////////////////////////////////////////////////////
+// Make a call every interval until stop(), or sooner after a wake().
+
+void
+Prober::main(void* p)
+{
+	Prober* self = static_cast<Prober*>(p);
+	for (;;) {
+		self->fn_(self->arg_);
+
+		Monitor::Lock lock(self->monitor_);
+		if (!self->stopping_ && !self->woken_) {
+			self->monitor_.wait(
+					static_cast<unsigned long>(self->interval_) * 1000);
+		}
+		self->woken_ = false;
+		if (self->stopping_) {
+			break;
+		}
+	}
+}
+
+
+void
+Prober::start()
+{
+	if (interval_ && !thread_.running() && Thread::supported()) {
+		thread_.start(main, this);
+	}
+}
+
+
+void
+Prober::stop()
+{
+	{
+		Monitor::Lock lock(monitor_);
+		stopping_ = true;
+		monitor_.notify_all();
+	}
+	thread_.join();
+}
+
+
+void
+Prober::wake()
+{
+	Monitor::Lock lock(monitor_);
+	woken_ = true;
+	monitor_.notify_all();
+}
+
+
+//// probe_pool ////////////////////////////////////////////////////////
+
+bool
+probe_pool(ConnectionPool& pool, bool (*check)(Connection&, void*),
+		void* arg, bool& ok)
+{
+	Connection* conn = 0;
+	try {
+		if (!(conn = pool.timed_grab(1000))) {
+			return false;
+		}
+
+		ok = check(*conn, arg);
+	}
+	catch (const std::exception&) {
+		// Can't reach the server, or can't get an answer from it
+		ok = false;
+	}
+
+	if (conn) {
+		if (ok) {
+			pool.release(conn);
+		}
+		else {
+			pool.remove(conn);
+		}
+	}
+	return true;
+}
+
+} // end namespace internal
+} // end namespace mysqlpp
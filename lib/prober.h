@@ -0,0 +1,125 @@
+/// \file prober.h
+/// \brief Declares the Prober class and probe_pool(), which the pools
+/// that spread work over several servers use to keep an eye on them.
+
+/***********************************************************************
+ Copyright (c) 2015 by Educational Technology Resources, Inc.  Others
+ may also hold copyrights on code in this file.  See the CREDITS.txt
+ file in the top directory of the distribution for details.
+
+ This file is part of MySQL++.
+
+ MySQL++ is free software; you can redistribute it and/or modify it
+ under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 2.1 of the License, or
+ (at your option) any later version.
+
+ MySQL++ is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with MySQL++; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+ USA
+***********************************************************************/
+
+#if !defined(MYSQLPP_PROBER_H)
+#define MYSQLPP_PROBER_H
+
+#include "common.h"
+
+#include "mythread.h"
+
+namespace mysqlpp {
+
+#if !defined(DOXYGEN_IGNORE)
+// Make Doxygen ignore this
+class MYSQLPP_EXPORT Connection;
+class MYSQLPP_EXPORT ConnectionPool;
+#endif
+
+namespace internal {
+
+/// \brief Calls a function every so often on a thread of its own
+///
+/// BalancedConnectionPool and ReplicatedConnectionPool use this to
+/// check on their servers in the background.  The function runs once
+/// as soon as the thread starts, then after every interval, or sooner
+/// if wake() is called.  Where threads aren't supported, start() does
+/// nothing, and the owner has to call the function itself.
+///
+/// This is an implementation detail of those classes.
+
+class MYSQLPP_EXPORT Prober
+{
+public:
+	/// \brief Create the object, without starting a thread
+	///
+	/// \param f function to call
+	/// \param arg argument to pass it
+	/// \param interval seconds between calls; 0 means never start
+	Prober(Thread::Function f, void* arg, unsigned int interval);
+
+	/// \brief Destroy the object, first stopping the thread
+	~Prober() { stop(); }
+
+	/// \brief Get the number of seconds between calls
+	unsigned int interval() const { return interval_; }
+
+	/// \brief Returns true if the thread is running
+	bool running() const { return thread_.running(); }
+
+	/// \brief Start the thread, if it isn't running and there's an
+	/// interval to run it at
+	void start();
+
+	/// \brief Stop the thread, waiting for any call in progress to
+	/// finish first
+	///
+	/// Call this from the owner's dtor, before the state the function
+	/// uses goes away.
+	void stop();
+
+	/// \brief Have the thread make its next call now
+	void wake();
+
+private:
+	Prober(const Prober&);				// can't copy
+	Prober& operator =(const Prober&);	// can't assign
+
+	/// \brief Thread entry point
+	static void main(void* p);
+
+	Thread::Function fn_;
+	void* arg_;
+	const unsigned int interval_;
+	bool stopping_;				// thread should exit
+	bool woken_;				// wake() called since the last call
+	Monitor monitor_;
+	Thread thread_;
+};
+
+/// \brief Run a check on a connection borrowed from a pool
+///
+/// Grabs a connection, waiting no more than a second for one, and
+/// calls \c check(conn, arg) on it.  If that returns true, the
+/// connection goes back to the pool.  If it returns false or throws,
+/// the connection is taken to be dead, and is removed from the pool.
+///
+/// \param pool pool to borrow the connection from
+/// \param check the check to run
+/// \param arg argument to pass it
+/// \param ok receives true if the check returned true, else false
+///
+/// \retval false if the pool is too busy to lend us a connection, so
+/// the caller can keep what it knew already; \c ok is left alone then
+MYSQLPP_EXPORT bool probe_pool(ConnectionPool& pool,
+		bool (*check)(Connection& conn, void* arg), void* arg, bool& ok);
+
+} // end namespace internal
+
+} // end namespace mysqlpp
+
+#endif // !defined(MYSQLPP_PROBER_H)
@@ -0,0 +1,262 @@
+/// \file qtemplate.h
+/// \brief Declares the QueryTemplate class template, a template query
+/// string whose parameter count is known at compile time.
+///
+/// This is used by the variadic Query::execute(), store(), use() and
+/// str() overloads.  They need a C++11 compiler; with older compilers,
+/// this header declares only the internal class behind them.
+
+/***********************************************************************
+ Copyright (c) 2015 by Educational Technology Resources, Inc.  Others
+ may also hold copyrights on code in this file.  See the CREDITS.txt
+ file in the top directory of the distribution for details.
+
+ This file is part of MySQL++.
+
+ MySQL++ is free software; you can redistribute it and/or modify it
+ under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 2.1 of the License, or
+ (at your option) any later version.
+
+ MySQL++ is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with MySQL++; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+ USA
+***********************************************************************/
+
+#if !defined(MYSQLPP_QTEMPLATE_H)
+#define MYSQLPP_QTEMPLATE_H
+
+#include "common.h"
+
+#include "null.h"
+#include "stadapter.h"
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+#if __cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1900)
+#	define MYSQLPP_HAVE_VARIADIC_QUERIES
+#endif
+
+namespace mysqlpp {
+
+namespace internal {
+	/// \brief Reference to one argument of a variadic Query call
+	///
+	/// \internal C++ strings, integers and nulls are passed to Query's
+	/// template renderer as they are, so they can be written straight
+	/// into the query.  Anything else is converted to SQLTypeAdapter,
+	/// and formatted just as the SQLQueryParms-based overloads would.
+	/// This needs nothing from C++11, so it's defined whatever standard
+	/// the library is built with, as are the Query members taking it.
+	class TemplateArg
+	{
+	public:
+		/// \brief Kind of value referred to
+		enum Kind { none, null, string, signed_int, unsigned_int, other };
+
+		/// \brief Argument placeholder, for padding arrays
+		TemplateArg() : kind_(none) { }
+
+		/// \brief Refer to a C string
+		TemplateArg(const char* s) :
+		kind_(s ? string : null)
+		{
+			str_.data = s;
+			str_.length = s ? strlen(s) : 0;
+		}
+
+		/// \brief Refer to a C++ string
+		TemplateArg(const std::string& s) :
+		kind_(string)
+		{
+			str_.data = s.data();
+			str_.length = s.length();
+		}
+
+		/// \brief Refer to SQL null
+		TemplateArg(const null_type&) : kind_(null) { }
+
+		/// \brief Refer to an integer
+		TemplateArg(short i) : kind_(signed_int) { i_ = i; }
+		TemplateArg(int i) : kind_(signed_int) { i_ = i; }
+		TemplateArg(long i) : kind_(signed_int) { i_ = i; }
+		TemplateArg(unsigned short i) : kind_(unsigned_int) { u_ = i; }
+		TemplateArg(unsigned int i) : kind_(unsigned_int) { u_ = i; }
+		TemplateArg(unsigned long i) : kind_(unsigned_int) { u_ = i; }
+#if !defined(MYSQLPP_NO_LONG_LONGS)
+		TemplateArg(longlong i) : kind_(signed_int) { i_ = i; }
+		TemplateArg(ulonglong i) : kind_(unsigned_int) { u_ = i; }
+#endif
+
+		/// \brief Refer to any other value SQLTypeAdapter accepts
+		template <class T>
+		TemplateArg(const T& v) :
+		kind_(other)
+		{
+			other_.value = &v;
+			other_.adapt = &adapt<T>;
+		}
+
+		/// \brief Get the kind of value referred to
+		Kind kind() const { return kind_; }
+
+		/// \brief Get the string referred to
+		const char* data() const { return str_.data; }
+
+		/// \brief Get the length of the string referred to
+		size_t length() const { return str_.length; }
+
+		/// \brief Get the signed integer referred to
+		longlong signed_value() const { return i_; }
+
+		/// \brief Get the unsigned integer referred to
+		ulonglong unsigned_value() const { return u_; }
+
+		/// \brief Convert any other kind of value to SQLTypeAdapter
+		SQLTypeAdapter adapted() const
+				{ return other_.adapt(other_.value); }
+
+	private:
+		template <class T>
+		static SQLTypeAdapter adapt(const void* p)
+				{ return SQLTypeAdapter(*static_cast<const T*>(p)); }
+
+		Kind kind_;
+		union {
+			struct {
+				const char* data;
+				size_t length;
+			} str_;
+			longlong i_;
+			ulonglong u_;
+			struct {
+				const void* value;
+				SQLTypeAdapter (*adapt)(const void*);
+			} other_;
+		};
+	};
+
+
+#if defined(MYSQLPP_HAVE_VARIADIC_QUERIES)
+	// The helpers below count a template's parameters the way
+	// Query::parse() finds them: a % followed by up to 3 digits, unless
+	// the % is the second half of a %% pair.  They're written as C++11
+	// constexpr functions, so one expression each, and split the string
+	// in halves rather than walking it, so long templates don't run into
+	// the compiler's constexpr recursion limit.
+
+	/// \brief Number of consecutive % characters ending at s[i]
+	constexpr size_t percent_run(const char* s, size_t i)
+	{
+		return s[i] != '%' ? 0 : i == 0 ? 1 : 1 + percent_run(s, i - 1);
+	}
+
+	/// \brief Is c a decimal digit?
+	constexpr bool is_digit(char c)
+	{
+		return c >= '0' && c <= '9';
+	}
+
+	/// \brief Value of the parameter number starting at s[i]
+	constexpr size_t param_number(const char* s, size_t i, size_t n,
+			int left)
+	{
+		return left && is_digit(s[i]) ?
+				param_number(s, i + 1, n * 10 + (s[i] - '0'), left - 1) :
+				n;
+	}
+
+	/// \brief Number of parameters needed by a parameter declaration
+	/// at s[i], or 0 if there isn't one
+	constexpr size_t param_at(const char* s, size_t i)
+	{
+		return is_digit(s[i + 1]) && percent_run(s, i) % 2 == 1 ?
+				param_number(s, i + 1, 0, 3) + 1 : 0;
+	}
+
+	/// \brief Larger of a and b
+	constexpr size_t larger(size_t a, size_t b)
+	{
+		return a > b ? a : b;
+	}
+
+	/// \brief Number of parameters needed by declarations starting in
+	/// s[lo] through s[hi - 1]
+	constexpr size_t param_count(const char* s, size_t lo, size_t hi)
+	{
+		return hi - lo == 1 ? param_at(s, lo) :
+				larger(param_count(s, lo, lo + (hi - lo) / 2),
+						param_count(s, lo + (hi - lo) / 2, hi));
+	}
+
+	/// \brief Number of parameters a template query string needs:
+	/// one more than the highest parameter number in it
+	template <size_t L>
+	constexpr size_t template_param_count(const char (&s)[L])
+	{
+		return L > 1 ? param_count(s, 0, L - 1) : 0;
+	}
+#endif // defined(MYSQLPP_HAVE_VARIADIC_QUERIES)
+} // end namespace mysqlpp::internal
+
+
+#if defined(MYSQLPP_HAVE_VARIADIC_QUERIES)
+/// \brief A template query string whose parameter count is known
+/// when your program is compiled
+///
+/// Create these with MYSQLPP_QUERY_TEMPLATE(), then pass them along
+/// with the parameter values to Query::execute(), store(), use() or
+/// str().  The placeholders are the same as for a template query built
+/// with Query::parse(), but passing the wrong number of values is a
+/// compile-time error instead of a BadParamCount exception, and there's
+/// no SQLQueryParms to build: each value is formatted straight into the
+/// query.
+///
+/// \code
+/// SimpleResult res = query.execute(
+///         MYSQLPP_QUERY_TEMPLATE("UPDATE stock SET num = %0 "
+///                 "WHERE item = %1q"), 42, item);
+/// \endcode
+///
+/// \param N number of parameters the template needs
+
+template <size_t N>
+class QueryTemplate
+{
+public:
+	/// \brief Number of parameters the template needs
+	static const size_t param_count = N;
+
+	/// \brief Wrap a template string
+	///
+	/// Don't call this directly; MYSQLPP_QUERY_TEMPLATE() works out
+	/// N for you.  The string must outlive this object.
+	constexpr explicit QueryTemplate(const char* s) : str_(s) { }
+
+	/// \brief Get the template string
+	constexpr const char* str() const { return str_; }
+
+private:
+	const char* str_;
+};
+#endif // defined(MYSQLPP_HAVE_VARIADIC_QUERIES)
+
+} // end namespace mysqlpp
+
+#if defined(MYSQLPP_HAVE_VARIADIC_QUERIES)
+/// \brief Create a QueryTemplate from a string literal or a constexpr
+/// char array
+#define MYSQLPP_QUERY_TEMPLATE(s) \
+		mysqlpp::QueryTemplate< \
+				mysqlpp::internal::template_param_count(s)>(s)
+#endif // defined(MYSQLPP_HAVE_VARIADIC_QUERIES)
+
+#endif // !defined(MYSQLPP_QTEMPLATE_H)
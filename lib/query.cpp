@@ -29,6 +29,19 @@
 #include "autoflag.h"
 #include "dbdriver.h"
 #include "connection.h"
+#include "prepared.h"
+#include "querybatch.h"
+
+#if defined(MYSQLPP_MYSQL_HEADERS_BURIED)
+#	include <mysql/errmsg.h>
+#else
+#	include <errmsg.h>
+#endif
+
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cstring>
 
 namespace mysqlpp {
 
@@ -106,6 +119,46 @@ Query::error() const
 }
 
 
+bool
+Query::build_folded(const std::vector<SQLQueryParms>& sets,
+		size_t head, size_t tail, size_t max_size,
+		internal::StatementSink& sink)
+{
+	const std::string& last = parse_elems_.back().before;
+	const std::string suffix(last, last.size() - tail);
+	std::string sql;
+
+	for (size_t i = 0; i <= sets.size(); ++i) {
+		std::string full;
+		if (i < sets.size()) {
+			SQLQueryParms p(sets[i]);
+			full = str(p);
+			if (sql.empty()) {
+				sql.assign(full, 0, full.size() - tail);
+				continue;
+			}
+			else if (sql.size() + 1 + (full.size() - head) <= max_size) {
+				// Row fits, so add its tuple to the statement
+				sql += ',';
+				sql.append(full, head, full.size() - head - tail);
+				continue;
+			}
+		}
+
+		// Out of room or out of rows, so send what we have
+		if (!sink.send(sql + suffix)) {
+			return false;
+		}
+
+		if (!full.empty()) {
+			sql.assign(full, 0, full.size() - tail);
+		}
+	}
+
+	return true;
+}
+
+
 size_t
 Query::escape_string(std::string* ps, const char* original,
 		size_t length) const
@@ -138,6 +191,19 @@ Query::escape_string(char* escaped, const char* original,
 }
 
 
+size_t
+Query::write_escaped(const char* original, size_t length)
+{
+	if (conn_ && *conn_) {
+		return conn_->driver()->escape_string(*this, original, length);
+	}
+	else {
+		// See escape_string() above
+		return DBDriver::escape_string_no_conn(*this, original, length);
+	}
+}
+
+
 bool
 Query::exec(const std::string& str)
 {
@@ -219,6 +285,289 @@ Query::execute(const char* str, size_t len)
 }
 
 
+AsyncResult
+Query::execute_async(AsyncResult::Callback cb, void* userdata)
+{
+	AutoFlag<> af(template_defaults.processing_);
+	AsyncResult ar = AsyncResult::start(conn_, str(template_defaults),
+			false, throw_exceptions(), cb, userdata);
+	if (parse_elems_.size() == 0) {
+		// Not a template query, so auto-reset
+		reset();
+	}
+	return ar;
+}
+
+
+//// scan_sql //////////////////////////////////////////////////////////
+// Scan SQL text from pos, tracking string literal quoting and, if depth
+// isn't null, parenthesis nesting; both carry over between calls, so a
+// statement can be scanned a piece at a time.  Returns the position of
+// the parenthesis bringing *depth to 0, or npos if none does.
+
+static size_t
+scan_sql(const std::string& s, size_t pos, char& quote, int* depth)
+{
+	for (; pos < s.size(); ++pos) {
+		char c = s[pos];
+		if (quote) {
+			if (c == '\\') {
+				++pos;				// skip escaped character
+			}
+			else if (c == quote) {
+				quote = 0;
+			}
+		}
+		else if ((c == '\'') || (c == '"') || (c == '`')) {
+			quote = c;
+		}
+		else if (depth && (c == '(')) {
+			++*depth;
+		}
+		else if (depth && (c == ')') && (--*depth == 0)) {
+			return pos;
+		}
+	}
+
+	return std::string::npos;
+}
+
+
+SimpleResult
+Query::execute_many(const std::vector<SQLQueryParms>& sets)
+{
+	if (parse_elems_.empty()) {
+		copacetic_ = false;
+		if (throw_exceptions()) {
+			throw BadParamCount("execute_many() needs a template query");
+		}
+		return SimpleResult();
+	}
+	else if (sets.empty()) {
+		copacetic_ = true;
+		return SimpleResult(conn_, 0, 0, "");
+	}
+
+	size_t head, tail;
+	SimpleResult result;
+	if (find_values_tuple(head, tail)) {
+		return execute_many_folded(sets, head, tail);
+	}
+	else if (conn_->driver()->multi_statements()) {
+		return execute_many_batched(sets);
+	}
+	else if (execute_many_prepared(sets, result)) {
+		return result;
+	}
+
+	// Nothing cleverer worked, so do it the long way
+	ulonglong rows = 0;
+	for (size_t i = 0; i < sets.size(); ++i) {
+		SQLQueryParms p(sets[i]);
+		if (!(result = execute(p))) {
+			return result;
+		}
+		rows += result.rows();
+	}
+
+	return SimpleResult(conn_, result.insert_id(), rows, result.info());
+}
+
+
+//// run_batch /////////////////////////////////////////////////////////
+// Send a batch for execute_many_batched(), adding up its rows affected
+// and keeping the result of its last statement.
+
+static bool
+run_batch(QueryBatch& batch, ulonglong& rows, SimpleResult& last)
+{
+	if (!batch.execute()) {
+		return false;
+	}
+
+	for (size_t i = 0; i < batch.size(); ++i) {
+		rows += batch.result(i).simple.rows();
+	}
+	last = batch.result(batch.size() - 1).simple;
+	batch.clear();
+	return true;
+}
+
+
+SimpleResult
+Query::execute_many_batched(const std::vector<SQLQueryParms>& sets)
+{
+	const size_t max_size = internal::max_statement_size(conn_);
+	QueryBatch batch(conn_, throw_exceptions());
+	size_t batch_size = 0;
+	ulonglong rows = 0;
+	SimpleResult last;
+
+	for (size_t i = 0; i < sets.size(); ++i) {
+		SQLQueryParms p(sets[i]);
+		std::string sql(str(p));
+
+		// Statements are joined with ";\n" when the batch goes out
+		if (batch.size() && (batch_size + 2 + sql.size() > max_size)) {
+			if (!run_batch(batch, rows, last)) {
+				copacetic_ = false;
+				return SimpleResult();
+			}
+			batch_size = 0;
+		}
+
+		batch_size += sql.size() + (batch.size() ? 2 : 0);
+		batch.add(sql);
+	}
+
+	if (!run_batch(batch, rows, last)) {
+		copacetic_ = false;
+		return SimpleResult();
+	}
+
+	copacetic_ = true;
+	return SimpleResult(conn_, last.insert_id(), rows, last.info());
+}
+
+
+SimpleResult
+Query::execute_many_folded(const std::vector<SQLQueryParms>& sets,
+		size_t head, size_t tail)
+{
+	TallySink sink(*this);
+	if (!build_folded(sets, head, tail,
+			internal::max_statement_size(conn_), sink)) {
+		return SimpleResult();
+	}
+
+	return SimpleResult(conn_, sink.id, sink.rows, sink.info);
+}
+
+
+bool
+Query::execute_many_prepared(const std::vector<SQLQueryParms>& sets,
+		SimpleResult& result)
+{
+	// Turn the template into a statement with ? placeholders, noting
+	// which parameter each stands for.  Only quoted parameters stand
+	// for values; the others may be SQL fragments, like column names.
+	std::string sql;
+	std::vector<int> order;
+	char quote = 0;
+	for (size_t i = 0; i < parse_elems_.size(); ++i) {
+		const SQLParseElement& pe = parse_elems_[i];
+		scan_sql(pe.before, 0, quote, 0);
+		sql += pe.before;
+		if (pe.num >= 0) {
+			if (quote || ((pe.option != 'q') && (pe.option != 'Q'))) {
+				return false;
+			}
+			sql += '?';
+			order.push_back(pe.num);
+		}
+	}
+
+	PreparedQuery pq(conn_);
+	pq.disable_exceptions();
+	if (!pq.prepare(sql)) {
+		return false;
+	}
+	if (throw_exceptions()) {
+		pq.enable_exceptions();
+	}
+
+	ulonglong rows = 0;
+	for (size_t i = 0; i < sets.size(); ++i) {
+		SQLQueryParms p;
+		for (size_t j = 0; j < order.size(); ++j) {
+			size_t num = order[j];
+			if (num < sets[i].size()) {
+				p << sets[i][num];
+			}
+			else if (num < template_defaults.size()) {
+				p << template_defaults[num];
+			}
+			else {
+				throw BadParamCount(
+						"Not enough parameters to fill the template.");
+			}
+		}
+
+		if (!(result = pq.execute(p))) {
+			copacetic_ = false;
+			return true;
+		}
+		rows += result.rows();
+	}
+
+	copacetic_ = true;
+	result = SimpleResult(conn_, result.insert_id(), rows, result.info());
+	return true;
+}
+
+
+SimpleResult
+Query::execute_template(const char* tmpl,
+		const internal::TemplateArg* args)
+{
+	render_template(tmpl, args);
+	std::string sql(sbuffer_.str());
+	AutoFlag<> af(template_defaults.processing_);
+	return execute(sql.data(), sql.length());
+}
+
+
+bool
+Query::find_values_tuple(size_t& head, size_t& tail) const
+{
+	// Only INSERT and REPLACE templates qualify
+	const std::string& first = parse_elems_.front().before;
+	std::string upper(first);
+	for (size_t i = 0; i < upper.size(); ++i) {
+		upper[i] = static_cast<char>(toupper(upper[i]));
+	}
+	size_t start = upper.find_first_not_of(" \t\r\n");
+	if ((start == std::string::npos) ||
+			((upper.compare(start, 6, "INSERT") != 0) &&
+			 (upper.compare(start, 7, "REPLACE") != 0))) {
+		return false;
+	}
+
+	// The tuple starts with the parenthesis following the last VALUES
+	// ahead of the first parameter
+	size_t values = upper.rfind("VALUES");
+	if (values == std::string::npos) {
+		return false;
+	}
+	head = upper.find_first_not_of(" \t\r\n", values + 6);
+	if ((head == std::string::npos) || (upper[head] != '(')) {
+		return false;
+	}
+
+	// It must end in the text following the last parameter, and mustn't
+	// be followed by another tuple
+	char quote = 0;
+	int depth = 1;
+	for (size_t i = 0; i < parse_elems_.size(); ++i) {
+		const std::string& text = parse_elems_[i].before;
+		size_t end = scan_sql(text, i ? 0 : head + 1, quote, &depth);
+		if (end != std::string::npos) {
+			if (i + 1 < parse_elems_.size()) {
+				return false;
+			}
+			size_t next = text.find_first_not_of(" \t\r\n", end + 1);
+			if ((next != std::string::npos) && (text[next] == ',')) {
+				return false;
+			}
+			tail = text.size() - (end + 1);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
 std::string
 Query::info()
 {
@@ -233,6 +582,127 @@ Query::insert_id()
 }
 
 
+//// LoadDataState ///////////////////////////////////////////////////
+// Per-statement state for the LOAD DATA LOCAL INFILE callbacks below.
+// Rows are rendered into out a buffer's worth at a time, then handed
+// to the C API from pending.
+
+namespace {
+	struct LoadDataState
+	{
+		LoadDataState(internal::InfileSource& s, Connection* c) :
+		src(s),
+		out(c),
+		pos(0)
+		{
+			out << std::setprecision(16);
+		}
+
+		internal::InfileSource& src;
+		SQLStream out;
+		std::string pending;
+		size_t pos;
+		std::string error;
+	};
+
+	// Puts the C API's default LOAD DATA LOCAL behavior back on scope
+	// exit, so an exception can't leave our callbacks installed with
+	// a dangling state pointer.
+	class LocalInfileGuard
+	{
+	public:
+		explicit LocalInfileGuard(DBDriver* d) : driver_(d) { }
+		~LocalInfileGuard() { driver_->set_local_infile_default(); }
+
+	private:
+		DBDriver* driver_;
+	};
+}
+
+
+//// load_data_* ///////////////////////////////////////////////////////
+// Callbacks for mysql_set_local_infile_handler().  They must not let
+// exceptions escape into the C API, so those are caught, saved, and
+// reported as a read error.
+
+extern "C" {
+	static int
+	load_data_init(void** ptr, const char*, void* userdata)
+	{
+		*ptr = userdata;
+		return 0;
+	}
+
+	static int
+	load_data_read(void* ptr, char* buf, unsigned int len)
+	{
+		LoadDataState* ps = static_cast<LoadDataState*>(ptr);
+		try {
+			if (ps->pos == ps->pending.size()) {
+				ps->out.str("");
+				while ((size_t(ps->out.tellp()) < len) &&
+						ps->src.next(ps->out)) {
+					// keep going until the C API's buffer can be filled
+				}
+				ps->pending = ps->out.str();
+				ps->pos = 0;
+			}
+
+			size_t n = std::min(size_t(len), ps->pending.size() - ps->pos);
+			memcpy(buf, ps->pending.data() + ps->pos, n);
+			ps->pos += n;
+			return int(n);
+		}
+		catch (const std::exception& e) {
+			ps->error = e.what();
+		}
+		catch (...) {
+			ps->error = "unknown exception while producing rows";
+		}
+		return -1;
+	}
+
+	static void
+	load_data_end(void*)
+	{
+	}
+
+	static int
+	load_data_error(void* ptr, char* msg, unsigned int len)
+	{
+		LoadDataState* ps = static_cast<LoadDataState*>(ptr);
+		if (len > 0) {
+			size_t n = std::min(size_t(len) - 1, ps->error.size());
+			memcpy(msg, ps->error.data(), n);
+			msg[n] = '\0';
+		}
+		return CR_UNKNOWN_ERROR;
+	}
+}
+
+
+SimpleResult
+Query::load_data(internal::InfileSource& src, const char* table,
+		const std::string& fields)
+{
+	// Reuse the SSQLS value_list() rendering: strings are quoted with
+	// ' and backslash-escaped, and SQL nulls come out as a bare NULL,
+	// which is exactly what LOAD DATA expects given these options.
+	DBDriver* driver = conn_->driver();
+	MYSQLPP_QUERY_THISPTR << "LOAD DATA LOCAL INFILE 'mysqlpp' "
+			"INTO TABLE `" << table << "` CHARACTER SET " <<
+			driver->character_set_name() << " FIELDS TERMINATED BY ',' "
+			"OPTIONALLY ENCLOSED BY '\\'' ESCAPED BY '\\\\' "
+			"LINES TERMINATED BY '\\n' (" << fields << ')';
+
+	LoadDataState state(src, conn_);
+	LocalInfileGuard guard(driver);
+	driver->set_local_infile_handler(load_data_init, load_data_read,
+			load_data_end, load_data_error, &state);
+	return execute();
+}
+
+
 bool
 Query::more_results()
 {
@@ -374,11 +844,11 @@ Query::pprepare(char option, SQLTypeAdapter& S, bool replace)
 		std::string temp(S.quote_q() ? "'" : "", S.quote_q() ? 1 : 0);
 
 		if (S.escape_q()) {
-			char *escaped = new char[S.size() * 2 + 1];
-			size_t len = conn_->driver()->escape_string(escaped,
-					S.data(), static_cast<unsigned long>(S.size()));
-			temp.append(escaped, len);
-			delete[] escaped;
+			// Escape straight into temp, after the opening quote
+			size_t start = temp.length();
+			temp.resize(start + S.size() * 2 + 1);
+			temp.resize(start + escape_string(&temp[start],
+					S.data(), S.size()));
 		}
 		else {
 			temp.append(S.data(), S.length());
@@ -464,6 +934,50 @@ Query::proc(SQLQueryParms& p)
 }
 
 
+void
+Query::render_template(const char* tmpl, const internal::TemplateArg* args)
+{
+	// Same syntax as parse() accepts, but we write each parameter as
+	// we come to it instead of saving the template's structure.
+	sbuffer_.str("");
+	const char* s = tmpl;
+	while (const char* pct = strchr(s, '%')) {
+		write(s, pct - s);
+		s = pct + 1;
+		if (*s == '%') {
+			// Doubled percent sign, so insert literal percent sign
+			put(*s++);
+		}
+		else if (isdigit(*s)) {
+			size_t n = 0;
+			for (int i = 0; (i < 3) && isdigit(*s); ++i) {
+				n = n * 10 + (*s++ - '0');
+			}
+
+			char option = ' ';
+			if ((*s == 'q') || (*s == 'Q')) {
+				option = *s++;
+			}
+
+			if (*s == ':') {
+				// Skip parameter name; it's just documentation here
+				for (++s; isalnum(*s) || (*s == '_'); ++s) ;
+				if (*s == ':') {
+					++s;
+				}
+			}
+
+			write_template_arg(args[n], option);
+		}
+		else {
+			// Lone percent sign, so insert it literally, as parse() does
+			put('%');
+		}
+	}
+	write(s, strlen(s));
+}
+
+
 void
 Query::reset()
 {
@@ -565,6 +1079,20 @@ Query::store(const char* str, size_t len)
 }
 
 
+AsyncResult
+Query::store_async(AsyncResult::Callback cb, void* userdata)
+{
+	AutoFlag<> af(template_defaults.processing_);
+	AsyncResult ar = AsyncResult::start(conn_, str(template_defaults),
+			true, throw_exceptions(), cb, userdata);
+	if (parse_elems_.size() == 0) {
+		// Not a template query, so auto-reset
+		reset();
+	}
+	return ar;
+}
+
+
 StoreQueryResult
 Query::store_next()
 {
@@ -610,6 +1138,17 @@ Query::store_next()
 }
 
 
+StoreQueryResult
+Query::store_template(const char* tmpl,
+		const internal::TemplateArg* args)
+{
+	render_template(tmpl, args);
+	std::string sql(sbuffer_.str());
+	AutoFlag<> af(template_defaults.processing_);
+	return store(sql.data(), sql.length());
+}
+
+
 std::string
 Query::str(SQLQueryParms& p)
 {
@@ -699,5 +1238,272 @@ Query::use(const char* str, size_t len)
 }
 
 
+UseQueryResult
+Query::use_template(const char* tmpl, const internal::TemplateArg* args)
+{
+	render_template(tmpl, args);
+	std::string sql(sbuffer_.str());
+	AutoFlag<> af(template_defaults.processing_);
+	return use(sql.data(), sql.length());
+}
+
+
+void
+Query::write_template_arg(const internal::TemplateArg& arg, char option)
+{
+	switch (arg.kind()) {
+		case internal::TemplateArg::null:
+			write("NULL", 4);
+			break;
+
+		case internal::TemplateArg::string:
+			// Same treatment pprepare() gives std::string parameters
+			if (option == 'q') {
+				put('\'');
+				write_escaped(arg.data(), arg.length());
+				put('\'');
+			}
+			else if (option == 'Q') {
+				put('\'');
+				write(arg.data(), arg.length());
+				put('\'');
+			}
+			else {
+				write(arg.data(), arg.length());
+			}
+			break;
+
+		case internal::TemplateArg::signed_int:
+		case internal::TemplateArg::unsigned_int: {
+			// Integers are never quoted, so option doesn't matter.
+			// Format by hand to stay clear of any stream flags the
+			// user may have set on us.
+			bool neg = (arg.kind() == internal::TemplateArg::signed_int) &&
+					(arg.signed_value() < 0);
+			ulonglong u = neg ? 0 - ulonglong(arg.signed_value()) :
+					arg.unsigned_value();
+			char buf[24];
+			char* p = buf + sizeof(buf);
+			do {
+				*--p = char('0' + u % 10);
+			}
+			while (u /= 10);
+			if (neg) {
+				*--p = '-';
+			}
+			write(p, buf + sizeof(buf) - p);
+			break;
+		}
+
+		case internal::TemplateArg::other: {
+			SQLTypeAdapter sta(arg.adapted());
+			if (sta.is_null()) {
+				write("NULL", 4);
+			}
+			else {
+				SQLTypeAdapter* ss = pprepare(option, sta, false);
+				MYSQLPP_QUERY_THISPTR << *ss;
+				if (ss != &sta) {
+					delete ss;
+				}
+			}
+			break;
+		}
+
+		case internal::TemplateArg::none:
+			break;
+	}
+}
+
+
+namespace internal {
+
+//// max_statement_size ////////////////////////////////////////////////
+// Asks the server how big a packet it accepts.  A query's packet holds
+// a one-byte command code ahead of the SQL, so that comes off the top.
+// If the server won't say, assume the oldest servers' 1 MB default.
+
+int
+max_statement_size(Connection* conn)
+{
+	ulonglong packet = 1024 * 1024;
+	StoreQueryResult res = conn->query("SELECT @@max_allowed_packet").store();
+	if (res && (res.num_rows() > 0) && !res[0][0].is_null()) {
+		packet = res[0][0];
+	}
+
+	return int(std::min<ulonglong>(packet - 1, INT_MAX));
+}
+
+
+//// split_field_list ////////////////////////////////////////////////
+// Splits "`a`,`b`,..." on the commas between the backquoted names
+
+std::vector<std::string>
+split_field_list(const std::string& field_list)
+{
+	std::vector<std::string> names;
+	bool in_name = false;
+	std::string name;
+	for (size_t i = 0; i < field_list.size(); ++i) {
+		char c = field_list[i];
+		if (c == '`') {
+			in_name = !in_name;
+		}
+		else if ((c == ',') && !in_name) {
+			names.push_back(name);
+			name.clear();
+			continue;
+		}
+		name += c;
+	}
+	if (!name.empty()) {
+		names.push_back(name);
+	}
+
+	return names;
+}
+
+
+//// upsert_clause /////////////////////////////////////////////////////
+// Builds " ON DUPLICATE KEY UPDATE `a`=VALUES(`a`),..." for the given
+// columns, or for all the SSQLS's fields if none are given.
+
+std::string
+upsert_clause(const std::string& field_list,
+		const std::vector<std::string>& update_fields)
+{
+	std::vector<std::string> quoted;
+	if (update_fields.empty()) {
+		quoted = split_field_list(field_list);
+	}
+	else {
+		for (size_t i = 0; i < update_fields.size(); ++i) {
+			std::string name("`");
+			for (size_t j = 0; j < update_fields[i].size(); ++j) {
+				if (update_fields[i][j] == '`') {
+					name += '`';		// escape by doubling
+				}
+				name += update_fields[i][j];
+			}
+			quoted.push_back(name + '`');
+		}
+	}
+
+	std::string clause(" ON DUPLICATE KEY UPDATE ");
+	for (size_t i = 0; i < quoted.size(); ++i) {
+		if (i > 0) {
+			clause += ',';
+		}
+		clause += quoted[i] + "=VALUES(" + quoted[i] + ')';
+	}
+
+	return clause;
+}
+
+
+// Pieces of the statement CaseUpdateBuilder builds.  Its size
+// bookkeeping depends on these lengths, so keep them in sync with str().
+static const char cub_update[] = "UPDATE `";
+static const char cub_set[] = "` SET ";
+static const char cub_case[] = " = CASE ";
+static const char cub_when[] = " WHEN ";
+static const char cub_then[] = " THEN ";
+static const char cub_end[] = " END";
+static const char cub_where[] = " WHERE ";
+static const char cub_in[] = " IN (";
+
+#define CUB_LEN(s) (sizeof(s) - 1)
+
+
+CaseUpdateBuilder::CaseUpdateBuilder(const std::string& table,
+		const std::string& key, const std::vector<std::string>& columns) :
+table_(table),
+key_(key),
+columns_(columns)
+{
+	base_size_ = CUB_LEN(cub_update) + table_.size() + CUB_LEN(cub_set) +
+			CUB_LEN(cub_where) + key_.size() + CUB_LEN(cub_in) + 1;
+	for (size_t i = 0; i < columns_.size(); ++i) {
+		base_size_ += (i > 0 ? 1 : 0) + columns_[i].size() +
+				CUB_LEN(cub_case) + key_.size() + CUB_LEN(cub_end);
+	}
+	size_ = base_size_;
+}
+
+
+void
+CaseUpdateBuilder::add(const std::string& key,
+		const std::vector<std::string>& values)
+{
+	size_ = size_with(key, values);
+	keys_.push_back(key);
+	values_.push_back(values);
+}
+
+
+void
+CaseUpdateBuilder::clear()
+{
+	keys_.clear();
+	values_.clear();
+	size_ = base_size_;
+}
+
+
+size_t
+CaseUpdateBuilder::size_with(const std::string& key,
+		const std::vector<std::string>& values) const
+{
+	size_t size = size_ + (empty() ? 0 : 1) + key.size();
+	for (size_t i = 0; i < values.size(); ++i) {
+		size += CUB_LEN(cub_when) + key.size() + CUB_LEN(cub_then) +
+				values[i].size();
+	}
+	return size;
+}
+
+
+std::string
+CaseUpdateBuilder::str() const
+{
+	std::string sql;
+	sql.reserve(size_);
+	sql += cub_update;
+	sql += table_;
+	sql += cub_set;
+	for (size_t i = 0; i < columns_.size(); ++i) {
+		if (i > 0) {
+			sql += ',';
+		}
+		sql += columns_[i];
+		sql += cub_case;
+		sql += key_;
+		for (size_t j = 0; j < keys_.size(); ++j) {
+			sql += cub_when;
+			sql += keys_[j];
+			sql += cub_then;
+			sql += values_[j][i];
+		}
+		sql += cub_end;
+	}
+
+	sql += cub_where;
+	sql += key_;
+	sql += cub_in;
+	for (size_t j = 0; j < keys_.size(); ++j) {
+		if (j > 0) {
+			sql += ',';
+		}
+		sql += keys_[j];
+	}
+	sql += ')';
+
+	return sql;
+}
+
+} // end namespace mysqlpp::internal
+
+
 } // end namespace mysqlpp
 
@@ -30,9 +30,11 @@
 
 #include "common.h"
 
+#include "asyncresult.h"
 #include "exceptions.h"
 #include "noexceptions.h"
 #include "qparms.h"
+#include "qtemplate.h"
 #include "querydef.h"
 #include "result.h"
 #include "row.h"
@@ -40,8 +42,10 @@
 #include "stadapter.h"
 #include "transaction.h"
 
+#include <algorithm>
 #include <deque>
 #include <iomanip>
+#include <iterator>
 #include <list>
 #include <map>
 #include <set>
@@ -60,9 +64,151 @@ namespace mysqlpp {
 #if !defined(DOXYGEN_IGNORE)
 // Make Doxygen ignore this
 class MYSQLPP_EXPORT Connection;
+class MYSQLPP_EXPORT ParallelInsert;
+class MYSQLPP_EXPORT ParallelSelect;
 class MYSQLPP_EXPORT Transaction;
+template <class T, class InsertPolicy> class InsertStream;
 #endif
 
+namespace internal {
+	// Only test/bulkquery.cpp defines this, to reach Query's private
+	// statement builders
+	class QueryTestAccess;
+
+	/// \brief Abstract source of rows for Query::load_data()
+	///
+	/// \internal Lets the non-template LOAD DATA machinery pull rows
+	/// from any kind of SSQLS range one at a time.
+	class MYSQLPP_EXPORT InfileSource
+	{
+	public:
+		virtual ~InfileSource() { }
+
+		/// \brief Render the next row onto os, returning false if
+		/// there are no more rows
+		virtual bool next(std::ostream& os) = 0;
+	};
+
+	/// \brief Find the longest statement the server will accept on
+	/// the given connection, per its \c max_allowed_packet setting
+	MYSQLPP_EXPORT int max_statement_size(Connection* conn);
+
+	/// \brief Build the \c ON \c DUPLICATE \c KEY \c UPDATE clause
+	/// for an upsert
+	///
+	/// \param field_list the SSQLS's rendered field_list(), used when
+	///     \c update_fields is empty
+	/// \param update_fields plain names of the columns to update
+	MYSQLPP_EXPORT std::string upsert_clause(const std::string& field_list,
+			const std::vector<std::string>& update_fields);
+
+	/// \brief Split an SSQLS's rendered field_list() into the
+	/// backquoted column names
+	MYSQLPP_EXPORT std::vector<std::string> split_field_list(
+			const std::string& field_list);
+
+	/// \brief Builds an \c UPDATE statement setting the same columns in
+	/// many rows, using \c CASE to pick each row's new values by key
+	///
+	/// Column names and values must be ready to paste into SQL, that
+	/// is, quoted and escaped.  size() and size_with() let callers
+	/// decide when to send the statement without building it.
+	class MYSQLPP_EXPORT CaseUpdateBuilder
+	{
+	public:
+		CaseUpdateBuilder(const std::string& table, const std::string& key,
+				const std::vector<std::string>& columns);
+
+		/// \brief Add a row, given its key and its new values for each
+		/// of the columns
+		void add(const std::string& key,
+				const std::vector<std::string>& values);
+
+		/// \brief Remove all rows
+		void clear();
+
+		/// \brief Returns true if no rows have been added
+		bool empty() const { return keys_.empty(); }
+
+		/// \brief Get the length of the statement str() would build
+		size_t size() const { return size_; }
+
+		/// \brief Get the length of the statement after adding a row
+		size_t size_with(const std::string& key,
+				const std::vector<std::string>& values) const;
+
+		/// \brief Build the statement
+		std::string str() const;
+
+	private:
+		std::string table_;
+		std::string key_;
+		std::vector<std::string> columns_;
+		std::vector<std::string> keys_;
+		std::vector<std::vector<std::string> > values_;
+		size_t base_size_;
+		size_t size_;
+	};
+
+	/// \brief Type-level boolean, for overload dispatch
+	template <bool B> struct bool_tag { };
+
+	/// \brief Detects insert policies that support speculative
+	/// appends; see MaxPacketInsertPolicy::fits()
+	template <class Policy>
+	class is_speculative_policy
+	{
+		typedef char yes;
+		typedef char (&no)[2];
+
+		template <class P>
+		static yes test(typename P::speculative_append*);
+		template <class P>
+		static no test(...);
+
+	public:
+		enum { value = sizeof(test<Policy>(0)) == sizeof(yes) };
+	};
+
+	/// \brief Receives each statement Query::insertfrom() and
+	/// replacefrom() build, for sending to the server
+	class MYSQLPP_EXPORT StatementSink
+	{
+	public:
+		virtual ~StatementSink() { }
+
+		/// \brief Send the statement, returning false on failure
+		virtual bool send(const std::string& sql) = 0;
+	};
+
+	/// \brief InfileSource walking a range of SSQLS objects
+	template <class Iter>
+	class SSQLSInfileSource : public InfileSource
+	{
+	public:
+		SSQLSInfileSource(Iter first, Iter last) :
+		it_(first),
+		last_(last)
+		{
+		}
+
+		bool next(std::ostream& os)
+		{
+			if (it_ == last_) {
+				return false;
+			}
+
+			os << it_->value_list() << '\n';
+			++it_;
+			return true;
+		}
+
+	private:
+		Iter it_;
+		Iter last_;
+	};
+} // end namespace mysqlpp::internal
+
 /// \brief A class for building and executing SQL queries.
 ///
 /// One does not generally create Query objects directly. Instead, call
@@ -191,6 +337,21 @@ public:
 	size_t escape_string(char* escaped, const char* original,
 			size_t length) const;
 
+	/// \brief Insert a SQL-escaped copy of a character buffer into
+	/// the query
+	///
+	/// \param original pointer to the character buffer to escape
+	/// \param length number of characters to escape
+	///
+	/// \retval number of characters inserted
+	///
+	/// This is what the escape and quote manipulators use.  It
+	/// escapes directly into the query string, without building the
+	/// escaped copy in a temporary first.
+	///
+	/// \see DBDriver::escape_string(std::ostream&, const char*, size_t)
+	size_t write_escaped(const char* original, size_t length);
+
 	/// \brief Get the last error number that was set.
 	///
 	/// This just delegates to Connection::errnum().  Query has nothing
@@ -381,6 +542,52 @@ public:
 	/// Executes the query immediately, and returns the results.
 	SimpleResult execute(const char* str, size_t len);
 
+	/// \brief Start executing the query without waiting for it to
+	/// finish
+	///
+	/// Like execute(), except that it returns right away, with a
+	/// handle you can use to get the outcome later.  Don't use this
+	/// object's connection for anything else until the query finishes.
+	/// See AsyncResult for details.
+	///
+	/// \param cb function to call when the query finishes, or 0
+	/// \param userdata passed to \c cb
+	AsyncResult execute_async(AsyncResult::Callback cb = 0,
+			void* userdata = 0);
+
+	/// \brief Execute a template query once for each of many sets of
+	/// parameters, in as few round trips as possible
+	///
+	/// This gives the same result as calling execute() with each
+	/// parameter set in turn, but how it gets there depends on the
+	/// template:
+	///
+	/// - A single-row \c INSERT or \c REPLACE, that is, one ending in
+	///   \c VALUES \c (...) plus optionally a clause with no parameters
+	///   in it such as \c ON \c DUPLICATE \c KEY \c UPDATE, is folded
+	///   into multi-row statements, each kept within the server's
+	///   \c max_allowed_packet.
+	///
+	/// - Other templates are sent as multi-statement batches if
+	///   MultiStatementsOption was set before connecting.
+	///
+	/// - Failing that, the template is turned into a prepared statement
+	///   with \c ? placeholders, so each set costs a round trip but
+	///   no parsing on the server.  If the server won't prepare it,
+	///   we fall back to plain execute() calls.
+	///
+	/// Parameters missing from a set come from template_defaults, as
+	/// with execute().
+	///
+	/// \param sets parameter sets, one per execution
+	///
+	/// \return SimpleResult giving the total rows affected, and the
+	/// insert ID and info from the last statement run.  If a statement
+	/// fails, throws BadQuery if exceptions are enabled; otherwise the
+	/// result tests as false, and an unknown number of the earlier sets
+	/// will have been applied.
+	SimpleResult execute_many(const std::vector<SQLQueryParms>& sets);
+
 	/// \brief Execute a query that can return rows, with access to
 	/// the rows in sequence
 	/// 
@@ -512,6 +719,15 @@ public:
 	/// from plain C strings and other useful data types implicitly.
 	StoreQueryResult store(const char* str, size_t len);
 
+	/// \brief Start executing a query that returns rows without waiting
+	/// for it to finish
+	///
+	/// Like store(), except that it returns right away, with a handle
+	/// you can get the rows from once the query finishes.  See
+	/// execute_async() and AsyncResult for details.
+	AsyncResult store_async(AsyncResult::Callback cb = 0,
+			void* userdata = 0);
+
 	/// \brief Execute a query, and call a functor for each returned row
 	///
 	/// This method wraps a use() query, calling the given functor for
@@ -970,6 +1186,44 @@ public:
 		storein_set(con, s);
 	}
 
+	/// \brief Fetch the rows matching a list of keys into an STL
+	/// container of SSQLS objects
+	///
+	/// This runs \c SELECT \c ... \c WHERE \c key \c IN \c (...)
+	/// queries, splitting the key list over as many of them as it
+	/// takes to keep each within the server's \c max_allowed_packet.
+	/// Keys are quoted and escaped as for any other query.  Matching
+	/// rows are added to \c con as with storein(), which see for the
+	/// supported container types; \c con isn't cleared first.
+	///
+	/// To spread the queries over several connections at once, see
+	/// ParallelSelect.
+	///
+	/// \param keys STL container of key values; anything SQLTypeAdapter
+	///     accepts will do
+	/// \param con container to add the matching rows to
+	/// \param column name of the key column; defaults to the SSQLS's
+	///     first field
+	/// \param max_size longest statement to send; if 0, we ask the
+	///     server
+	template <class Keys, class Container>
+	void select_in(const Keys& keys, Container& con, const char* column = 0,
+			int max_size = 0)
+	{
+		reset();
+
+		if (keys.begin() == keys.end()) {
+			return;		// empty set!
+		}
+
+		typename Container::value_type proto;
+		StoreInSink<Container> sink(*this, con);
+		build_select_in(proto, keys.begin(), keys.end(),
+				column ? column : proto.names[0],
+				max_size ? max_size : internal::max_statement_size(conn_),
+				sink);
+	}
+
 	/// \brief Replace an existing row's data with new data.
 	///
 	/// This function builds an UPDATE SQL query using the new row data
@@ -994,6 +1248,56 @@ public:
 		return *this;
 	}
 
+	/// \brief Apply changes to many existing rows, in as few
+	/// statements as possible
+	///
+	/// Where update() sends one statement per row, this compares each
+	/// original object with its modified version, groups the rows by
+	/// which columns changed, and sends one statement per group like
+	/// \c UPDATE \c t \c SET \c c \c = \c CASE \c key \c WHEN \c ...
+	/// \c END \c WHERE \c key \c IN \c (...), split as the insert policy
+	/// says.  Rows with no changes are skipped.  As with insertfrom(),
+	/// the policy's access controller wraps the whole operation.
+	///
+	/// Rows are picked out by their original value in the key column,
+	/// which must be unique, and must not be NULL.  If the key itself
+	/// changes, it's set after the other columns, so their \c CASE
+	/// expressions still see the original key.
+	///
+	/// \param ofirst iterator pointing to first original object
+	/// \param olast iterator pointing to one past the last original
+	///    object
+	/// \param nfirst iterator pointing to the modified version of
+	///    \c *ofirst; the range it starts must be as long as the first
+	/// \param policy insert policy object, see insertpolicy.h for
+	///    details
+	/// \param column name of the key column; defaults to the SSQLS's
+	///    first field
+	///
+	/// \sa update(), insertfrom()
+	template <class OldIter, class NewIter, class InsertPolicy>
+	Query& update_many(OldIter ofirst, OldIter olast, NewIter nfirst,
+			InsertPolicy& policy, const char* column = 0)
+	{
+		reset();
+
+		if (ofirst == olast) {
+			return *this;   // empty set!
+		}
+
+		typename InsertPolicy::access_controller ac(*conn_);
+		ExecSink sink(*this);
+		if (build_update_many(ofirst, olast, nfirst, policy, column,
+				sink)) {
+			ac.commit();
+		}
+		else {
+			ac.rollback();
+		}
+
+		return *this;
+	}
+
 	/// \brief Insert a new row.
 	///
 	/// This function builds an INSERT SQL query.  One uses it with
@@ -1067,77 +1371,49 @@ public:
 	template <class Iter, class InsertPolicy>
 	Query& insertfrom(Iter first, Iter last, InsertPolicy& policy)
 	{
-		bool success = true;
-		bool empty = true;
+		return policy_insert(first, last, policy, "INSERT");
+	}
 
+	/// \brief Bulk-load a range of SSQLS objects with
+	/// \c LOAD \c DATA \c LOCAL \c INFILE
+	///
+	/// This is much faster than insert() or insertfrom() for large
+	/// data sets.  Rows are rendered and handed to the C API a buffer
+	/// at a time as the server asks for them, so memory use stays
+	/// constant no matter how big the range is, and no temporary file
+	/// is involved.
+	///
+	/// You must have set LocalInfileOption on the connection before
+	/// connecting, and the server must allow \c LOCAL loads; see the
+	/// \c local_infile server variable.
+	///
+	/// \param first iterator pointing to first element in range to
+	///    load
+	/// \param last iterator pointing to one past the last element to
+	///    load
+	/// \param table table to load into; defaults to the SSQLS's
+	///    table()
+	///
+	/// \return SimpleResult; its info() gives the server's record,
+	/// skip and warning counts.  If anything throws while producing
+	/// rows, the load is aborted and the error reported as a query
+	/// failure.
+	///
+	/// \sa insertfrom()
+	template <class Iter>
+	SimpleResult load_data(Iter first, Iter last, const char* table = 0)
+	{
 		reset();
 
 		if (first == last) {
-			return *this;   // empty set!
-		}
-
-		typename InsertPolicy::access_controller ac(*conn_);
-		
-		for (Iter it = first; it != last; ++it) {
-			if (policy.can_add(int(tellp()), *it)) {
-				if (empty) {
-					MYSQLPP_QUERY_THISPTR << std::setprecision(16) <<
-						"INSERT INTO `" << it->table() << "` (" <<
-						it->field_list() << ") VALUES (";
-				} 
-				else {
-					MYSQLPP_QUERY_THISPTR << ",(";
-				}
-
-				MYSQLPP_QUERY_THISPTR << it->value_list() << ')';
-
-				empty = false;
-			} 
-			else {
-				// Execute what we've built up already, if there is anything
-				if (!empty) {
-					if (!exec()) {
-						success = false;
-						break;
-					}
-
-					empty = true;
-				}
-
-				// If we _still_ can't add, the policy is too strict
-				if (policy.can_add(int(tellp()), *it)) {
-					MYSQLPP_QUERY_THISPTR << std::setprecision(16) <<
-						"INSERT INTO `" << it->table() << "` (" <<
-						it->field_list() << ") VALUES (" <<
-						it->value_list() << ')';
-
-					empty = false;
-				} 
-				else {
-					// At this point all we can do is give up
-					if (throw_exceptions()) {
-						throw BadInsertPolicy("Insert policy is too strict");
-					}
-
-					success = false;
-					break;
-				}
-			}
-		}
-
-		// We might need to execute the last query here.
-		if (success && !empty && !exec()) {
-			success = false;
-		}
-
-		if (success) {
-			ac.commit();
-		} 
-		else {
-			ac.rollback();
+			return SimpleResult(true, 0, 0, "");	// empty set!
 		}
 
-		return *this;
+		SQLStream fields(conn_);
+		fields << first->field_list();
+		internal::SSQLSInfileSource<Iter> src(first, last);
+		return load_data(src, table ? table : first->table(),
+				fields.str());
 	}
 
 	/// \brief Replace multiple new rows using an insert policy to
@@ -1155,77 +1431,7 @@ public:
 	template <class Iter, class InsertPolicy>
 	Query& replacefrom(Iter first, Iter last, InsertPolicy& policy)
 	{
-		bool success = true;
-		bool empty = true;
-
-		reset();
-
-		if (first == last) {
-			return *this;   // empty set!
-		}
-
-		typename InsertPolicy::access_controller ac(*conn_);
-
-		for (Iter it = first; it != last; ++it) {
-			if (policy.can_add(int(tellp()), *it)) {
-				if (empty) {
-					MYSQLPP_QUERY_THISPTR << std::setprecision(16) <<
-						"REPLACE INTO `" << it->table() << "` (" <<
-						it->field_list() << ") VALUES (";
-				}
-				else {
-					MYSQLPP_QUERY_THISPTR << ",(";
-				}
-
-				MYSQLPP_QUERY_THISPTR << it->value_list() << ')';
-
-				empty = false;
-			}
-			else {
-				// Execute what we've built up already, if there is anything
-				if (!empty) {
-					if (!exec()) {
-						success = false;
-						break;
-					}
-
-					empty = true;
-				}
-
-				// If we _still_ can't add, the policy is too strict
-				if (policy.can_add(int(tellp()), *it)) {
-					MYSQLPP_QUERY_THISPTR << std::setprecision(16) <<
-						"REPLACE INTO `" << it->table() << "` (" <<
-						it->field_list() << ") VALUES (" <<
-						it->value_list() << ')';
-
-					empty = false;
-				}
-				else {
-					// At this point all we can do is give up
-					if (throw_exceptions()) {
-						throw BadInsertPolicy("Insert policy is too strict");
-					}
-
-					success = false;
-					break;
-				}
-			}
-		}
-
-		// We might need to execute the last query here.
-		if (success && !empty && !exec()) {
-			success = false;
-		}
-
-		if (success) {
-			ac.commit();
-		}
-		else {
-			ac.rollback();
-		}
-
-		return *this;
+		return policy_insert(first, last, policy, "REPLACE");
 	}
 
 	/// \brief Insert new row unless there is an existing row that
@@ -1286,6 +1492,137 @@ public:
 		return *this;
 	}	
 
+	/// \brief Insert multiple new rows, or update existing ones if
+	/// there are existing rows that match on a unique index.
+	///
+	/// Builds a multi-row \c INSERT \c ... \c ON \c DUPLICATE \c KEY
+	/// \c UPDATE query from a range of SSQLS objects.  Unlike replace(),
+	/// which deletes the old row and inserts a new one, this updates
+	/// the old row in place, so it doesn't churn secondary indexes or
+	/// fire delete triggers.
+	///
+	/// Each affected row counts once in the rows affected if it was
+	/// inserted, and twice if it was updated.
+	///
+	/// \param first iterator pointing to first element in range to
+	///    insert/update
+	/// \param last iterator pointing to one past the last element to
+	///    insert/update
+	/// \param update_fields names of the columns to copy from the new
+	///    row when one already exists; if empty, all of the SSQLS's
+	///    fields are copied
+	///
+	/// \sa upsertfrom(), replace()
+	template <class Iter>
+	Query& upsert(Iter first, Iter last,
+			const std::vector<std::string>& update_fields =
+			std::vector<std::string>())
+	{
+		insert(first, last);
+		if (first != last) {
+			MYSQLPP_QUERY_THISPTR << upsert_clause(*first, update_fields);
+		}
+
+		return *this;
+	}
+
+	/// \brief Insert or update multiple rows using an insert policy
+	/// to control how the statements are created
+	///
+	/// This is to upsert() as insertfrom() is to insert(): it sends
+	/// the rows immediately, in as many statements as the policy asks
+	/// for.
+	///
+	/// \param first iterator pointing to first element in range to
+	///    insert/update
+	/// \param last iterator pointing to one past the last element to
+	///    insert/update
+	/// \param policy insert policy object, see insertpolicy.h for
+	///    details
+	/// \param update_fields names of the columns to copy from the new
+	///    row when one already exists; if empty, all of the SSQLS's
+	///    fields are copied
+	///
+	/// \sa upsert(), insertfrom()
+	template <class Iter, class InsertPolicy>
+	Query& upsertfrom(Iter first, Iter last, InsertPolicy& policy,
+			const std::vector<std::string>& update_fields =
+			std::vector<std::string>())
+	{
+		if (first == last) {
+			reset();
+			return *this;	// empty set!
+		}
+
+		return policy_insert(first, last, policy, "INSERT",
+				upsert_clause(*first, update_fields));
+	}
+
+#if defined(MYSQLPP_HAVE_VARIADIC_QUERIES)
+	/// \brief Execute a compile-time template query
+	///
+	/// This is like setting up a template query with parse() and then
+	/// calling execute() with the parameter values, except that the
+	/// values are formatted straight into the query, without building
+	/// SQLQueryParms or SQLTypeAdapter objects for strings and
+	/// integers, and passing the wrong number of them won't compile.
+	/// It replaces any query text already in this object, but leaves a
+	/// parsed template alone, so you can mix the two.
+	///
+	/// \param qt template query string; create it with
+	///     MYSQLPP_QUERY_TEMPLATE()
+	/// \param args one value per template parameter, of any type
+	///     SQLTypeAdapter accepts
+	///
+	/// \sa QueryTemplate
+	template <size_t N, class... Args>
+	SimpleResult execute(const QueryTemplate<N>& qt, const Args&... args)
+	{
+		static_assert(sizeof...(Args) == N,
+				"wrong number of parameters for the query template");
+		const internal::TemplateArg a[sizeof...(Args) + 1] = { args... };
+		return execute_template(qt.str(), a);
+	}
+
+	/// \brief Store the result of a compile-time template query
+	///
+	/// \see execute(const QueryTemplate<N>&, const Args&...)
+	template <size_t N, class... Args>
+	StoreQueryResult store(const QueryTemplate<N>& qt, const Args&... args)
+	{
+		static_assert(sizeof...(Args) == N,
+				"wrong number of parameters for the query template");
+		const internal::TemplateArg a[sizeof...(Args) + 1] = { args... };
+		return store_template(qt.str(), a);
+	}
+
+	/// \brief Get the SQL a compile-time template query would send
+	///
+	/// \see execute(const QueryTemplate<N>&, const Args&...)
+	template <size_t N, class... Args>
+	std::string str(const QueryTemplate<N>& qt, const Args&... args)
+	{
+		static_assert(sizeof...(Args) == N,
+				"wrong number of parameters for the query template");
+		const internal::TemplateArg a[sizeof...(Args) + 1] = { args... };
+		render_template(qt.str(), a);
+		return sbuffer_.str();
+	}
+
+	/// \brief Run a compile-time template query, fetching its result
+	/// rows as needed
+	///
+	/// \see execute(const QueryTemplate<N>&, const Args&...)
+	template <size_t N, class... Args>
+	UseQueryResult use(const QueryTemplate<N>& qt, const Args&... args)
+	{
+		static_assert(sizeof...(Args) == N,
+				"wrong number of parameters for the query template");
+		const internal::TemplateArg a[sizeof...(Args) + 1] = { args... };
+		return use_template(qt.str(), a);
+	}
+#endif
+
 #if !defined(DOXYGEN_IGNORE)
 	// Declare the remaining overloads.  These are hidden down here partly
 	// to keep the above code clear, but also so that we may hide them
@@ -1307,6 +1644,246 @@ public:
 
 private:
 	friend class SQLQueryParms;
+	friend class ParallelInsert;
+	friend class ParallelSelect;
+	template <class T, class InsertPolicy> friend class InsertStream;
+	friend class internal::QueryTestAccess;
+
+	// The statement builders behind the bulk operations.  They hand
+	// each statement to a sink instead of running it, which lets
+	// internal::QueryTestAccess check what they build without a server.
+
+	/// \brief Build INSERT or REPLACE statements for a range of
+	/// rows, handing each to sink as it fills up
+	///
+	/// \c suffix goes on the end of each statement.
+	template <class Iter, class InsertPolicy>
+	bool build_inserts(Iter first, Iter last, InsertPolicy& policy,
+			const char* verb, internal::StatementSink& sink,
+			const std::string& suffix = std::string())
+	{
+		internal::bool_tag<internal::is_speculative_policy<
+				InsertPolicy>::value> tag;
+		bool empty = true;
+
+		for (Iter it = first; it != last; ++it) {
+			if (!append_insert(*it, policy, verb, suffix, sink, empty,
+					tag)) {
+				return false;
+			}
+		}
+
+		// We might need to send the last statement here.
+		return empty || send_insert(sink, sbuffer_.str() + suffix);
+	}
+
+	/// \brief Build \c SELECT \c ... \c WHERE \c column \c IN \c (...)
+	/// statements for a range of keys, handing each to sink as it
+	/// reaches max_size
+	///
+	/// Like the speculative append_insert(), this renders each key
+	/// once, rolling it back out into the next statement if it
+	/// doesn't fit.
+	template <class T, class Iter>
+	bool build_select_in(const T& proto, Iter first, Iter last,
+			const char* column, int max_size,
+			internal::StatementSink& sink)
+	{
+		bool empty = true;
+
+		for (Iter it = first; it != last; ++it) {
+			std::streamoff mark = tellp();
+			if (empty) {
+				MYSQLPP_QUERY_THISPTR << std::setprecision(16) <<
+					"SELECT " << proto.field_list() << " FROM `" <<
+					proto.table() << "` WHERE `" << column << "` IN (";
+			}
+			else {
+				MYSQLPP_QUERY_THISPTR << ',';
+			}
+
+			MYSQLPP_QUERY_THISPTR << quote << SQLTypeAdapter(*it);
+
+			// Leave room for the closing parenthesis
+			if (!empty && (int(tellp()) + 1 > max_size)) {
+				// Split the statement just before this key's comma
+				std::string sql(sbuffer_.str());
+				std::string key(sql, size_t(mark) + 1);
+				sql.resize(size_t(mark));
+				if (!send_insert(sink, sql + ')')) {
+					return false;
+				}
+
+				MYSQLPP_QUERY_THISPTR << std::setprecision(16) <<
+					"SELECT " << proto.field_list() << " FROM `" <<
+					proto.table() << "` WHERE `" << column << "` IN (" <<
+					key;
+			}
+
+			empty = false;
+		}
+
+		return empty || send_insert(sink, sbuffer_.str() + ')');
+	}
+
+	/// \brief Build update_many()'s statements, handing each to sink
+	/// as it fills up
+	template <class OldIter, class NewIter, class InsertPolicy>
+	bool build_update_many(OldIter ofirst, OldIter olast, NewIter nfirst,
+			InsertPolicy& policy, const char* column,
+			internal::StatementSink& sink)
+	{
+		// Find the table, the columns, and which one is the key
+		std::string table(ofirst->table());
+		SQLStream fields(conn_);
+		fields << ofirst->field_list();
+		std::vector<std::string> names(
+				internal::split_field_list(fields.str()));
+		size_t key = 0;
+		if (column) {
+			std::string quoted = std::string("`") + column + '`';
+			key = std::find(names.begin(), names.end(), quoted) -
+					names.begin();
+			if (key == names.size()) {
+				if (throw_exceptions()) {
+					throw BadFieldName(column);
+				}
+				return false;
+			}
+		}
+
+		// Set the key column last, if it changes.  MySQL assigns
+		// columns left to right, so every CASE after the key's would
+		// be looking up rows by their new key.
+		std::vector<size_t> order;
+		for (size_t i = 0; i < names.size(); ++i) {
+			if (i != key) {
+				order.push_back(i);
+			}
+		}
+		order.push_back(key);
+
+		// Sort the changed rows into groups by the columns changed
+		typedef typename std::iterator_traits<NewIter>::value_type T;
+		typedef std::map<std::vector<bool>,
+				std::vector<UpdateRow<T> > > Groups;
+		Groups groups;
+		std::vector<std::string> ovals, nvals;
+		for (NewIter nit = nfirst; ofirst != olast; ++ofirst, ++nit) {
+			render_fields(*ofirst, names.size(), ovals);
+			render_fields(*nit, names.size(), nvals);
+
+			std::vector<bool> changed(names.size());
+			UpdateRow<T> row;
+			for (size_t i = 0; i < order.size(); ++i) {
+				if (ovals[order[i]] != nvals[order[i]]) {
+					changed[order[i]] = true;
+					row.values.push_back(nvals[order[i]]);
+				}
+			}
+
+			if (!row.values.empty()) {
+				row.obj = &*nit;
+				row.key = ovals[key];
+				groups[changed].push_back(row);
+			}
+		}
+
+		for (typename Groups::const_iterator it = groups.begin();
+				it != groups.end(); ++it) {
+			std::vector<std::string> columns;
+			for (size_t i = 0; i < order.size(); ++i) {
+				if (it->first[order[i]]) {
+					columns.push_back(names[order[i]]);
+				}
+			}
+
+			internal::CaseUpdateBuilder b(table, names[key], columns);
+			if (!build_updates(it->second, policy, b, sink,
+					internal::bool_tag<internal::is_speculative_policy<
+					InsertPolicy>::value>())) {
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	/// \brief Fold execute_many()'s parameter sets into as few
+	/// statements as fit in max_size, handing each to sink
+	///
+	/// \param head, tail as from find_values_tuple()
+	bool build_folded(const std::vector<SQLQueryParms>& sets,
+			size_t head, size_t tail, size_t max_size,
+			internal::StatementSink& sink);
+
+	/// \brief If we're a template for a single-row INSERT or REPLACE,
+	/// find where its \c VALUES tuple starts and how much of the
+	/// template follows it
+	bool find_values_tuple(size_t& head, size_t& tail) const;
+
+	/// \brief StatementSink that runs each statement on our connection
+	class ExecSink : public internal::StatementSink
+	{
+	public:
+		explicit ExecSink(Query& q) : q_(q) { }
+		bool send(const std::string& sql) { return q_.exec(sql); }
+
+	private:
+		Query& q_;
+	};
+
+	/// \brief StatementSink that runs each statement on our connection,
+	/// adding its rows to a container as storein() does
+	template <class Container>
+	class StoreInSink : public internal::StatementSink
+	{
+	public:
+		StoreInSink(Query& q, Container& con) : q_(q), con_(con) { }
+		bool send(const std::string& sql)
+		{
+			q_.storein(con_, sql);
+			return q_.copacetic_;
+		}
+
+	private:
+		Query& q_;
+		Container& con_;
+	};
+
+	/// \brief StatementSink that runs each statement on our connection,
+	/// adding up what they did, for execute_many_folded()
+	class TallySink : public internal::StatementSink
+	{
+	public:
+		explicit TallySink(Query& q) : rows(0), id(0), q_(q) { }
+		bool send(const std::string& sql)
+		{
+			if (!q_.exec(sql)) {
+				return false;
+			}
+			rows += q_.affected_rows();
+			id = q_.insert_id();
+			info = q_.info();
+			return true;
+		}
+
+		ulonglong rows;		///< rows affected by all statements
+		ulonglong id;		///< insert ID from the last statement
+		std::string info;	///< info() from the last statement
+
+	private:
+		Query& q_;
+	};
+
+	/// \brief A changed row waiting for update_many() to send it
+	template <class T>
+	struct UpdateRow
+	{
+		const T* obj;						///< modified object
+		std::string key;					///< original key value, as SQL
+		std::vector<std::string> values;	///< changed values, as SQL
+	};
 
 	/// \brief Connection to send queries through
 	Connection* conn_;
@@ -1327,6 +1904,298 @@ private:
 	/// \brief String buffer for storing assembled query
 	std::stringbuf sbuffer_;
 
+	/// \brief Implementation of insertfrom(), replacefrom() and
+	/// upsertfrom()
+	template <class Iter, class InsertPolicy>
+	Query& policy_insert(Iter first, Iter last, InsertPolicy& policy,
+			const char* verb, const std::string& suffix = std::string())
+	{
+		reset();
+
+		if (first == last) {
+			return *this;   // empty set!
+		}
+
+		typename InsertPolicy::access_controller ac(*conn_);
+		ExecSink sink(*this);
+		if (build_inserts(first, last, policy, verb, sink, suffix)) {
+			ac.commit();
+		}
+		else {
+			ac.rollback();
+		}
+
+		return *this;
+	}
+
+	/// \brief Add a row to the INSERT or REPLACE statement being
+	/// built in the query buffer, first handing the statement to sink
+	/// if it's full
+	///
+	/// \c empty says whether the buffer holds a statement yet, and is
+	/// updated to match.  \c suffix goes on the end of the statement
+	/// when it's sent, so it counts against the policy's size limit.
+	/// This version is for policies that must vet each row before it
+	/// is added.
+	template <class RowT, class InsertPolicy>
+	bool append_insert(const RowT& row, InsertPolicy& policy,
+			const char* verb, const std::string& suffix,
+			internal::StatementSink& sink, bool& empty,
+			internal::bool_tag<false>)
+	{
+		if (policy.can_add(int(tellp()) + int(suffix.size()), row)) {
+			if (empty) {
+				MYSQLPP_QUERY_THISPTR << std::setprecision(16) <<
+					verb << " INTO `" << row.table() << "` (" <<
+					row.field_list() << ") VALUES (";
+			}
+			else {
+				MYSQLPP_QUERY_THISPTR << ",(";
+			}
+
+			MYSQLPP_QUERY_THISPTR << row.value_list() << ')';
+
+			empty = false;
+			return true;
+		}
+
+		// Send what we've built up already, if there is anything
+		if (!empty) {
+			if (!send_insert(sink, sbuffer_.str() + suffix)) {
+				return false;
+			}
+
+			empty = true;
+		}
+
+		// If we _still_ can't add, the policy is too strict
+		if (policy.can_add(int(tellp()) + int(suffix.size()), row)) {
+			MYSQLPP_QUERY_THISPTR << std::setprecision(16) <<
+				verb << " INTO `" << row.table() << "` (" <<
+				row.field_list() << ") VALUES (" <<
+				row.value_list() << ')';
+
+			empty = false;
+			return true;
+		}
+		else {
+			// At this point all we can do is give up
+			if (throw_exceptions()) {
+				throw BadInsertPolicy("Insert policy is too strict");
+			}
+
+			return false;
+		}
+	}
+
+	/// \brief Add a row to the INSERT or REPLACE statement being
+	/// built in the query buffer, first handing the statement to sink
+	/// if it's full
+	///
+	/// This version is for policies supporting speculative appends.
+	/// The row is rendered straight into the statement, once.  If
+	/// that pushes the statement over the policy's limit, we roll the
+	/// row back out, send what came before it, and start the next
+	/// statement with it.
+	template <class RowT, class InsertPolicy>
+	bool append_insert(const RowT& row, InsertPolicy& policy,
+			const char* verb, const std::string& suffix,
+			internal::StatementSink& sink, bool& empty,
+			internal::bool_tag<true>)
+	{
+		std::streamoff mark = tellp();
+		if (empty) {
+			MYSQLPP_QUERY_THISPTR << std::setprecision(16) <<
+				verb << " INTO `" << row.table() << "` (" <<
+				row.field_list() << ") VALUES (";
+		}
+		else {
+			MYSQLPP_QUERY_THISPTR << ",(";
+		}
+
+		MYSQLPP_QUERY_THISPTR << row.value_list() << ')';
+
+		if (!empty && !policy.fits(int(tellp()) + int(suffix.size()))) {
+			// Split the statement just before this row's comma
+			std::string sql(sbuffer_.str());
+			std::string rest(sql, size_t(mark) + 1);
+			sql.resize(size_t(mark));
+			if (!send_insert(sink, sql + suffix)) {
+				return false;
+			}
+
+			MYSQLPP_QUERY_THISPTR << std::setprecision(16) <<
+				verb << " INTO `" << row.table() << "` (" <<
+				row.field_list() << ") VALUES " << rest;
+		}
+
+		if (!policy.fits(int(tellp()) + int(suffix.size()))) {
+			// Even a lone row is too big, so all we can do is give up
+			if (throw_exceptions()) {
+				throw BadInsertPolicy("Insert policy is too strict");
+			}
+
+			return false;
+		}
+
+		empty = false;
+		return true;
+	}
+
+	/// \brief Render each of an SSQLS object's fields on its own, as
+	/// SQL
+	template <class T>
+	void render_fields(const T& obj, size_t count,
+			std::vector<std::string>& out)
+	{
+		out.resize(count);
+		std::vector<bool> mask(count);
+		for (size_t i = 0; i < count; ++i) {
+			SQLStream s(conn_);
+			mask[i] = true;
+			s << obj.value_list(",", quote, &mask);
+			mask[i] = false;
+			out[i] = s.str();
+		}
+	}
+
+	/// \brief Send one of update_many()'s groups of rows, in as many
+	/// statements as the policy asks for
+	///
+	/// This version is for policies that must vet each row before it
+	/// is added.
+	template <class T, class InsertPolicy>
+	bool build_updates(const std::vector<UpdateRow<T> >& rows,
+			InsertPolicy& policy, internal::CaseUpdateBuilder& b,
+			internal::StatementSink& sink, internal::bool_tag<false>)
+	{
+		for (size_t i = 0; i < rows.size(); ++i) {
+			if (!policy.can_add(int(b.size()), *rows[i].obj)) {
+				if (!b.empty()) {
+					if (!send_insert(sink, b.str())) {
+						return false;
+					}
+					b.clear();
+				}
+
+				// If we _still_ can't add, the policy is too strict
+				if (!policy.can_add(int(b.size()), *rows[i].obj)) {
+					if (throw_exceptions()) {
+						throw BadInsertPolicy("Insert policy is too strict");
+					}
+					return false;
+				}
+			}
+
+			b.add(rows[i].key, rows[i].values);
+		}
+
+		return b.empty() || send_insert(sink, b.str());
+	}
+
+	/// \brief Send one of update_many()'s groups of rows, in as many
+	/// statements as the policy asks for
+	///
+	/// This version is for policies supporting speculative appends,
+	/// which can judge the statement's size with the row added.
+	template <class T, class InsertPolicy>
+	bool build_updates(const std::vector<UpdateRow<T> >& rows,
+			InsertPolicy& policy, internal::CaseUpdateBuilder& b,
+			internal::StatementSink& sink, internal::bool_tag<true>)
+	{
+		for (size_t i = 0; i < rows.size(); ++i) {
+			const UpdateRow<T>& row = rows[i];
+			if (!b.empty() &&
+					!policy.fits(int(b.size_with(row.key, row.values)))) {
+				if (!send_insert(sink, b.str())) {
+					return false;
+				}
+				b.clear();
+			}
+
+			if (!policy.fits(int(b.size_with(row.key, row.values)))) {
+				// Even a lone row is too big, so all we can do is give up
+				if (throw_exceptions()) {
+					throw BadInsertPolicy("Insert policy is too strict");
+				}
+				return false;
+			}
+
+			b.add(row.key, row.values);
+		}
+
+		return b.empty() || send_insert(sink, b.str());
+	}
+
+	/// \brief Hand a finished statement to sink, clearing the query
+	/// buffer if that succeeds
+	bool send_insert(internal::StatementSink& sink, const std::string& sql)
+	{
+		if (sink.send(sql)) {
+			reset();
+			return true;
+		}
+		else {
+			return false;
+		}
+	}
+
+	/// \brief Hand the statement in the query buffer to sink
+	bool send_insert(internal::StatementSink& sink)
+	{
+		return send_insert(sink, sbuffer_.str());
+	}
+
+	/// \brief Build the ON DUPLICATE KEY UPDATE clause for upsert()
+	/// and upsertfrom()
+	template <class T>
+	std::string upsert_clause(const T& row,
+			const std::vector<std::string>& update_fields)
+	{
+		SQLStream fields(conn_);
+		fields << row.field_list();
+		return internal::upsert_clause(fields.str(), update_fields);
+	}
+
+	/// \brief Render a compile-time template query into our buffer,
+	/// taking parameter values from args
+	void render_template(const char* tmpl,
+			const internal::TemplateArg* args);
+
+	/// \brief Write one compile-time template query parameter, quoted
+	/// and escaped as option says
+	void write_template_arg(const internal::TemplateArg& arg, char option);
+
+	/// \brief Back ends for the variadic execute(), store() and use()
+	SimpleResult execute_template(const char* tmpl,
+			const internal::TemplateArg* args);
+	StoreQueryResult store_template(const char* tmpl,
+			const internal::TemplateArg* args);
+	UseQueryResult use_template(const char* tmpl,
+			const internal::TemplateArg* args);
+
+	/// \brief execute_many() for INSERT-shaped templates
+	///
+	/// \param head length of the rendered statement before the
+	///     \c VALUES tuple
+	/// \param tail length of the rendered statement after it
+	SimpleResult execute_many_folded(const std::vector<SQLQueryParms>& sets,
+			size_t head, size_t tail);
+
+	/// \brief execute_many() using multi-statement batches
+	SimpleResult execute_many_batched(const std::vector<SQLQueryParms>& sets);
+
+	/// \brief execute_many() using a prepared statement
+	///
+	/// \retval false if the template can't be run as a prepared
+	/// statement, without having run anything
+	bool execute_many_prepared(const std::vector<SQLQueryParms>& sets,
+			SimpleResult& result);
+
+	/// \brief Run a LOAD DATA LOCAL INFILE statement fed by src
+	SimpleResult load_data(internal::InfileSource& src, const char* table,
+			const std::string& fields);
+
 	/// \brief Process a parameterized query list.
 	void proc(SQLQueryParms& p);
 
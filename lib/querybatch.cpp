@@ -0,0 +1,183 @@
+/***********************************************************************
+ querybatch.cpp - Implements the QueryBatch class.
+
+ Copyright (c) 2015 by Educational Technology Resources, Inc.  Others
+ may also hold copyrights on code in this file.  See the CREDITS.txt
+ file in the top directory of the distribution for details.
+
+ This file is part of MySQL++.
+
+ MySQL++ is free software; you can redistribute it and/or modify it
+ under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 2.1 of the License, or
+ (at your option) any later version.
+
+ MySQL++ is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with MySQL++; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+ USA
+***********************************************************************/
+
+#define MYSQLPP_NOT_HEADER
+#include "querybatch.h"
+
+#include "connection.h"
+#include "dbdriver.h"
+
+namespace mysqlpp {
+
+
+QueryBatch::QueryBatch(Connection* c, bool te) :
+OptionalExceptions(te),
+conn_(c)
+{
+}
+
+
+size_t
+QueryBatch::add(const std::string& sql)
+{
+	// Drop trailing semicolons and whitespace, since we add our own
+	// separators.  That can leave nothing, as for add(";"), which
+	// execute() knows not to send.
+	std::string::size_type end = sql.find_last_not_of(" \t\r\n;");
+	statements_.push_back(end == std::string::npos ? std::string() :
+			sql.substr(0, end + 1));
+	return statements_.size() - 1;
+}
+
+
+void
+QueryBatch::clear()
+{
+	statements_.clear();
+	results_.clear();
+}
+
+
+bool
+QueryBatch::execute()
+{
+	results_.assign(statements_.size(), Result());
+	if (statements_.empty()) {
+		return true;
+	}
+
+	// Empty statements succeed without troubling the server, which
+	// would call them a syntax error
+	std::string sql;
+	std::vector<size_t> sent;
+	for (size_t i = 0; i < statements_.size(); ++i) {
+		if (statements_[i].empty()) {
+			results_[i].executed = results_[i].ok = true;
+			continue;
+		}
+
+		if (!sent.empty()) {
+			sql += ";\n";
+		}
+		sql += statements_[i];
+		sent.push_back(i);
+	}
+	if (sent.empty()) {
+		return true;
+	}
+
+	// Each time around the loop, the server has reported on the k-th
+	// statement we sent, statement i; a good report means its result
+	// is ours to collect.
+	DBDriver* driver = conn_->driver();
+	bool ok = driver->execute(sql.data(), sql.length());
+	for (size_t k = 0; ; ++k) {
+		size_t i = k < sent.size() ? sent[k] : results_.size();
+		if (!ok) {
+			fail(i);
+			return false;
+		}
+
+		MYSQL_RES* res = driver->store_result();
+		if (!res && driver->errnum()) {
+			fail(i);
+			return false;
+		}
+
+		if (i < results_.size()) {
+			Result& r = results_[i];
+			r.executed = r.ok = true;
+			if (res) {
+				r.rows = StoreQueryResult(res, driver, throw_exceptions());
+			}
+			r.simple = SimpleResult(true, driver->insert_id(),
+					driver->affected_rows(), driver->query_info());
+		}
+		else if (res) {
+			// More results than statements; see class docs
+			driver->free_result(res);
+		}
+
+		DBDriver::nr_code rc = driver->next_result();
+		if (rc == DBDriver::nr_last_result ||
+				rc == DBDriver::nr_not_supported) {
+			break;
+		}
+		ok = rc == DBDriver::nr_more_results;
+	}
+
+	return true;
+}
+
+
+void
+QueryBatch::fail(size_t i)
+{
+	DBDriver* driver = conn_->driver();
+	int errnum = driver->errnum();
+	std::string error = driver->error();
+
+	if (i < results_.size()) {
+		Result& r = results_[i];
+		r.executed = true;
+		r.errnum = errnum;
+		r.error = error;
+
+		for (++i; i < results_.size(); ++i) {
+			if (!results_[i].executed) {
+				results_[i].error = "not run: an earlier statement in "
+						"the batch failed";
+			}
+		}
+	}
+
+	if (throw_exceptions()) {
+		throw BadQuery(error, errnum);
+	}
+}
+
+
+const QueryBatch::Result&
+QueryBatch::result(size_t i) const
+{
+	if (i >= results_.size()) {
+		throw BadIndex("QueryBatch", int(i), int(results_.size()));
+	}
+
+	return results_[i];
+}
+
+
+const std::string&
+QueryBatch::statement(size_t i) const
+{
+	if (i >= statements_.size()) {
+		throw BadIndex("QueryBatch", int(i), int(statements_.size()));
+	}
+
+	return statements_[i];
+}
+
+} // end namespace mysqlpp
@@ -0,0 +1,148 @@
+/// \file querybatch.h
+/// \brief Declares the QueryBatch class, which sends many statements
+/// to the server in a single round trip.
+
+/***********************************************************************
+ Copyright (c) 2015 by Educational Technology Resources, Inc.  Others
+ may also hold copyrights on code in this file.  See the CREDITS.txt
+ file in the top directory of the distribution for details.
+
+ This file is part of MySQL++.
+
+ MySQL++ is free software; you can redistribute it and/or modify it
+ under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 2.1 of the License, or
+ (at your option) any later version.
+
+ MySQL++ is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with MySQL++; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+ USA
+***********************************************************************/
+
+#if !defined(MYSQLPP_QUERYBATCH_H)
+#define MYSQLPP_QUERYBATCH_H
+
+#include "common.h"
+
+#include "noexceptions.h"
+#include "result.h"
+
+#include <string>
+#include <vector>
+
+namespace mysqlpp {
+
+#if !defined(DOXYGEN_IGNORE)
+// Make Doxygen ignore this
+class MYSQLPP_EXPORT Connection;
+#endif
+
+/// \brief Sends a batch of independent statements to the server in a
+/// single round trip, and sorts out the results
+///
+/// Each statement sent on its own costs a full network round trip,
+/// which for small queries takes far longer than running them.  Add
+/// the statements to one of these, call execute(), then pick up each
+/// statement's outcome with result().
+///
+/// This uses the MySQL multi-statement feature, so you must set
+/// MultiStatementsOption on the connection first.  The server runs the
+/// statements in order and stops at the first one that fails, so a
+/// failure leaves all later statements unrun.  Each statement must
+/// produce exactly one result, so don't batch \c CALL statements,
+/// which produce an extra status result.
+
+class MYSQLPP_EXPORT QueryBatch : public OptionalExceptions
+{
+public:
+	/// \brief The outcome of one statement in the batch
+	struct Result
+	{
+		/// \brief True if the server got as far as this statement
+		bool executed;
+
+		/// \brief True if the statement succeeded
+		bool ok;
+
+		/// \brief MySQL error number if the statement failed, else 0
+		int errnum;
+
+		/// \brief Error message if the statement failed or wasn't run
+		std::string error;
+
+		/// \brief Rows affected, insert ID and server info, as from
+		/// Query::execute()
+		SimpleResult simple;
+
+		/// \brief The statement's result set, if it returned one
+		StoreQueryResult rows;
+
+		/// \brief Create an object for a statement that hasn't run
+		Result() :
+		executed(false),
+		ok(false),
+		errnum(0)
+		{
+		}
+	};
+
+	/// \brief Create an empty batch
+	///
+	/// \param c connection to run the batch on
+	/// \param te if true, execute() throws exceptions on errors
+	explicit QueryBatch(Connection* c, bool te = true);
+
+	/// \brief Add a statement to the batch
+	///
+	/// Trailing semicolons and whitespace are dropped.  A statement
+	/// that's empty without them isn't sent, but still gets an index,
+	/// and a result that says it succeeded.
+	///
+	/// \return the statement's index, for passing to result()
+	size_t add(const std::string& sql);
+
+	/// \brief Remove all statements and results
+	void clear();
+
+	/// \brief Send all statements to the server, and collect their
+	/// results
+	///
+	/// \retval true if every statement succeeded.  If one failed and
+	/// exceptions are enabled, throws BadQuery for it instead, after
+	/// collecting the results of those before it.
+	bool execute();
+
+	/// \brief Get the outcome of a statement
+	///
+	/// Only meaningful after execute().  Throws BadIndex if \c i is
+	/// out of range.
+	const Result& result(size_t i) const;
+
+	/// \brief Get the number of statements in the batch
+	size_t size() const { return statements_.size(); }
+
+	/// \brief Get a statement as it will be sent, after add() has
+	/// trimmed it
+	///
+	/// Throws BadIndex if \c i is out of range.
+	const std::string& statement(size_t i) const;
+
+private:
+	/// \brief Record the failure of statement i, and mark the ones
+	/// after it as unrun
+	void fail(size_t i);
+
+	Connection* conn_;
+	std::vector<std::string> statements_;
+	std::vector<Result> results_;
+};
+
+} // end namespace mysqlpp
+
+#endif // !defined(MYSQLPP_QUERYBATCH_H)
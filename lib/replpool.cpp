@@ -0,0 +1,213 @@
+/***********************************************************************
+ replpool.cpp - Implements the ReplicatedConnectionPool class.
+
+ Copyright (c) 2015 by Educational Technology Resources, Inc.  Others
+ may also hold copyrights on code in this file.  See the CREDITS.txt
+ file in the top directory of the distribution for details.
+
+ This file is part of MySQL++.
+
+ MySQL++ is free software; you can redistribute it and/or modify it
+ under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 2.1 of the License, or
+ (at your option) any later version.
+
+ MySQL++ is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with MySQL++; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+ USA
+***********************************************************************/
+
+#define MYSQLPP_NOT_HEADER
+#include "replpool.h"
+
+#include "connection.h"
+#include "cpool.h"
+#include "query.h"
+#include "result.h"
+
+namespace mysqlpp {
+
+
+// What measure_lag() needs to know, and what it found out
+struct LagQuery
+{
+	std::string sql;
+	std::string column;
+	long lag;				// -1 if the replica doesn't say
+};
+
+
+//// measure_lag ///////////////////////////////////////////////////////
+// internal::probe_pool() check: run the lag query on the connection,
+// and note the lag it reports in the LagQuery arg points to.  If the
+// query fails without throwing, as it does when the connection has
+// exceptions disabled, keep the connection only if it still answers.
+
+static bool
+measure_lag(Connection& conn, void* arg)
+{
+	LagQuery& q = *static_cast<LagQuery*>(arg);
+	q.lag = -1;
+	StoreQueryResult res = conn.query(q.sql).store();
+	if (res && res.num_rows()) {
+		for (size_t i = 0; i < res.num_fields(); ++i) {
+			if (res.field_name(int(i)) == q.column) {
+				const String& value = res[0][i];
+				if (!value.is_null()) {
+					q.lag = value.conv<long>(0);
+				}
+				break;
+			}
+		}
+	}
+	return res || conn.ping();
+}
+
+
+ReplicatedConnectionPool::ReplicatedConnectionPool(ConnectionPool& primary,
+		unsigned int max_lag, unsigned int probe_interval) :
+primary_(primary),
+max_lag_(max_lag),
+lag_query_("SHOW SLAVE STATUS"),
+lag_column_("Seconds_Behind_Master"),
+next_(0),
+probed_(0),
+prober_(probe_main, this, probe_interval)
+{
+}
+
+
+ReplicatedConnectionPool::~ReplicatedConnectionPool()
+{
+	prober_.stop();
+}
+
+
+void
+ReplicatedConnectionPool::add_replica(ConnectionPool& replica)
+{
+	Monitor::Lock lock(monitor_);
+	replicas_.push_back(Replica(&replica));
+	prober_.start();
+	if (!prober_.running()) {
+		probed_ = 0;		// measure the new one on the next pool()
+	}
+	prober_.wake();
+}
+
+
+long
+ReplicatedConnectionPool::lag(size_t i) const
+{
+	Monitor::Lock lock(monitor_);
+	return i < replicas_.size() ? replicas_[i].lag : -1;
+}
+
+
+unsigned int
+ReplicatedConnectionPool::max_lag() const
+{
+	Monitor::Lock lock(monitor_);
+	return max_lag_;
+}
+
+
+ConnectionPool&
+ReplicatedConnectionPool::pool(Intent intent)
+{
+	if (intent == write) {
+		return primary_;
+	}
+
+	// Without a thread to measure lag in the background, do it here
+	// when it's due.  Only one caller does; the rest use what we knew.
+	bool due = false;
+	{
+		Monitor::Lock lock(monitor_);
+		if (prober_.interval() && !prober_.running() &&
+				(time(0) >= probed_ + time_t(prober_.interval()))) {
+			probed_ = time(0);
+			due = true;
+		}
+	}
+	if (due) {
+		probe();
+	}
+
+	// Take the next replica that's close enough to current
+	Monitor::Lock lock(monitor_);
+	for (size_t n = 0; n < replicas_.size(); ++n) {
+		const Replica& r = replicas_[next_++ % replicas_.size()];
+		if ((r.lag >= 0) && (r.lag <= long(max_lag_))) {
+			return *r.pool;
+		}
+	}
+	return primary_;
+}
+
+
+void
+ReplicatedConnectionPool::probe()
+{
+	// Copy what we need, so we don't hold the lock while we query
+	std::vector<ConnectionPool*> pools;
+	LagQuery q;
+	{
+		Monitor::Lock lock(monitor_);
+		for (size_t i = 0; i < replicas_.size(); ++i) {
+			pools.push_back(replicas_[i].pool);
+		}
+		q.sql = lag_query_;
+		q.column = lag_column_;
+	}
+
+	for (size_t i = 0; i < pools.size(); ++i) {
+		// A replica that can't run the query doesn't get reads
+		bool ok;
+		if (internal::probe_pool(*pools[i], measure_lag, &q, ok)) {
+			Monitor::Lock lock(monitor_);
+			replicas_[i].lag = ok ? q.lag : -1;
+		}
+	}
+}
+
+
+void
+ReplicatedConnectionPool::probe_main(void* rp)
+{
+	static_cast<ReplicatedConnectionPool*>(rp)->probe();
+}
+
+
+size_t
+ReplicatedConnectionPool::replicas() const
+{
+	Monitor::Lock lock(monitor_);
+	return replicas_.size();
+}
+
+
+void
+ReplicatedConnectionPool::set_lag_query(const std::string& sql,
+		const std::string& column)
+{
+	Monitor::Lock lock(monitor_);
+	lag_query_ = sql;
+	lag_column_ = column;
+}
+
+
+void
+ReplicatedConnectionPool::set_max_lag(unsigned int seconds)
+{
+	Monitor::Lock lock(monitor_);
+	max_lag_ = seconds;
+}
+
+} // end namespace mysqlpp
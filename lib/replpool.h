@@ -0,0 +1,175 @@
+/// \file replpool.h
+/// \brief Declares the ReplicatedConnectionPool class, which sends
+/// writes to a primary database server and spreads reads over its
+/// replicas.
+
+/***********************************************************************
+ Copyright (c) 2015 by Educational Technology Resources, Inc.  Others
+ may also hold copyrights on code in this file.  See the CREDITS.txt
+ file in the top directory of the distribution for details.
+
+ This file is part of MySQL++.
+
+ MySQL++ is free software; you can redistribute it and/or modify it
+ under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 2.1 of the License, or
+ (at your option) any later version.
+
+ MySQL++ is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with MySQL++; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+ USA
+***********************************************************************/
+
+#if !defined(MYSQLPP_REPLPOOL_H)
+#define MYSQLPP_REPLPOOL_H
+
+#include "common.h"
+
+#include "mythread.h"
+#include "prober.h"
+
+#include <string>
+#include <vector>
+
+#include <time.h>
+
+namespace mysqlpp {
+
+#if !defined(DOXYGEN_IGNORE)
+// Make Doxygen ignore this
+class MYSQLPP_EXPORT ConnectionPool;
+#endif
+
+/// \brief Splits database work between a primary server and its
+/// replicas, each with a ConnectionPool of its own
+///
+/// Give it a ConnectionPool for the primary and one for each replica.
+/// These are your own ConnectionPool subclasses, each with a create()
+/// that knows how to connect to its server.  Then say what you mean
+/// to do with a connection when asking for one:
+///
+/// \code
+/// ScopedConnection conn(pools, ReplicatedConnectionPool::read);
+/// \endcode
+///
+/// Writes always go to the primary.  Reads go to the replicas in turn,
+/// skipping any whose replication lag is unknown or more than
+/// max_lag() seconds behind the primary.  If that leaves none, reads go
+/// to the primary, too.
+///
+/// A background thread measures each replica's lag every
+/// probe_interval() seconds, by running a query on it; see
+/// set_lag_query().  Until a replica's first measurement comes in, it
+/// gets no reads.  If the platform doesn't support threads, pool()
+/// takes the measurements instead, when they're due.
+///
+/// The ConnectionPool objects must outlive this object.
+
+class MYSQLPP_EXPORT ReplicatedConnectionPool
+{
+public:
+	/// \brief What a connection is wanted for
+	enum Intent {
+		read,		///< only reading, so a replica will do
+		write		///< changing data, so only the primary will do
+	};
+
+	/// \brief Create the object
+	///
+	/// \param primary pool of connections to the primary server
+	/// \param max_lag most seconds a replica may be behind the primary
+	///     and still get reads
+	/// \param probe_interval seconds between lag measurements, or 0 to
+	///     only measure when you call probe()
+	explicit ReplicatedConnectionPool(ConnectionPool& primary,
+			unsigned int max_lag = 10, unsigned int probe_interval = 5);
+
+	/// \brief Destroy the object, stopping the lag measurement thread
+	~ReplicatedConnectionPool();
+
+	/// \brief Add a replica of the primary server
+	///
+	/// It gets no reads until its lag has been measured.
+	void add_replica(ConnectionPool& replica);
+
+	/// \brief Get a replica's replication lag as of its last
+	/// measurement, in seconds, or -1 if it isn't known
+	///
+	/// \param i replica index, in the order they were added
+	long lag(size_t i) const;
+
+	/// \brief Get the most seconds a replica may be behind the primary
+	/// and still get reads
+	unsigned int max_lag() const;
+
+	/// \brief Choose the pool to grab a connection for the given
+	/// intent from
+	ConnectionPool& pool(Intent intent);
+
+	/// \brief Get the primary server's pool
+	ConnectionPool& primary() { return primary_; }
+
+	/// \brief Measure every replica's lag now, on the calling thread
+	void probe();
+
+	/// \brief Get the number of seconds between lag measurements
+	unsigned int probe_interval() const { return prober_.interval(); }
+
+	/// \brief Get the number of replicas added
+	size_t replicas() const;
+
+	/// \brief Change how replication lag is measured
+	///
+	/// The query is run on each replica, and the lag read from the
+	/// named column of its first row, in seconds.  No rows, or a SQL
+	/// null, mean the lag isn't known.  The default is \c SHOW \c SLAVE
+	/// \c STATUS and its \c Seconds_Behind_Master column; with MySQL 8.4
+	/// and newer, use \c SHOW \c REPLICA \c STATUS and
+	/// \c Seconds_Behind_Source instead.  If you keep a heartbeat table
+	/// updated on the primary, a query comparing its timestamp to the
+	/// replica's clock gives a more accurate figure.
+	void set_lag_query(const std::string& sql, const std::string& column);
+
+	/// \brief Change the most seconds a replica may be behind the
+	/// primary and still get reads
+	void set_max_lag(unsigned int seconds);
+
+private:
+	ReplicatedConnectionPool(const ReplicatedConnectionPool&);
+	ReplicatedConnectionPool& operator =(const ReplicatedConnectionPool&);
+
+	/// \brief A replica's pool and what we know about its lag
+	struct Replica {
+		ConnectionPool* pool;
+		long lag;
+
+		explicit Replica(ConnectionPool* p) :
+		pool(p),
+		lag(-1)
+		{
+		}
+	};
+
+	/// \brief probe(), in the form the lag measurement thread calls
+	static void probe_main(void* rp);
+
+	ConnectionPool& primary_;
+	std::vector<Replica> replicas_;
+	unsigned int max_lag_;
+	std::string lag_query_;
+	std::string lag_column_;
+	size_t next_;				// replica to try first for the next read
+	time_t probed_;				// when pool() last started a probe()
+	mutable Monitor monitor_;
+	internal::Prober prober_;	// lag measurement thread
+};
+
+} // end namespace mysqlpp
+
+#endif // !defined(MYSQLPP_REPLPOOL_H)
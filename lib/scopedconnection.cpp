@@ -30,14 +30,36 @@
 namespace mysqlpp {
 
 ScopedConnection::ScopedConnection(ConnectionPool& pool, bool safe) :
-pool_(pool),
+pool_(&pool),
+balanced_(0),
+connection_(safe ? pool.safe_grab() : pool.grab())
+{
+}
+
+ScopedConnection::ScopedConnection(ReplicatedConnectionPool& pool,
+		ReplicatedConnectionPool::Intent intent, bool safe) :
+pool_(&pool.pool(intent)),
+balanced_(0),
+connection_(safe ? pool_->safe_grab() : pool_->grab())
+{
+}
+
+ScopedConnection::ScopedConnection(BalancedConnectionPool& pool,
+		bool safe) :
+pool_(0),
+balanced_(&pool),
 connection_(safe ? pool.safe_grab() : pool.grab())
 {
 }
 
 ScopedConnection::~ScopedConnection()
 {
-    pool_.release(connection_);
+	if (balanced_) {
+		balanced_->release(connection_);
+	}
+	else {
+		pool_->release(connection_);
+	}
 }
 
 } // end namespace mysqlpp
@@ -34,6 +34,9 @@
 
 #include "common.h"
 
+#include "balancedpool.h"
+#include "replpool.h"
+
 namespace mysqlpp {
 
 #if !defined(DOXYGEN_IGNORE)
@@ -59,6 +62,24 @@ public:
 	/// ConnectionPool::grab(), but we can call safe_grab() instead.
 	explicit ScopedConnection(ConnectionPool& pool, bool safe = false);
 
+	/// \brief Grab a Connection from the pool a ReplicatedConnectionPool
+	/// picks for the given intent
+	///
+	/// \param pool The ReplicatedConnectionPool to use.
+	/// \param intent Whether the connection is for reading or writing.
+	/// \param safe As for the other ctor.
+	ScopedConnection(ReplicatedConnectionPool& pool,
+			ReplicatedConnectionPool::Intent intent, bool safe = false);
+
+	/// \brief Grab a Connection from the server a
+	/// BalancedConnectionPool picks
+	///
+	/// \param pool The BalancedConnectionPool to use, and to release
+	/// the Connection back to.
+	/// \param safe As for the first ctor.
+	explicit ScopedConnection(BalancedConnectionPool& pool,
+			bool safe = false);
+
 	/// \brief Destructor
 	///
 	/// Releases the Connection back to the ConnectionPool.
@@ -80,7 +101,8 @@ private:
 	ScopedConnection(const ScopedConnection& no_copies);   
 	const ScopedConnection& operator=(const ScopedConnection& no_copies);
 
-	ConnectionPool& pool_;
+	ConnectionPool* const pool_;
+	BalancedConnectionPool* const balanced_;
 	Connection* const connection_;
 };
 
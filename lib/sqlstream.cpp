@@ -81,6 +81,18 @@ SQLStream::escape_string(char* escaped, const char* original,
 }
 
 
+size_t
+SQLStream::write_escaped(const char* original, size_t length)
+{
+	if (conn_ && *conn_) {
+		return conn_->driver()->escape_string(*this, original, length);
+	}
+	else {
+		return DBDriver::escape_string_no_conn(*this, original, length);
+	}
+}
+
+
 SQLStream&
 SQLStream::operator=(const SQLStream& rhs)
 {
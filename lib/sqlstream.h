@@ -98,6 +98,12 @@ public:
 	size_t escape_string(char* escaped, const char* original,
 			size_t length) const;
 
+	/// \brief Insert a SQL-escaped copy of a character buffer into
+	/// the stream
+	///
+	/// \see Query::write_escaped(const char*, size_t)
+	size_t write_escaped(const char* original, size_t length);
+
 	/// \brief Assigns contents of another SQLStream to this one
 	SQLStream& operator=(const SQLStream& rhs);
 
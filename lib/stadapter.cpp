@@ -416,7 +416,7 @@ SQLTypeAdapter::assign(const null_type&)
 }
 
 char
-SQLTypeAdapter::at(size_type i) const throw(std::out_of_range)
+SQLTypeAdapter::at(size_type i) const MYSQLPP_MAY_THROW(std::out_of_range)
 {
 	if (buffer_) {
 		if (i <= length()) {
@@ -515,6 +515,13 @@ SQLTypeAdapter::quote_q() const
 	return buffer_ ? buffer_->quote_q() : true;
 }
 
+const mysql_type_info&
+SQLTypeAdapter::type() const
+{
+	static const mysql_type_info none(typeid(void));
+	return buffer_ ? buffer_->type() : none;
+}
+
 int
 SQLTypeAdapter::type_id() const
 {
@@ -221,7 +221,7 @@ public:
 	/// WARNING: The throw-spec is incorrect, but it can't be changed
 	/// until v4, where we can break the ABI.  Throw-specs shouldn't be
 	/// relied on anyway.
-	char at(size_type i) const throw(std::out_of_range);
+	char at(size_type i) const MYSQLPP_MAY_THROW(std::out_of_range);
 
 	/// \brief Compare the internal buffer to the given string
 	///
@@ -263,7 +263,7 @@ public:
 	/// The buffer's actual content will probably be "NULL" or
 	/// something like it, but in the SQL data type system, a SQL
 	/// null is distinct from a plain string with value "NULL".
-	bool is_null() const { return buffer_->is_null(); }
+	bool is_null() const { return buffer_ && buffer_->is_null(); }
 
 	/// \brief Returns true if the internal 'processed' flag is set.
 	///
@@ -279,6 +279,12 @@ public:
 	/// that must be quoted when used in a SQL query
 	bool quote_q() const;
 
+	/// \brief Returns the type of the buffer's data
+	///
+	/// A default-constructed object has no data, so its type is that
+	/// of SQL null.
+	const mysql_type_info& type() const;
+
 	/// \brief Returns the type ID of the buffer's data
 	///
 	/// Values from type_info.h.  At the moment, these are the same as
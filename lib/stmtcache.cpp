@@ -0,0 +1,99 @@
+/***********************************************************************
+ stmtcache.cpp - Implements the StatementCache class.
+
+ Copyright (c) 2015 by Educational Technology Resources, Inc.  Others
+ may also hold copyrights on code in this file.  See the CREDITS.txt
+ file in the top directory of the distribution for details.
+
+ This file is part of MySQL++.
+
+ MySQL++ is free software; you can redistribute it and/or modify it
+ under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 2.1 of the License, or
+ (at your option) any later version.
+
+ MySQL++ is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with MySQL++; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+ USA
+***********************************************************************/
+
+#define MYSQLPP_NOT_HEADER
+#include "stmtcache.h"
+
+namespace mysqlpp {
+
+
+StatementCache::StatementCache(Connection* conn, size_t capacity) :
+conn_(conn),
+capacity_(capacity),
+hits_(0),
+misses_(0),
+evictions_(0)
+{
+}
+
+
+void
+StatementCache::clear()
+{
+	index_.clear();
+	lru_.clear();
+}
+
+
+bool
+StatementCache::create(const std::string& sql, PreparedQueryPtr& pq)
+{
+	pq = new PreparedQuery(conn_, sql);
+	return pq->prepared();
+}
+
+
+PreparedQueryPtr
+StatementCache::get(const std::string& sql)
+{
+	Index::iterator it = index_.find(sql);
+	if (it != index_.end()) {
+		// Hit; move it to the front of the LRU list
+		++hits_;
+		lru_.splice(lru_.begin(), lru_, it->second);
+		return it->second->second;
+	}
+
+	++misses_;
+	PreparedQueryPtr pq;
+	if (create(sql, pq) && (capacity_ > 0)) {
+		trim(capacity_ - 1);
+		lru_.push_front(LRUList::value_type(sql, pq));
+		index_[sql] = lru_.begin();
+	}
+
+	return pq;
+}
+
+
+void
+StatementCache::set_capacity(size_t n)
+{
+	capacity_ = n;
+	trim(n);
+}
+
+
+void
+StatementCache::trim(size_t n)
+{
+	while (index_.size() > n) {
+		index_.erase(lru_.back().first);
+		lru_.pop_back();
+		++evictions_;
+	}
+}
+
+} // end namespace mysqlpp
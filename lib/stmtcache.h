@@ -0,0 +1,149 @@
+/// \file stmtcache.h
+/// \brief Declares the StatementCache class, which keeps a connection's
+/// recently-used prepared statements around for reuse.
+
+/***********************************************************************
+ Copyright (c) 2015 by Educational Technology Resources, Inc.  Others
+ may also hold copyrights on code in this file.  See the CREDITS.txt
+ file in the top directory of the distribution for details.
+
+ This file is part of MySQL++.
+
+ MySQL++ is free software; you can redistribute it and/or modify it
+ under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 2.1 of the License, or
+ (at your option) any later version.
+
+ MySQL++ is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with MySQL++; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+ USA
+***********************************************************************/
+
+#if !defined(MYSQLPP_STMTCACHE_H)
+#define MYSQLPP_STMTCACHE_H
+
+#include "common.h"
+
+#include "prepared.h"
+#include "refcounted.h"
+
+#include <list>
+#include <map>
+#include <string>
+#include <utility>
+
+namespace mysqlpp {
+
+#if !defined(DOXYGEN_IGNORE)
+// Make Doxygen ignore this
+class MYSQLPP_EXPORT Connection;
+#endif
+
+/// \brief A bounded, least-recently-used cache of prepared statements
+/// for a single connection, keyed by SQL text
+///
+/// Preparing a statement costs a round trip to the server, so using a
+/// PreparedQuery only once is slower than just sending the query.  This
+/// cache lets code that runs the same statements over and over pay that
+/// cost once per connection rather than once per use.
+///
+/// You don't normally create one of these yourself.  Call
+/// Connection::prepare() instead, which uses the connection's cache.
+///
+/// Statements are handed out as reference-counted pointers, so one
+/// that gets evicted while you're still using it stays alive until you
+/// drop your pointer; it just won't be handed out again.
+///
+/// Statements in the cache transparently re-prepare themselves if the
+/// connection is re-established, so there is no need to clear the
+/// cache when that happens.  Connection::reset_session() does clear
+/// it, since the C API closes the statements on its side.
+
+class MYSQLPP_EXPORT StatementCache
+{
+public:
+	/// \brief Create an empty cache
+	///
+	/// \param conn connection to prepare statements on
+	/// \param capacity maximum number of statements to keep
+	StatementCache(Connection* conn, size_t capacity = 64);
+
+	/// \brief Destroy the cache, releasing all cached statements
+	/// that aren't still in use elsewhere
+	virtual ~StatementCache() { }
+
+	/// \brief Get the maximum number of statements we will keep
+	size_t capacity() const { return capacity_; }
+
+	/// \brief Drop all cached statements
+	void clear();
+
+	/// \brief Get the number of statements dropped to stay within
+	/// capacity()
+	ulonglong evictions() const { return evictions_; }
+
+	/// \brief Get a prepared statement for the given SQL
+	///
+	/// Returns the cached statement if there is one, else prepares a
+	/// new one and caches it, evicting the least recently used one if
+	/// the cache is full.  A statement that fails to prepare is not
+	/// cached.
+	PreparedQueryPtr get(const std::string& sql);
+
+	/// \brief Get the number of get() calls satisfied from the cache
+	ulonglong hits() const { return hits_; }
+
+	/// \brief Get the number of get() calls that had to prepare a
+	/// new statement
+	ulonglong misses() const { return misses_; }
+
+	/// \brief Change the maximum number of statements we will keep
+	///
+	/// Setting it to 0 disables caching: get() then prepares a new
+	/// statement every time.
+	void set_capacity(size_t n);
+
+	/// \brief Get the number of statements currently cached
+	size_t size() const { return index_.size(); }
+
+protected:
+	/// \brief Make the statement for a get() that missed the cache
+	///
+	/// \param sql SQL text the statement is for
+	/// \param pq receives the new statement, which get() returns
+	///
+	/// \retval true if the statement may be cached
+	///
+	/// The default version prepares \c sql on our connection, and
+	/// only lets successfully-prepared statements be cached.  Override
+	/// it to build statements some other way.
+	virtual bool create(const std::string& sql, PreparedQueryPtr& pq);
+
+private:
+	/// \brief Cache entries in order of use, most recent first
+	typedef std::list<std::pair<std::string, PreparedQueryPtr> > LRUList;
+
+	/// \brief Map from SQL text to cache entry
+	typedef std::map<std::string, LRUList::iterator> Index;
+
+	/// \brief Evict least recently used entries until at most n remain
+	void trim(size_t n);
+
+	Connection* conn_;
+	size_t capacity_;
+	LRUList lru_;
+	Index index_;
+	ulonglong hits_;
+	ulonglong misses_;
+	ulonglong evictions_;
+};
+
+} // end namespace mysqlpp
+
+#endif // !defined(MYSQLPP_STMTCACHE_H)
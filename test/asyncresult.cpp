@@ -0,0 +1,175 @@
+/***********************************************************************
+ test/asyncresult.cpp - Tests AsyncResult::run() and the callbacks it
+	makes, which need no database server.
+
+ Copyright (c) 2015 by Educational Technology Resources, Inc.  Others
+ may also hold copyrights on code in this file.  See the CREDITS.txt
+ file in the top directory of the distribution for details.
+
+ This file is part of MySQL++.
+
+ MySQL++ is free software; you can redistribute it and/or modify it
+ under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 2.1 of the License, or
+ (at your option) any later version.
+
+ MySQL++ is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with MySQL++; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+ USA
+***********************************************************************/
+
+#include <mysql++.h>
+
+#include <iostream>
+
+using namespace std;
+
+// What a task did, and what its callback saw.  The Monitor makes the
+// callback's writes visible to the main thread once it's waited.
+struct Record
+{
+	mysqlpp::Monitor monitor;
+	bool ran;
+	int calls;
+	bool was_done;
+	void* userdata;
+
+	Record() : ran(false), calls(0), was_done(false), userdata(0) { }
+};
+
+
+static void
+task(void* arg)
+{
+	Record* r = static_cast<Record*>(arg);
+	mysqlpp::Monitor::Lock lock(r->monitor);
+	r->ran = true;
+}
+
+
+static void
+callback(mysqlpp::AsyncResult& result, void* userdata)
+{
+	Record* r = static_cast<Record*>(userdata);
+	mysqlpp::Monitor::Lock lock(r->monitor);
+	++r->calls;
+	r->was_done = result.ok();
+	r->userdata = userdata;
+	r->monitor.notify_all();
+}
+
+
+// Wait for r's callback, which may come after wait() returns
+static bool
+wait_for_callback(Record& r, int calls)
+{
+	mysqlpp::Monitor::Lock lock(r.monitor);
+	for (int i = 0; (r.calls < calls) && (i < 50); ++i) {
+		r.monitor.wait(100);
+	}
+	return r.calls == calls;
+}
+
+
+static bool
+test_empty()
+{
+	mysqlpp::AsyncResult ar;
+	if (!ar.ready() || ar.ok() || (ar.fd() != -1) || ar.errnum()) {
+		cerr << "Empty AsyncResult isn't ready and failed!" << endl;
+		return false;
+	}
+	return true;
+}
+
+
+static bool
+test_run()
+{
+	Record r;
+	mysqlpp::AsyncResult ar = mysqlpp::AsyncResult::run(task, &r,
+			callback, &r);
+	ar.wait();
+	if (!ar.ready() || !ar.ok() || ar.native()) {
+		cerr << "run() result isn't a finished, successful, non-native "
+				"task!" << endl;
+		return false;
+	}
+	if (!wait_for_callback(r, 1)) {
+		cerr << "run() callback called " << r.calls << " times!" << endl;
+		return false;
+	}
+
+	mysqlpp::Monitor::Lock lock(r.monitor);
+	if (!r.ran || !r.was_done || (r.userdata != &r)) {
+		cerr << "run() task or callback didn't see what it should!" <<
+				endl;
+		return false;
+	}
+	return true;
+}
+
+
+static bool
+test_on_finish()
+{
+	// A callback set before the task finishes replaces the original.
+	// Hold the task up until it's set, by holding its lock.
+	Record orig, later;
+	mysqlpp::AsyncResult ar;
+	{
+		mysqlpp::Monitor::Lock lock(later.monitor);
+		ar = mysqlpp::AsyncResult::run(task, &later, callback, &orig);
+		if (mysqlpp::Thread::supported() &&
+				!ar.on_finish(callback, &later)) {
+			cerr << "on_finish() found the task finished early!" << endl;
+			return false;
+		}
+	}
+	if (!ar.wait(5000)) {
+		cerr << "run() task didn't finish!" << endl;
+		return false;
+	}
+	if (mysqlpp::Thread::supported() &&
+			(!wait_for_callback(later, 1) || orig.calls)) {
+		cerr << "on_finish() callback wasn't the one called!" << endl;
+		return false;
+	}
+
+	// Too late now: it's finished, so nothing more gets called
+	Record late;
+	if (ar.on_finish(callback, &late) || late.calls) {
+		cerr << "on_finish() accepted a callback after finishing!" <<
+				endl;
+		return false;
+	}
+
+	// Copies refer to the same task
+	mysqlpp::AsyncResult copy(ar);
+	if (!copy.ready() || !copy.ok()) {
+		cerr << "Copy of finished AsyncResult isn't finished!" << endl;
+		return false;
+	}
+	return true;
+}
+
+
+int
+main()
+{
+	try {
+		return	test_empty() &&
+				test_run() &&
+				test_on_finish() ? 0 : 1;
+	}
+	catch (...) {
+		cerr << "Unhandled exception caught by test/asyncresult!" << endl;
+		return 2;
+	}
+}
@@ -0,0 +1,349 @@
+/***********************************************************************
+ test/bulkquery.cpp - Tests the statements Query's bulk operations
+	build, which it can do without a database server.
+
+ Copyright (c) 2015 by Educational Technology Resources, Inc.  Others
+ may also hold copyrights on code in this file.  See the CREDITS.txt
+ file in the top directory of the distribution for details.
+
+ This file is part of MySQL++.
+
+ MySQL++ is free software; you can redistribute it and/or modify it
+ under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 2.1 of the License, or
+ (at your option) any later version.
+
+ MySQL++ is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with MySQL++; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+ USA
+***********************************************************************/
+
+#include <mysql++.h>
+#define MYSQLPP_ALLOW_SSQLS_V1	// suppress deprecation warning
+#include <ssqls.h>
+
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+sql_create_2(item, 1, 2,
+	mysqlpp::sql_int, id,
+	mysqlpp::sql_varchar, name)
+
+
+// Query's hook for tests, giving us its private statement builders
+class mysqlpp::internal::QueryTestAccess
+{
+public:
+	template <class Iter, class InsertPolicy>
+	static bool build_inserts(Query& q, Iter first, Iter last,
+			InsertPolicy& policy, const char* verb, StatementSink& sink,
+			const std::string& suffix)
+	{
+		return q.build_inserts(first, last, policy, verb, sink, suffix);
+	}
+
+	template <class T, class Iter>
+	static bool build_select_in(Query& q, const T& proto, Iter first,
+			Iter last, const char* column, int max_size,
+			StatementSink& sink)
+	{
+		return q.build_select_in(proto, first, last, column, max_size,
+				sink);
+	}
+
+	template <class OldIter, class NewIter, class InsertPolicy>
+	static bool build_update_many(Query& q, OldIter ofirst,
+			OldIter olast, NewIter nfirst, InsertPolicy& policy,
+			const char* column, StatementSink& sink)
+	{
+		return q.build_update_many(ofirst, olast, nfirst, policy, column,
+				sink);
+	}
+
+	static bool build_folded(Query& q,
+			const std::vector<SQLQueryParms>& sets, size_t head,
+			size_t tail, size_t max_size, StatementSink& sink)
+	{
+		return q.build_folded(sets, head, tail, max_size, sink);
+	}
+
+	static bool find_values_tuple(const Query& q, size_t& head,
+			size_t& tail)
+	{
+		return q.find_values_tuple(head, tail);
+	}
+};
+
+typedef mysqlpp::internal::QueryTestAccess Access;
+
+
+// Keeps the statements a builder hands it, instead of running them
+class SaveSink : public mysqlpp::internal::StatementSink
+{
+public:
+	bool send(const std::string& sql)
+	{
+		statements.push_back(sql);
+		return true;
+	}
+
+	vector<string> statements;
+};
+
+
+static bool
+check_sql(const char* what, const string& actual, const string& expected)
+{
+	if (actual != expected) {
+		cerr << what << " built\n\t" << actual << "\nnot\n\t" <<
+				expected << endl;
+		return false;
+	}
+	return true;
+}
+
+
+static vector<item>
+make_items(int n)
+{
+	const char* names[] = { "a", "b", "c", "d" };
+	vector<item> items;
+	for (int i = 0; i < n; ++i) {
+		items.push_back(item(i + 1, names[i % 4]));
+	}
+	return items;
+}
+
+
+static bool
+test_upsert_clause()
+{
+	vector<string> fields;
+	if (!check_sql("upsert_clause() for all fields",
+			mysqlpp::internal::upsert_clause("`id`,`name`", fields),
+			" ON DUPLICATE KEY UPDATE `id`=VALUES(`id`),"
+			"`name`=VALUES(`name`)")) {
+		return false;
+	}
+
+	// Backquotes in plain names have to be doubled
+	fields.push_back("odd`name");
+	mysqlpp::Query q(0);	// don't pass 0 for conn parameter in real code
+	vector<item> items(make_items(1));
+	q.upsert(items.begin(), items.end(), fields);
+	return check_sql("upsert() with a backquoted name", q.str(),
+			"INSERT INTO `item` (`id`,`name`) VALUES (1,'a') "
+			"ON DUPLICATE KEY UPDATE `odd``name`=VALUES(`odd``name`)");
+}
+
+
+static bool
+test_upsert_split()
+{
+	// Make the limit just big enough for two rows plus the clause, so
+	// three rows have to go in two statements
+	const string clause(mysqlpp::internal::upsert_clause("`id`,`name`",
+			vector<string>()));
+	const string two("INSERT INTO `item` (`id`,`name`) VALUES "
+			"(1,'a'),(2,'b')" + clause);
+	mysqlpp::Query::MaxPacketInsertPolicy<> policy(int(two.size()));
+
+	mysqlpp::Query q(0);
+	SaveSink sink;
+	vector<item> items(make_items(3));
+	if (!Access::build_inserts(q, items.begin(), items.end(), policy,
+			"INSERT", sink, clause)) {
+		cerr << "build_inserts() failed!" << endl;
+		return false;
+	}
+	if (sink.statements.size() != 2) {
+		cerr << "Upsert of 3 rows built " << sink.statements.size() <<
+				" statements, not 2!" << endl;
+		return false;
+	}
+	return	check_sql("Upsert split, first part", sink.statements[0],
+				two) &&
+			check_sql("Upsert split, second part", sink.statements[1],
+				"INSERT INTO `item` (`id`,`name`) VALUES (3,'c')" +
+				clause);
+}
+
+
+static bool
+test_select_in_split()
+{
+	// Room for two keys exactly, so three take two statements
+	const string two("SELECT `id`,`name` FROM `item` WHERE `id` IN "
+			"(1,'two')");
+	vector<mysqlpp::SQLTypeAdapter> keys;
+	keys.push_back(1);
+	keys.push_back("two");
+	keys.push_back(3);
+
+	mysqlpp::Query q(0);
+	SaveSink sink;
+	if (!Access::build_select_in(q, item(), keys.begin(), keys.end(),
+			"id", int(two.size()), sink)) {
+		cerr << "build_select_in() failed!" << endl;
+		return false;
+	}
+	if (sink.statements.size() != 2) {
+		cerr << "Select of 3 keys built " << sink.statements.size() <<
+				" statements, not 2!" << endl;
+		return false;
+	}
+	return	check_sql("Select split, first part", sink.statements[0],
+				two) &&
+			check_sql("Select split, second part", sink.statements[1],
+				"SELECT `id`,`name` FROM `item` WHERE `id` IN (3)");
+}
+
+
+static bool
+test_update_key()
+{
+	// Original rows 1 and 2; the first changes its key as well
+	vector<item> orig(make_items(2)), changed(orig);
+	changed[0].id = 5;
+	changed[0].name = "x";
+	changed[1].name = "y";
+
+	mysqlpp::Query q(0);
+	SaveSink sink;
+	mysqlpp::Query::RowCountInsertPolicy<> policy(10);
+	if (!Access::build_update_many(q, orig.begin(), orig.end(),
+			changed.begin(), policy, 0, sink)) {
+		cerr << "build_update_many() failed!" << endl;
+		return false;
+	}
+	if (sink.statements.size() != 2) {
+		cerr << "Update of 2 rows built " << sink.statements.size() <<
+				" statements, not 2!" << endl;
+		return false;
+	}
+
+	// The key's CASE comes last, so the name's still finds row 1
+	const string expected("UPDATE `item` SET `name` = CASE `id` "
+			"WHEN 1 THEN 'x' END,`id` = CASE `id` WHEN 1 THEN 5 END "
+			"WHERE `id` IN (1)");
+	if (!check_sql("Update with a changed key", sink.statements[1],
+				expected) ||
+			!check_sql("Update without a changed key",
+				sink.statements[0], "UPDATE `item` SET `name` = CASE "
+				"`id` WHEN 2 THEN 'y' END WHERE `id` IN (2)")) {
+		return false;
+	}
+
+	// The builder must know how long that is without building it
+	vector<string> columns, values;
+	columns.push_back("`name`");
+	columns.push_back("`id`");
+	values.push_back("'x'");
+	values.push_back("5");
+	mysqlpp::internal::CaseUpdateBuilder b("item", "`id`", columns);
+	size_t size = b.size_with("1", values);
+	b.add("1", values);
+	if ((b.size() != size) || (b.str() != expected) ||
+			(size != expected.size())) {
+		cerr << "CaseUpdateBuilder sizes its statement as " << size <<
+				" and " << b.size() << " bytes, not " <<
+				expected.size() << '!' << endl;
+		return false;
+	}
+
+	return true;
+}
+
+
+static bool
+test_values_tuple(const char* tmpl, bool expected)
+{
+	mysqlpp::Query q(0, false, tmpl);
+	q.parse();
+	size_t head, tail;
+	if (Access::find_values_tuple(q, head, tail) != expected) {
+		cerr << "find_values_tuple() " << (expected ? "rejected" :
+				"accepted") << " template " << tmpl << endl;
+		return false;
+	}
+	return true;
+}
+
+
+static bool
+test_fold()
+{
+	// Only lone tuples filled in entirely by parameters can be folded
+	if (!test_values_tuple("SELECT * FROM t WHERE a = %0", false) ||
+			!test_values_tuple("INSERT INTO t (a) VALUES (%0),(%1)",
+				false) ||
+			!test_values_tuple("INSERT INTO t (a) VALUES (%0) "
+				"ON DUPLICATE KEY UPDATE a = %0", false) ||
+			!test_values_tuple("replace INTO t (a) VALUES (%0)", true)) {
+		return false;
+	}
+
+	const char tmpl[] = "INSERT INTO t (a, b) VALUES (%0q, %1) "
+			"ON DUPLICATE KEY UPDATE b = VALUES(b)";
+	mysqlpp::Query q(0, false, tmpl);
+	q.parse();
+	size_t head, tail;
+	if (!Access::find_values_tuple(q, head, tail)) {
+		cerr << "find_values_tuple() rejected template " << tmpl << endl;
+		return false;
+	}
+
+	// Room for two rows exactly, so three take two statements
+	const char* names[] = { "x", "it's", "z" };
+	vector<mysqlpp::SQLQueryParms> sets(3);
+	for (size_t i = 0; i < sets.size(); ++i) {
+		sets[i] << names[i] << int(i + 1);
+	}
+	const string two("INSERT INTO t (a, b) VALUES ('x', 1),('it\\'s', 2) "
+			"ON DUPLICATE KEY UPDATE b = VALUES(b)");
+	SaveSink sink;
+	if (!Access::build_folded(q, sets, head, tail, two.size(), sink)) {
+		cerr << "build_folded() failed!" << endl;
+		return false;
+	}
+	if (sink.statements.size() != 2) {
+		cerr << "Folding 3 rows built " << sink.statements.size() <<
+				" statements, not 2!" << endl;
+		return false;
+	}
+	return	check_sql("Folded rows, first part", sink.statements[0],
+				two) &&
+			check_sql("Folded rows, second part", sink.statements[1],
+				"INSERT INTO t (a, b) VALUES ('z', 3) "
+				"ON DUPLICATE KEY UPDATE b = VALUES(b)");
+}
+
+
+int
+main()
+{
+	try {
+		return	test_upsert_clause() &&
+				test_upsert_split() &&
+				test_select_in_split() &&
+				test_update_key() &&
+				test_fold() ? 0 : 1;
+	}
+	catch (const mysqlpp::Exception& e) {
+		cerr << "Unexpected MySQL++ exception caught in "
+				"test/bulkquery: " << e.what() << endl;
+		return 2;
+	}
+	catch (...) {
+		cerr << "Unhandled exception caught by test/bulkquery!" << endl;
+		return 2;
+	}
+}
@@ -26,8 +26,10 @@
 
 #include <cpool.h>
 #include <connection.h>
+#include <scopedconnection.h>
 
 #include <iostream>
+#include <vector>
 
 #if defined(MYSQLPP_PLATFORM_WINDOWS)
 #	define SLEEP(n) Sleep((n) * 1000)
@@ -62,6 +64,256 @@ private:
 };
 
 
+// A pool holding at most two connections, whose grab() can be told
+// not to wait for one, as it wouldn't on a platform without threads
+class BoundedPool : public TestConnectionPool
+{
+public:
+	BoundedPool() : wait_(true) { }
+
+	using mysqlpp::ConnectionPool::grab;	// don't hide grab(db)
+	mysqlpp::Connection* grab()
+	{
+		return wait_ ? mysqlpp::ConnectionPool::grab() : try_grab();
+	}
+	unsigned int max_size() { return 2; }
+	bool reset_on_release() { return true; }
+	void set_wait(bool wait) { wait_ = wait; }
+
+private:
+	bool wait_;
+};
+
+
+// A thread grabbing a connection from a BoundedPool
+struct Grabber
+{
+	BoundedPool* pool;
+	unsigned long timeout_ms;	// for timed_grab(), if not 0
+	unsigned long waited_ms;
+	mysqlpp::Connection* conn;
+	mysqlpp::Thread thread;
+
+	explicit Grabber(BoundedPool& p, unsigned long t = 0) :
+	pool(&p), timeout_ms(t), waited_ms(0), conn(0) { }
+
+	static void main(void* arg)
+	{
+		Grabber* g = static_cast<Grabber*>(arg);
+		g->conn = g->timeout_ms ?
+				g->pool->timed_grab(g->timeout_ms, &g->waited_ms) :
+				g->pool->grab();
+	}
+};
+
+
+// ConnectionPool::queue_grab() callback, noting that it was called
+static void
+note_ready(void* flag)
+{
+	*static_cast<bool*>(flag) = true;
+}
+
+
+// Sleep for the given number of milliseconds
+static void
+nap(unsigned long ms)
+{
+	mysqlpp::Monitor m;
+	mysqlpp::Monitor::Lock lock(m);
+	m.wait(ms);
+}
+
+
+// Wait up to 5 seconds for n threads to be waiting on the pool
+static bool
+wait_for_waiters(mysqlpp::ConnectionPool& pool, size_t n)
+{
+	for (int i = 0; (pool.stats().waiting != n) && (i < 500); ++i) {
+		nap(10);
+	}
+	if (pool.stats().waiting != n) {
+		cerr << "Pool has " << pool.stats().waiting << " waiters, not " <<
+				n << '!' << endl;
+		return false;
+	}
+	return true;
+}
+
+
+static bool
+test_bounded()
+{
+	BoundedPool pool;
+	mysqlpp::Connection* conn1 = pool.grab();
+	mysqlpp::Connection* conn2 = pool.grab();
+
+	if (mysqlpp::Connection* pc = pool.try_grab()) {
+		cerr << "try_grab() went past max_size()!" << endl;
+		pool.release(pc);
+		return false;
+	}
+	unsigned long waited = 0;
+	if (mysqlpp::Connection* pc = pool.timed_grab(100, &waited)) {
+		cerr << "timed_grab() went past max_size()!" << endl;
+		pool.release(pc);
+		return false;
+	}
+	if (waited < 100) {
+		cerr << "timed_grab() gave up after " << waited << " ms, not " <<
+				"100!" << endl;
+		return false;
+	}
+
+	// safe_grab() and release() mustn't choke on grab() coming back
+	// empty-handed
+	pool.set_wait(false);
+	if (pool.safe_grab()) {
+		cerr << "safe_grab() went past max_size()!" << endl;
+		return false;
+	}
+	{
+		mysqlpp::ScopedConnection nothing(pool);
+	}
+	pool.set_wait(true);
+	if (pool.stats().timeouts != 4) {
+		cerr << "Pool counted " << pool.stats().timeouts <<
+				" timeouts, not 4!" << endl;
+		return false;
+	}
+
+	if (mysqlpp::Thread::supported()) {
+		// Waiting threads get connections in the order they asked
+		Grabber first(pool), second(pool);
+		first.thread.start(Grabber::main, &first);
+		if (!wait_for_waiters(pool, 1)) return false;
+		second.thread.start(Grabber::main, &second);
+		if (!wait_for_waiters(pool, 2)) return false;
+
+		pool.release(conn1);
+		first.thread.join();
+		if ((first.conn != conn1) || !wait_for_waiters(pool, 1)) {
+			cerr << "First waiter didn't get the first connection "
+					"released!" << endl;
+			return false;
+		}
+		pool.release(conn2);
+		second.thread.join();
+		if (second.conn != conn2) {
+			cerr << "Second waiter didn't get the second connection "
+					"released!" << endl;
+			return false;
+		}
+
+		// timed_grab() says how long it waited when it succeeds, too
+		Grabber timed(pool, 5000);
+		timed.thread.start(Grabber::main, &timed);
+		if (!wait_for_waiters(pool, 1)) return false;
+		nap(50);
+		pool.release(first.conn);
+		timed.thread.join();
+		if ((timed.conn != first.conn) || (timed.waited_ms < 50) ||
+				(timed.waited_ms >= 5000)) {
+			cerr << "timed_grab() got " << timed.conn << " after " <<
+					timed.waited_ms << " ms, not " << first.conn <<
+					" after 50-5000 ms!" << endl;
+			return false;
+		}
+		conn1 = timed.conn;
+
+		// A waiter left room to create a connection that finds an
+		// idle one instead mustn't keep the room
+		mysqlpp::ConnectionPool::Waiter w;
+		bool ready = false;
+		if (!pool.queue_grab(w, note_ready, &ready)) {
+			cerr << "queue_grab() didn't wait on a full pool!" << endl;
+			return false;
+		}
+		pool.remove(conn1);		// room for w to create one...
+		pool.release(conn2);	// ...but here's one ready-made
+		if (!ready) {
+			cerr << "queue_grab() waiter wasn't called back!" << endl;
+			return false;
+		}
+		mysqlpp::Connection* idle = conn2;
+		conn1 = pool.finish_grab(w);
+		conn2 = pool.try_grab();
+		if ((conn1 != idle) || !conn2 || (pool.stats().pending != 0)) {
+			cerr << "Pool lost the room a waiter was given!" << endl;
+			return false;
+		}
+	}
+
+	pool.release(conn1);
+	pool.release(conn2);
+	return true;
+}
+
+
+// A pool whose threads keep the connection they last released
+class CachingPool : public TestConnectionPool
+{
+public:
+	unsigned int thread_cache_time() { return 60; }
+};
+
+
+// A thread's released connection should come back on its next grab(),
+// from each pool it uses, even after others have come and gone
+static bool
+test_thread_cache()
+{
+	for (int round = 0; round < 3; ++round) {
+		CachingPool pools[2];
+		for (int i = 0; i < 2; ++i) {
+			// The first release gives this thread its slot, so it's
+			// the second the slot can keep
+			pools[i].release(pools[i].grab());
+			mysqlpp::Connection* conn = pools[i].grab();
+			pools[i].release(conn);
+			if (pools[i].stats().kept != 1) {
+				cerr << "Thread didn't keep its released connection in "
+						"round " << round << '!' << endl;
+				return false;
+			}
+
+			mysqlpp::Connection* again = pools[i].grab();
+			if (again != conn) {
+				cerr << "Thread didn't get back its kept connection in "
+						"round " << round << '!' << endl;
+				return false;
+			}
+			pools[i].release(again);
+		}
+	}
+
+	return true;
+}
+
+
+// Pools mustn't each use up something the platform has only so many
+// of, like thread-local storage slots
+static bool
+test_many_pools()
+{
+	std::vector<CachingPool*> pools;
+	try {
+		for (int i = 0; i < 2000; ++i) {
+			pools.push_back(new CachingPool);
+		}
+	}
+	catch (const mysqlpp::MutexFailed& e) {
+		cerr << "Failed to create pool " << pools.size() + 1 << ": " <<
+				e.what() << endl;
+	}
+	size_t created = pools.size();
+	for (size_t i = 0; i < pools.size(); ++i) {
+		delete pools[i];
+	}
+	return created == 2000;
+}
+
+
 int
 main()
 {
@@ -93,6 +345,14 @@ main()
 		return 1;
 	}
 
+	mysqlpp::ConnectionPool::Stats stats = pool.stats();
+	if ((stats.in_use != 2) || (stats.idle != 0)) {
+		cerr << "Pool says " << stats.in_use << " connections are in "
+				"use and " << stats.idle << " are idle, not 2 and 0!" <<
+				endl;
+		return 1;
+	}
+
 	pool.release(conn3);
 	pool.release(conn4);
 	pool.shrink();
@@ -101,5 +361,16 @@ main()
 		return 1;
 	}
 
-	return 0;
+	stats = pool.stats();
+	if ((stats.creates != 3) || (stats.destroys != 3) ||
+			(stats.wait_us.count() != 4) || (stats.hold_us.count() != 4)) {
+		cerr << "Pool stats are wrong: " << stats.creates <<
+				" creates, " << stats.destroys << " destroys, " <<
+				stats.wait_us.count() << " grabs, " <<
+				stats.hold_us.count() << " releases!" << endl;
+		return 1;
+	}
+
+	return test_bounded() && test_thread_cache() &&
+			test_many_pools() ? 0 : 1;
 }
@@ -0,0 +1,167 @@
+/***********************************************************************
+ test/escape.cpp - Tests the library-side SQL string escaping code
+	against the output mysql_real_escape_string() gives.
+
+ Copyright (c) 2015 by Educational Technology Resources, Inc.
+ Others may also hold copyrights on code in this file.  See the
+ CREDITS.txt file in the top directory of the distribution for details.
+
+ This file is part of MySQL++.
+
+ MySQL++ is free software; you can redistribute it and/or modify it
+ under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 2.1 of the License, or
+ (at your option) any later version.
+
+ MySQL++ is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with MySQL++; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+ USA
+***********************************************************************/
+
+#include <dbdriver.h>
+#include <escape.h>
+
+#include <iostream>
+#include <sstream>
+#include <string>
+
+using namespace mysqlpp::internal;
+
+
+// Escape the input both ways the library can, and check that each
+// gives the expected result.
+static bool
+test(const std::string& in, const std::string& expected, escape_charset ec)
+{
+	std::string buf(in.length() * 2 + 1, 'x');
+	size_t len = escape_string(&buf[0], in.data(), in.length(), ec);
+	if ((len != expected.length()) || (buf.compare(0, len, expected) != 0)) {
+		std::cerr << "Buffer escaping gave '" << buf.substr(0, len) <<
+				"', expected '" << expected << "'!" << std::endl;
+		return false;
+	}
+	else if (buf[len] != '\0') {
+		std::cerr << "Buffer escaping didn't null-terminate '" <<
+				expected << "'!" << std::endl;
+		return false;
+	}
+
+	std::ostringstream os;
+	len = escape_string(os.rdbuf(), in.data(), in.length(), ec);
+	if ((len != expected.length()) || (os.str() != expected)) {
+		std::cerr << "Stream escaping gave '" << os.str() <<
+				"', expected '" << expected << "'!" << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+
+// Put a special character at every offset within a string longer than
+// the scanner's block size, to make sure we find it wherever it is.
+static bool
+test_positions(escape_charset ec)
+{
+	const std::string clean(70, 'a');
+	for (size_t i = 0; i < clean.length(); ++i) {
+		std::string in(clean), expected(clean);
+		in[i] = '\'';
+		expected.replace(i, 1, "\\'");
+		if (!test(in, expected, ec)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+// The no-connection stream escaper works through the input a piece at
+// a time, so make sure it agrees with the string version across piece
+// boundaries, including when there's no ASCII byte to cut after.
+static bool
+test_no_conn(size_t length)
+{
+	std::string in(length, 'a');
+	for (size_t i = 0; i < length; ++i) {
+		if ((i >= 1500) && (i < 3000)) {
+			in[i] = '\xe9';
+		}
+		else if (i % 7 == 0) {
+			in[i] = '\'';
+		}
+	}
+
+	std::string expected;
+	mysqlpp::DBDriver::escape_string_no_conn(&expected, in.data(),
+			in.length());
+
+	std::ostringstream os;
+	size_t len = mysqlpp::DBDriver::escape_string_no_conn(os, in.data(),
+			in.length());
+	if ((len != expected.length()) || (os.str() != expected)) {
+		std::cerr << "No-connection stream escaping of " << length <<
+				" bytes disagrees with the string version!" << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+
+int
+main()
+{
+	int failures = 0;
+
+	// Charset classification
+	failures += classify_charset("latin1") != ec_single_byte;
+	failures += classify_charset("utf8") != ec_utf8mb3;
+	failures += classify_charset("utf8mb4") != ec_utf8mb4;
+	failures += classify_charset("gbk") != ec_unknown;
+	failures += classify_charset("sjis") != ec_unknown;
+	failures += classify_charset(0) != ec_unknown;
+
+	// The characters the C API escapes, in all charset families
+	const std::string specials("a\0b\nc\rd\\e'f\"g\032h", 15);
+	const std::string escaped("a\\0b\\nc\\rd\\\\e\\'f\\\"g\\Zh");
+	failures += !test(specials, escaped, ec_single_byte);
+	failures += !test(specials, escaped, ec_utf8mb3);
+	failures += !test(specials, escaped, ec_utf8mb4);
+	failures += !test("", "", ec_utf8mb4);
+	failures += !test_positions(ec_single_byte);
+	failures += !test_positions(ec_utf8mb4);
+
+	// High bytes are just data in single-byte charsets
+	failures += !test("caf\xe9 '", "caf\xe9 \\'", ec_single_byte);
+
+	// Well-formed UTF-8 is copied through, including when a
+	// continuation byte follows the block boundary
+	std::string utf8(15, 'a');
+	utf8 += "\xc3\xa9\xe2\x82\xac'";
+	failures += !test(utf8, utf8.substr(0, 20) + "\\'", ec_utf8mb3);
+	failures += !test("\xf0\x9f\x98\x80", "\xf0\x9f\x98\x80", ec_utf8mb4);
+
+	// Bytes that only look like the start of a multibyte character get
+	// a backslash, as they do with the C API.  Stray continuation
+	// bytes and 4-byte lead bytes under utf8mb3 don't.
+	failures += !test("\xc3'", "\\\xc3\\'", ec_utf8mb3);
+	failures += !test("\xe2\x82", "\\\xe2\x82", ec_utf8mb4);
+	failures += !test("\x80\xc1", "\x80\xc1", ec_utf8mb4);
+	failures += !test("\xf0\x9f\x98\x80", "\xf0\x9f\x98\x80", ec_utf8mb3);
+
+	// Escaping through the C API without a connection
+	failures += !test_no_conn(0);
+	failures += !test_no_conn(1024);
+	failures += !test_no_conn(1025);
+	failures += !test_no_conn(5000);
+
+	return failures;
+}
@@ -0,0 +1,167 @@
+/***********************************************************************
+ test/histogram.cpp - Tests the Histogram class's bucketing, percentile
+	estimates and merging.
+
+ Copyright (c) 2015 by Educational Technology Resources, Inc.  Others
+ may also hold copyrights on code in this file.  See the CREDITS.txt
+ file in the top directory of the distribution for details.
+
+ This file is part of MySQL++.
+
+ MySQL++ is free software; you can redistribute it and/or modify it
+ under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 2.1 of the License, or
+ (at your option) any later version.
+
+ MySQL++ is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with MySQL++; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+ USA
+***********************************************************************/
+
+#include <histogram.h>
+
+#include <iostream>
+
+using namespace std;
+using mysqlpp::Histogram;
+
+
+// Return the bucket a single value lands in, or num_buckets if none
+static size_t
+bucket_of(unsigned long long value)
+{
+	Histogram h;
+	h.record(value);
+	for (size_t i = 0; i < Histogram::num_buckets; ++i) {
+		if (h.bucket(i)) {
+			return i;
+		}
+	}
+	return Histogram::num_buckets;
+}
+
+
+// Each bucket must hold the values from its floor up to the next
+// bucket's, and no wider than an eighth of them above the first 8
+static bool
+test_buckets()
+{
+	for (size_t i = 0; i < Histogram::num_buckets; ++i) {
+		unsigned long long floor = Histogram::bucket_floor(i);
+		if (bucket_of(floor) != i) {
+			cerr << "Value " << floor << " landed in bucket " <<
+					bucket_of(floor) << ", not " << i << '!' << endl;
+			return false;
+		}
+		if (i + 1 == Histogram::num_buckets) {
+			break;
+		}
+
+		unsigned long long top = Histogram::bucket_floor(i + 1) - 1;
+		if ((top < floor) || (bucket_of(top) != i)) {
+			cerr << "Value " << top << " landed in bucket " <<
+					bucket_of(top) << ", not " << i << '!' << endl;
+			return false;
+		}
+		if ((i >= 8) && ((top - floor + 1) * 8 > floor)) {
+			cerr << "Bucket " << i << " is " << top - floor + 1 <<
+					" wide, more than an eighth of " << floor << '!' <<
+					endl;
+			return false;
+		}
+	}
+
+	// Values past the last bucket's floor all go in it
+	if (bucket_of(~0ULL) != Histogram::num_buckets - 1) {
+		cerr << "Largest value landed in bucket " << bucket_of(~0ULL) <<
+				'!' << endl;
+		return false;
+	}
+
+	return true;
+}
+
+
+// Percentiles come out at or a little above the truth, but never
+// above the largest value recorded
+static bool
+test_percentile()
+{
+	Histogram h;
+	if (h.percentile(50) != 0) {
+		cerr << "Empty histogram's median is " << h.percentile(50) <<
+				", not 0!" << endl;
+		return false;
+	}
+
+	for (unsigned long long v = 1; v <= 1000; ++v) {
+		h.record(v);
+	}
+
+	const double pcts[] = { 1, 50, 90, 99 };
+	for (size_t i = 0; i < sizeof(pcts) / sizeof(pcts[0]); ++i) {
+		unsigned long long truth =
+				static_cast<unsigned long long>(pcts[i] * 10);
+		unsigned long long p = h.percentile(pcts[i]);
+		if ((p < truth) || (p > truth + truth / 8)) {
+			cerr << "Percentile " << pcts[i] << " is " << p <<
+					", too far from " << truth << '!' << endl;
+			return false;
+		}
+	}
+	if ((h.percentile(100) != 1000) || (h.percentile(0) != 1)) {
+		cerr << "Percentiles 0 and 100 are " << h.percentile(0) <<
+				" and " << h.percentile(100) << ", not 1 and 1000!" <<
+				endl;
+		return false;
+	}
+
+	return true;
+}
+
+
+// Merging must give what recording both sets of values in one would
+static bool
+test_merge()
+{
+	Histogram a, b, both;
+	for (unsigned long long v = 0; v < 500; ++v) {
+		a.record(v * 3);
+		b.record(v * 7 + 1);
+		both.record(v * 3);
+		both.record(v * 7 + 1);
+	}
+
+	a.merge(b);
+	if ((a.count() != both.count()) || (a.sum() != both.sum()) ||
+			(a.max() != both.max())) {
+		cerr << "Merged histogram has count " << a.count() << ", sum " <<
+				a.sum() << " and max " << a.max() << ", not " <<
+				both.count() << ", " << both.sum() << " and " <<
+				both.max() << '!' << endl;
+		return false;
+	}
+	for (size_t i = 0; i < Histogram::num_buckets; ++i) {
+		if (a.bucket(i) != both.bucket(i)) {
+			cerr << "Merged histogram's bucket " << i << " holds " <<
+					a.bucket(i) << ", not " << both.bucket(i) << '!' <<
+					endl;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+int
+main()
+{
+	return test_buckets() && test_percentile() && test_merge() ? 0 : 1;
+}
@@ -90,11 +90,35 @@ test_row_count()
 }
 
 
+static bool
+test_max_packet()
+{
+	typedef mysqlpp::Query::MaxPacketInsertPolicy<> MaxPacket;
+	typedef mysqlpp::Query::RowCountInsertPolicy<> RowCount;
+
+	MaxPacket ip(nonzero);
+	if (!ip.fits(nonzero) || ip.fits(nonzero + 1)) {
+		std::cerr << "MaxPacketInsertPolicy(" << int(nonzero) <<
+				") has the wrong limit!" << std::endl;
+		return false;
+	}
+
+	if (!mysqlpp::internal::is_speculative_policy<MaxPacket>::value ||
+			mysqlpp::internal::is_speculative_policy<RowCount>::value) {
+		std::cerr << "Speculative insert policy detection is broken!" <<
+				std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+
 int
 main()
 {
 	try {
-		return test_row_count() ? 0 : 1;
+		return test_row_count() && test_max_packet() ? 0 : 1;
 	}
 	catch (...) {
 		std::cerr << "Unhandled exception caught by "
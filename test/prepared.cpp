@@ -0,0 +1,145 @@
+/***********************************************************************
+ test/prepared.cpp - Tests the way PreparedQuery binds parameter values
+	for sending to the server.
+
+ Copyright (c) 2015 by Educational Technology Resources, Inc.  Others
+ may also hold copyrights on code in this file.  See the CREDITS.txt
+ file in the top directory of the distribution for details.
+
+ This file is part of MySQL++.
+
+ MySQL++ is free software; you can redistribute it and/or modify it
+ under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 2.1 of the License, or
+ (at your option) any later version.
+
+ MySQL++ is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with MySQL++; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+ USA
+***********************************************************************/
+
+#include <mysql++.h>
+
+#include <iostream>
+#include <limits>
+
+
+static bool
+test_integer(const mysqlpp::SQLTypeAdapter& value, mysqlpp::longlong expected,
+		bool is_unsigned)
+{
+	MYSQL_BIND b;
+	mysqlpp::internal::PreparedParam p;
+	mysqlpp::internal::bind_param(b, p, value);
+	if ((b.buffer_type != MYSQL_TYPE_LONGLONG) || (b.buffer != &p.ival) ||
+			(p.ival != expected) || (bool(b.is_unsigned) != is_unsigned)) {
+		std::cerr << "Integer parameter '" << value.data() <<
+				"' bound as type " << b.buffer_type << ", value " <<
+				p.ival << ", unsigned " << bool(b.is_unsigned) << '!' <<
+				std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+
+static bool
+test_integers()
+{
+	typedef std::numeric_limits<mysqlpp::sql_bigint> limits;
+	typedef std::numeric_limits<mysqlpp::sql_bigint_unsigned> ulimits;
+
+	return	test_integer(42, 42, false) &&
+			test_integer(-42, -42, false) &&
+			test_integer(mysqlpp::sql_tinyint_unsigned(200), 200, true) &&
+			test_integer(limits::max(), limits::max(), false) &&
+			test_integer(limits::min(), limits::min(), false) &&
+			test_integer(ulimits::max(),
+				static_cast<mysqlpp::longlong>(ulimits::max()), true);
+}
+
+
+static bool
+test_double()
+{
+	MYSQL_BIND b;
+	mysqlpp::internal::PreparedParam p;
+	mysqlpp::internal::bind_param(b, p, -2.5);
+	if ((b.buffer_type != MYSQL_TYPE_DOUBLE) || (b.buffer != &p.dval) ||
+			(p.dval != -2.5)) {
+		std::cerr << "Double parameter bound as type " << b.buffer_type <<
+				", value " << p.dval << '!' << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+
+static bool
+test_string()
+{
+	MYSQL_BIND b;
+	mysqlpp::internal::PreparedParam p;
+	mysqlpp::SQLTypeAdapter value(std::string("it's"));
+	mysqlpp::internal::bind_param(b, p, value);
+	if ((b.buffer_type != MYSQL_TYPE_STRING) ||
+			(b.buffer != value.data()) || (b.length != &p.length) ||
+			(p.length != 4) || (b.buffer_length != 4)) {
+		std::cerr << "String parameter bound as type " << b.buffer_type <<
+				", length " << p.length << '!' << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+
+static bool
+test_null()
+{
+	MYSQL_BIND b;
+	mysqlpp::internal::PreparedParam p;
+	mysqlpp::internal::bind_param(b, p, mysqlpp::null);
+	if ((b.buffer_type != MYSQL_TYPE_NULL) || b.buffer) {
+		std::cerr << "Null parameter bound as type " << b.buffer_type <<
+				'!' << std::endl;
+		return false;
+	}
+
+	// An empty adapter has no buffer at all; that mustn't crash us
+	mysqlpp::SQLTypeAdapter empty;
+	mysqlpp::internal::bind_param(b, p, empty);
+	if (empty.is_null() || (b.buffer_type != MYSQL_TYPE_STRING) ||
+			(p.length != 0)) {
+		std::cerr << "Empty parameter bound as type " << b.buffer_type <<
+				", length " << p.length << '!' << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+
+int
+main()
+{
+	try {
+		return	test_integers() &&
+				test_double() &&
+				test_string() &&
+				test_null() ? 0 : 1;
+	}
+	catch (...) {
+		std::cerr << "Unhandled exception caught by test/prepared!" <<
+				std::endl;
+		return 2;
+	}
+}
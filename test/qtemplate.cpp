@@ -0,0 +1,112 @@
+/***********************************************************************
+ test/qtemplate.cpp - Tests that compile-time template queries count
+	their parameters the way Query::parse() does, and render the same
+	SQL as the equivalent parsed template query.
+
+ Copyright (c) 2015 by Educational Technology Resources, Inc.
+ Others may also hold copyrights on code in this file.  See the
+ CREDITS.txt file in the top directory of the distribution for details.
+
+ This file is part of MySQL++.
+
+ MySQL++ is free software; you can redistribute it and/or modify it
+ under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 2.1 of the License, or
+ (at your option) any later version.
+
+ MySQL++ is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with MySQL++; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+ USA
+***********************************************************************/
+
+#include <mysql++.h>
+
+#include <iostream>
+#include <limits>
+
+#if defined(MYSQLPP_HAVE_VARIADIC_QUERIES)
+
+using namespace mysqlpp;
+
+// Parameter counts are checked at compile time, so these fail to build
+// rather than fail at run time.
+static_assert(internal::template_param_count("") == 0, "empty");
+static_assert(internal::template_param_count("SELECT 100%") == 0, "lone %");
+static_assert(internal::template_param_count("x %%0 y") == 0, "%%");
+static_assert(internal::template_param_count("%%%0") == 1, "%%%");
+static_assert(internal::template_param_count("%0q:name: %2") == 3, "gap");
+static_assert(internal::template_param_count("%12") == 13, "2 digits");
+static_assert(internal::template_param_count("%1234") == 124, "3 digits");
+
+
+// Render the template both ways, and complain if they differ
+template <size_t N, class... Args>
+static bool
+test(const char* tmpl, const QueryTemplate<N>& qt, const Args&... args)
+{
+	Connection conn;
+	Query parsed = conn.query(tmpl);
+	parsed.parse();
+	SQLQueryParms p;
+	int dummy[] = { 0, ((p << SQLTypeAdapter(args)), 0)... };
+	(void)dummy;
+	std::string expected = parsed.str(p);
+
+	std::string actual = conn.query().str(qt, args...);
+	if (actual == expected) {
+		return true;
+	}
+	else {
+		std::cerr << "Template \"" << tmpl << "\" rendered as \"" <<
+				actual << "\", not \"" << expected << "\"!" << std::endl;
+		return false;
+	}
+}
+
+#define TEST(s, ...) test(s, MYSQLPP_QUERY_TEMPLATE(s), __VA_ARGS__)
+
+
+int
+main()
+{
+	try {
+		std::string s("O'Reilly");
+		const char* cs = "a\\b";
+		sql_varchar_null vn(null);
+		sql_int_null in(42);
+		int failures = 0;
+
+		failures += !TEST("SELECT %0, %1q, %1Q, %1", s, cs);
+		failures += !TEST("%0 %1 %2 %3 %4", -1, 0U, sql_bigint(-12345),
+				std::numeric_limits<sql_bigint>::min(),
+				std::numeric_limits<sql_bigint_unsigned>::max());
+		failures += !TEST("%0q %1q %2q", 2.5f, 2.5, true);
+		failures += !TEST("%0q:a: %1q %2q %3q", null, vn, in,
+				sql_date("2015-01-02"));
+		failures += !TEST("100%% %1q %0 %", "x", String("y"));
+		failures += !TEST("%1 %0 %1", "first", "second");
+
+		return failures;
+	}
+	catch (const std::exception& e) {
+		std::cerr << "Unexpected exception: " << e.what() << std::endl;
+		return 1;
+	}
+}
+
+#else
+
+int
+main()
+{
+	// Nothing to test without C++11
+	return 0;
+}
+
+#endif
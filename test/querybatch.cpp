@@ -0,0 +1,112 @@
+/***********************************************************************
+ test/querybatch.cpp - Tests the parts of QueryBatch that don't need a
+	database server.
+
+ Copyright (c) 2015 by Educational Technology Resources, Inc.  Others
+ may also hold copyrights on code in this file.  See the CREDITS.txt
+ file in the top directory of the distribution for details.
+
+ This file is part of MySQL++.
+
+ MySQL++ is free software; you can redistribute it and/or modify it
+ under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 2.1 of the License, or
+ (at your option) any later version.
+
+ MySQL++ is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with MySQL++; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+ USA
+***********************************************************************/
+
+#include <mysql++.h>
+
+#include <iostream>
+
+using namespace std;
+
+
+static bool
+test_trim(mysqlpp::QueryBatch& batch, const char* sql, const char* expected)
+{
+	size_t i = batch.add(sql);
+	if ((i != batch.size() - 1) || (batch.statement(i) != expected)) {
+		cerr << "Statement '" << sql << "' was added as '" <<
+				batch.statement(i) << "' at index " << i << '!' << endl;
+		return false;
+	}
+
+	return true;
+}
+
+
+static bool
+test_bad_index(const mysqlpp::QueryBatch& batch)
+{
+	try {
+		batch.result(batch.size());
+		cerr << "Out of range result() index was accepted!" << endl;
+		return false;
+	}
+	catch (const mysqlpp::BadIndex&) {
+	}
+
+	try {
+		batch.statement(batch.size());
+		cerr << "Out of range statement() index was accepted!" << endl;
+		return false;
+	}
+	catch (const mysqlpp::BadIndex&) {
+	}
+
+	return true;
+}
+
+
+int
+main()
+{
+	try {
+		// Batches of nothing but empty statements never touch the
+		// connection, so they can run without one.
+		mysqlpp::QueryBatch batch(0);
+		if (!test_trim(batch, ";", "") ||
+				!test_trim(batch, " ; ;\n", "") ||
+				!test_trim(batch, "", "") ||
+				!test_bad_index(batch)) {
+			return 1;
+		}
+
+		if (!batch.execute()) {
+			cerr << "Batch of empty statements failed!" << endl;
+			return 1;
+		}
+		for (size_t i = 0; i < batch.size(); ++i) {
+			const mysqlpp::QueryBatch::Result& r = batch.result(i);
+			if (!r.executed || !r.ok || r.errnum) {
+				cerr << "Empty statement " << i << " didn't succeed!" <<
+						endl;
+				return 1;
+			}
+		}
+
+		batch.clear();
+		if (!test_trim(batch, "SELECT 1;", "SELECT 1") ||
+				!test_trim(batch, "SELECT ';' ;\r\n", "SELECT ';'") ||
+				!test_trim(batch, "  SELECT 2", "  SELECT 2") ||
+				!test_bad_index(batch)) {
+			return 1;
+		}
+
+		return 0;
+	}
+	catch (const mysqlpp::Exception& e) {
+		cerr << "Unexpected MySQL++ exception: " << e.what() << endl;
+		return 2;
+	}
+}
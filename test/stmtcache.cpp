@@ -0,0 +1,106 @@
+/***********************************************************************
+ test/stmtcache.cpp - Tests the StatementCache class's LRU behavior.
+
+ Copyright (c) 2015 by Educational Technology Resources, Inc.  Others
+ may also hold copyrights on code in this file.  See the CREDITS.txt
+ file in the top directory of the distribution for details.
+
+ This file is part of MySQL++.
+
+ MySQL++ is free software; you can redistribute it and/or modify it
+ under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 2.1 of the License, or
+ (at your option) any later version.
+
+ MySQL++ is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with MySQL++; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+ USA
+***********************************************************************/
+
+#include <mysql++.h>
+
+#include <iostream>
+
+using namespace std;
+
+// A cache that doesn't need a server: its statements are never
+// prepared, and those for "bad" SQL count as failing to prepare.
+class TestStatementCache : public mysqlpp::StatementCache
+{
+public:
+	TestStatementCache() : mysqlpp::StatementCache(0, 2) { }
+
+private:
+	bool create(const std::string& sql, mysqlpp::PreparedQueryPtr& pq)
+	{
+		pq = new mysqlpp::PreparedQuery(0);
+		return sql != "bad";
+	}
+};
+
+
+static bool
+check(const TestStatementCache& cache, const char* when,
+		mysqlpp::ulonglong hits, mysqlpp::ulonglong misses,
+		mysqlpp::ulonglong evictions, size_t size)
+{
+	if ((cache.hits() != hits) || (cache.misses() != misses) ||
+			(cache.evictions() != evictions) || (cache.size() != size)) {
+		cerr << "After " << when << ", cache has " << cache.hits() <<
+				" hits, " << cache.misses() << " misses, " <<
+				cache.evictions() << " evictions and " << cache.size() <<
+				" statements, not " << hits << ", " << misses << ", " <<
+				evictions << " and " << size << '!' << endl;
+		return false;
+	}
+
+	return true;
+}
+
+
+int
+main()
+{
+	TestStatementCache cache;
+
+	mysqlpp::PreparedQueryPtr a = cache.get("a");
+	cache.get("b");
+	if (!check(cache, "filling", 0, 2, 0, 2)) return 1;
+
+	if (cache.get("a") != a) {
+		cerr << "Cache hit returned a different statement!" << endl;
+		return 1;
+	}
+	if (!check(cache, "a hit", 1, 2, 0, 2)) return 1;
+
+	// "a" was used more recently than "b", so "b" goes
+	cache.get("c");
+	if (!check(cache, "overflowing", 1, 3, 1, 2)) return 1;
+	if (cache.get("a") != a) {
+		cerr << "Cache evicted the most recently used statement!" << endl;
+		return 1;
+	}
+	cache.get("b");
+	if (!check(cache, "re-adding", 2, 4, 2, 2)) return 1;
+
+	// Failures are handed out but never cached, so they evict nothing
+	cache.get("bad");
+	cache.get("bad");
+	if (!check(cache, "failures", 2, 6, 2, 2)) return 1;
+
+	cache.set_capacity(1);
+	if (!check(cache, "shrinking", 2, 6, 3, 1)) return 1;
+
+	cache.set_capacity(0);
+	cache.get("a");
+	cache.get("a");
+	if (!check(cache, "disabling", 2, 8, 4, 0)) return 1;
+
+	return 0;
+}